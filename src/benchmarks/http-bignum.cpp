@@ -0,0 +1,66 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// HttpBigNum arithmetic, as the parser uses it to track chunk sizes and Content-Lengths,
+// for numbers of one word (every real message) and of several words.
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "../presentation-layer/http-presentation/http-requests.hpp"
+
+using namespace http;
+
+static const std::size_t ITERATIONS = 1000000;
+
+// The result is kept so that the compiler can not drop the work.
+static volatile std::size_t sink;
+
+template<class F>
+static void bench(const std::string& operation, std::size_t words, F&& f){
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < ITERATIONS; ++i){
+        sink = f(i);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "{\"benchmark\":\"http-bignum\",\"operation\":\"" << operation << "\",\"words\":" << words
+              << ",\"iterations\":" << ITERATIONS
+              << ",\"ns_per_op\":" << seconds * 1e9 / ITERATIONS << "}" << std::endl;
+}
+
+static void run(const std::string& hex, const std::string& dec){
+    const HttpBigNum a(HttpBigNum::hex, hex);
+    const HttpBigNum b(HttpBigNum::dec, dec);
+    const std::size_t words = a.size();
+
+    bench("parse_hex", words, [&](std::size_t){ return HttpBigNum(HttpBigNum::hex, hex).size(); });
+    bench("parse_dec", words, [&](std::size_t){ return HttpBigNum(HttpBigNum::dec, dec).size(); });
+    bench("compare", words, [&](std::size_t){
+        HttpBigNum x = a;
+        return static_cast<std::size_t>(x < b) + (x == b) + (x != HttpBigNum{0});
+    });
+    HttpBigNum counter = a;
+    bench("increment", words, [&](std::size_t){ return (++counter)[0]; });
+    bench("add_word", words, [&](std::size_t i){ HttpBigNum x = a; x += i; return x[0]; });
+    bench("add", words, [&](std::size_t){ return (a + b)[0]; });
+    // The parser finds the bytes left in a chunk by subtracting the bytes received from its size.
+    bench("subtract", words, [&](std::size_t){
+        HttpBigNum received = a;
+        received -= 1;
+        return (a - received)[0];
+    });
+    std::ostringstream os;
+    bench("serialize", words, [&](std::size_t){
+        os.str(std::string());
+        os << a;
+        return static_cast<std::size_t>(os.tellp());
+    });
+}
+
+int main(){
+    run("1000", "65536");
+    run("ffffffffffffffff0123456789abcdef", "340282366920938463463374607431768211455");
+    return 0;
+}
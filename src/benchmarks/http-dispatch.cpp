@@ -0,0 +1,162 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// The cost of virtual dispatch on the read, parse, and write path of small requests:
+// HttpPresentation called through the Presentation interface, against BasicHttpPresentation over a concrete session type.
+// In memory, the session only hands over buffers, so the presentation path is all that is measured.
+// Over a Unix domain session pair, the server runs on its own thread and the client sends one request at a time.
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../presentation-layer/http-presentation/http-presentation.hpp"
+
+using namespace http;
+using namespace http::h_presentation;
+
+static const std::size_t WARMUP = 10000;
+static const std::size_t ITERATIONS = 500000;
+static const std::size_t REQUESTS = 20000;
+static const std::string_view REQUEST = "GET /bench HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+class MemoryServer: public session::Server
+{
+public:
+    void open() override {}
+};
+
+// A session that has no transport: reads leave the read buffer as it is, and writes throw the write buffer away.
+class MemorySession final: public session::Session
+{
+public:
+    MemorySession(session::Server& server): session::Session(server) {}
+
+    void read() override {}
+    void async_read(std::function<void(std::error_code ec)> cb) override { cb(std::error_code()); }
+    void write() override {
+        auto lk = lock();
+        wbuf.str(std::string());
+    }
+    void async_write(std::function<void(std::error_code ec)> cb) override {
+        write();
+        cb(std::error_code());
+    }
+    void close() override { forget(); }
+};
+
+static HttpResponse make_response(){
+    HttpResponse res{};
+    res.version = HttpVersion::V1_1;
+    res.status = HttpStatus::OK;
+    res.headers.push_back(make_header(HttpHeaderField::CONTENT_TYPE, "text/plain"));
+    res.headers.push_back(make_header(HttpHeaderField::CONTENT_LENGTH, "2"));
+    res.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+    res.chunks.push_back(make_chunk("ok"));
+    return res;
+}
+
+static void report(const std::string& transport, const std::string& dispatch, std::size_t requests, std::chrono::steady_clock::duration elapsed){
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << "{\"benchmark\":\"http-dispatch\",\"transport\":\"" << transport << "\",\"dispatch\":\"" << dispatch
+              << "\",\"requests\":" << requests
+              << ",\"ns_per_request\":" << seconds * 1e9 / requests
+              << ",\"requests_per_second\":" << static_cast<std::uint64_t>(requests/seconds) << "}" << std::endl;
+}
+
+// P is the type that the presentation is called through.
+template<class P>
+static void memory(const std::string& dispatch, P& p, session::Session& session){
+    const HttpResponse res = make_response();
+    auto once = [&](){
+        {
+            auto lk = session.lock();
+            session.rbuf.rdbuf()->sputn(REQUEST.data(), REQUEST.size());
+        }
+        std::get<HttpRequest>(p) = HttpRequest{};
+        p.read();
+        std::get<HttpResponse>(p) = res;
+        p.write();
+    };
+    for(std::size_t i = 0; i < WARMUP; ++i){
+        once();
+    }
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < ITERATIONS; ++i){
+        once();
+    }
+    report("memory", dispatch, ITERATIONS, std::chrono::steady_clock::now() - start);
+}
+
+// Answer every request in the read buffer, then wait for more.
+template<class P>
+static void serve(const std::shared_ptr<P>& p){
+    p->async_read([p](std::error_code ec){
+        if(ec){
+            return;
+        }
+        while(complete(std::get<HttpRequest>(*p))){
+            std::get<HttpResponse>(*p) = make_response();
+            p->write();
+            std::get<HttpRequest>(*p) = HttpRequest{};
+            p->read();
+        }
+        serve(p);
+    });
+}
+
+template<class P>
+static void unix_pair(const std::string& dispatch){
+    typedef boost::asio::local::stream_protocol::socket socket;
+    boost::asio::io_context client_ioc, server_ioc;
+    unix_session::uServer client_server(client_ioc), server_server(server_ioc);
+    HttpPresentations client_presentations, server_presentations;
+
+    socket s1(client_ioc), s2(server_ioc);
+    boost::asio::local::connect_pair(s1, s2);
+    s1.non_blocking(true);
+    s2.non_blocking(true);
+    auto client = std::make_shared<unix_session::uSession>(std::move(s1), client_server);
+    auto server = std::make_shared<unix_session::uSession>(std::move(s2), server_server);
+
+    serve(std::make_shared<P>(server_presentations, server));
+    std::thread t([&](){ server_ioc.run(); });
+    auto p = std::make_shared<HttpClientPresentation>(client_presentations, client);
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < REQUESTS; ++i){
+        {
+            auto lk = client->lock();
+            client->wbuf.rdbuf()->sputn(REQUEST.data(), REQUEST.size());
+        }
+        client->write();
+        std::get<HttpResponse>(*p) = HttpResponse{};
+        auto& res = std::get<HttpResponse>(*p);
+        while(!(res.status_line_finished && res.num_headers > 0 && res.next_header == res.num_headers && res.next_chunk == res.num_chunks)){
+            p->async_read([](std::error_code){});
+            client_ioc.restart();
+            client_ioc.run();
+        }
+    }
+    report("unix", dispatch, REQUESTS, std::chrono::steady_clock::now() - start);
+    server_ioc.stop();
+    t.join();
+}
+
+int main(){
+    MemoryServer server;
+    HttpPresentations presentations;
+    {
+        auto session = std::make_shared<MemorySession>(server);
+        std::shared_ptr<Presentation> p = std::make_shared<HttpPresentation>(presentations, session);
+        memory("virtual", *p, *session);
+    }
+    {
+        auto session = std::make_shared<MemorySession>(server);
+        auto p = std::make_shared<BasicHttpPresentation<MemorySession> >(presentations, session);
+        memory("static", *p, *session);
+    }
+    unix_pair<HttpPresentation>("virtual");
+    unix_pair<BasicHttpPresentation<unix_session::uSession> >("static");
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// Parsing with operator>> and serializing with operator<< of HttpRequest and HttpResponse,
+// for small messages, messages with many headers, chunked bodies, and large Content-Length bodies.
+// Every parse starts from a fresh message, and has to complete.
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "../presentation-layer/http-presentation/http-presentation.hpp"
+
+using namespace http;
+
+static const std::size_t BYTES = 64 << 20;
+static const std::size_t MIN_ITERATIONS = 1000;
+
+static const std::string HEADERS =
+    "Host: localhost\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Referer: http://localhost/index.html\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; lang=en\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Priority: u=0, i\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "If-None-Match: \"5e1b7a9c-2a7f\"\r\n";
+
+static std::string chunked(std::size_t chunks, std::size_t size){
+    std::ostringstream os;
+    for(std::size_t i = 0; i < chunks; ++i){
+        os << std::hex << size << "\r\n" << std::string(size, 'x') << "\r\n";
+    }
+    os << "0\r\n\r\n";
+    return os.str();
+}
+
+static std::string sized(std::size_t size){
+    return "Content-Length: " + std::to_string(size) + "\r\n\r\n" + std::string(size, 'x');
+}
+
+static bool complete(const HttpResponse& res){
+    return res.status_line_finished && res.num_headers > 0 && res.next_header == res.num_headers && res.next_chunk == res.num_chunks;
+}
+
+static bool complete(const HttpRequest& req){
+    return h_presentation::complete(req);
+}
+
+static void report(const std::string& operation, const std::string& message, std::size_t size, std::size_t iterations, std::chrono::steady_clock::duration elapsed){
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << "{\"benchmark\":\"http-parser\",\"operation\":\"" << operation << "\",\"message\":\"" << message
+              << "\",\"bytes\":" << size << ",\"iterations\":" << iterations
+              << ",\"ns_per_op\":" << seconds * 1e9 / iterations
+              << ",\"mb_per_second\":" << size * iterations / seconds / 1e6 << "}" << std::endl;
+}
+
+// Every benchmark moves about BYTES bytes, so that small and large messages take about as long.
+static std::size_t iterations(std::size_t size){
+    return std::max(MIN_ITERATIONS, BYTES / size);
+}
+
+template<class T>
+static void parse(const std::string& message, const std::string& text){
+    std::size_t n = iterations(text.size());
+    std::stringstream ss;
+    std::size_t completed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < n; ++i){
+        ss.clear();
+        ss.str(text);
+        T t{};
+        ss >> t;
+        completed += complete(t);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if(completed != n){
+        std::cerr << "http-parser: " << message << " did not parse." << std::endl;
+        return;
+    }
+    report(std::is_same_v<T, HttpRequest> ? "parse_request" : "parse_response", message, text.size(), n, elapsed);
+}
+
+// operator<< only writes the parts of a message that have not been written yet,
+// so a parsed message is marked as unwritten before it is serialized.
+static void rewind(HttpRequest& req){
+    req.http_request_line_complete = false;
+    req.next_header = 0;
+    req.next_chunk = 0;
+}
+
+static void rewind(HttpResponse& res){
+    res.status_line_finished = false;
+    res.next_header = 0;
+    res.next_chunk = 0;
+}
+
+// Serialize a message that was parsed from text.
+template<class T>
+static void serialize(const std::string& message, const std::string& text){
+    std::stringstream in(text);
+    T t{};
+    in >> t;
+    rewind(t);
+    std::size_t n = iterations(text.size());
+    std::stringstream ss;
+    std::size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < n; ++i){
+        ss.str(std::string());
+        ss << t;
+        bytes += ss.tellp();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    report(std::is_same_v<T, HttpRequest> ? "serialize_request" : "serialize_response", message, bytes / n, n, elapsed);
+}
+
+template<class T>
+static void both(const std::string& message, const std::string& text){
+    parse<T>(message, text);
+    serialize<T>(message, text);
+}
+
+int main(){
+    const std::string req = "GET /index.html HTTP/1.1\r\n";
+    const std::string post = "POST /upload HTTP/1.1\r\nHost: localhost\r\n";
+    const std::string res = "HTTP/1.1 200 OK\r\n";
+    const std::string body = "Content-Type: text/plain\r\n";
+
+    both<HttpRequest>("small", req + "Host: localhost\r\n\r\n");
+    both<HttpRequest>("headers", req + HEADERS + "\r\n");
+    both<HttpRequest>("chunked", post + "Transfer-Encoding: chunked\r\n\r\n" + chunked(16, 256));
+    both<HttpRequest>("content_length", post + sized(64 << 10));
+
+    both<HttpResponse>("small", res + body + sized(2));
+    both<HttpResponse>("headers", res + HEADERS + body + sized(2));
+    both<HttpResponse>("chunked", res + body + "Transfer-Encoding: chunked\r\n\r\n" + chunked(16, 256));
+    both<HttpResponse>("content_length", res + body + sized(64 << 10));
+    return 0;
+}
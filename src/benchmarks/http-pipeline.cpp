@@ -0,0 +1,122 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// Throughput of small GET requests over a single Unix domain session,
+// with the sequential HttpClientPresentation and with HttpPipelinedClientPresentation at various depths.
+// The server runs an HttpPresentation on its own thread with its own io_context.
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../presentation-layer/http-presentation/http-presentation.hpp"
+
+using namespace http;
+using namespace http::h_presentation;
+
+static const std::size_t REQUESTS = 20000;
+
+static HttpRequest make_request(){
+    HttpRequest req{};
+    req.verb = HttpVerb::GET;
+    req.route = "/bench";
+    req.version = HttpVersion::V1_1;
+    req.headers.push_back(make_header(HttpHeaderField::HOST, "localhost"));
+    req.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+    return req;
+}
+
+static HttpResponse make_response(){
+    HttpResponse res{};
+    res.version = HttpVersion::V1_1;
+    res.status = HttpStatus::OK;
+    res.headers.push_back(make_header(HttpHeaderField::CONTENT_TYPE, "text/plain"));
+    res.headers.push_back(make_header(HttpHeaderField::CONTENT_LENGTH, "2"));
+    res.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+    res.chunks.push_back(make_chunk("ok"));
+    return res;
+}
+
+static bool complete(const HttpResponse& res){
+    return res.status_line_finished && res.num_headers > 0 && res.next_header == res.num_headers && res.next_chunk == res.num_chunks;
+}
+
+// Answer every request in the read buffer, then wait for more.
+static void serve(const std::shared_ptr<HttpPresentation>& p){
+    p->async_read([p](std::error_code ec){
+        if(ec){
+            return;
+        }
+        while(complete(std::get<HttpRequest>(*p))){
+            std::get<HttpResponse>(*p) = make_response();
+            p->write();
+            std::get<HttpRequest>(*p) = HttpRequest{};
+            p->read();
+        }
+        serve(p);
+    });
+}
+
+static void report(const std::string& client, std::size_t depth, std::chrono::steady_clock::duration elapsed){
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << "{\"benchmark\":\"http-pipeline\",\"client\":\"" << client << "\",\"depth\":" << depth
+              << ",\"requests\":" << REQUESTS
+              << ",\"requests_per_second\":" << static_cast<std::uint64_t>(REQUESTS/seconds) << "}" << std::endl;
+}
+
+static void sequential(boost::asio::io_context& ioc, HttpPresentations& presentations, const std::shared_ptr<session::Session>& session){
+    auto client = std::make_shared<HttpClientPresentation>(presentations, session);
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < REQUESTS; ++i){
+        std::get<HttpRequest>(*client) = make_request();
+        std::get<HttpResponse>(*client) = HttpResponse{};
+        client->write();
+        while(!complete(std::get<HttpResponse>(*client))){
+            client->async_read([](std::error_code){});
+            ioc.restart();
+            ioc.run();
+        }
+    }
+    report("sequential", 1, std::chrono::steady_clock::now() - start);
+}
+
+static void pipelined(boost::asio::io_context& ioc, HttpPresentations& presentations, const std::shared_ptr<session::Session>& session, std::size_t depth){
+    auto client = std::make_shared<HttpPipelinedClientPresentation>(presentations, session, depth);
+    std::size_t responses = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < REQUESTS; ++i){
+        client->request(make_request(), [&](const std::error_code&, HttpResponse&){ ++responses; });
+    }
+    client->write();
+    while(responses < REQUESTS){
+        client->async_read([](std::error_code){});
+        ioc.restart();
+        ioc.run();
+    }
+    report("pipelined", depth, std::chrono::steady_clock::now() - start);
+}
+
+int main(){
+    typedef boost::asio::local::stream_protocol::socket socket;
+    boost::asio::io_context client_ioc, server_ioc;
+    unix_session::uServer client_server(client_ioc), server_server(server_ioc);
+    HttpPresentations client_presentations, server_presentations;
+
+    socket s1(client_ioc), s2(server_ioc);
+    boost::asio::local::connect_pair(s1, s2);
+    s1.non_blocking(true);
+    s2.non_blocking(true);
+    auto client = std::make_shared<unix_session::uSession>(std::move(s1), client_server);
+    auto server = std::make_shared<unix_session::uSession>(std::move(s2), server_server);
+
+    serve(std::make_shared<HttpPresentation>(server_presentations, server));
+    std::thread t([&](){ server_ioc.run(); });
+    sequential(client_ioc, client_presentations, client);
+    for(std::size_t depth: {1, 2, 4, 8, 16, 32, 64}){
+        pipelined(client_ioc, client_presentations, client, depth);
+    }
+    server_ioc.stop();
+    t.join();
+    return 0;
+}
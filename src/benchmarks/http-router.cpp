@@ -0,0 +1,52 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// The cost of matching a route with HttpRouter, for tables of 10 to 10000 templates.
+// Every table holds REST style templates with one parameter, and every lookup matches one of them.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../presentation-layer/http-presentation/http-router.hpp"
+
+using namespace http;
+
+static const std::size_t LOOKUPS = 2000000;
+
+// Names have the same length in every table, so that only the number of templates changes.
+static std::string resource(std::size_t i){
+    std::string n = std::to_string(i);
+    return "/api/v1/resource" + std::string(5 - n.size(), '0') + n;
+}
+
+static void bench(std::size_t routes){
+    HttpRouter<std::size_t> router;
+    for(std::size_t i = 0; i < routes; ++i){
+        router.add(HttpVerb::GET, resource(i), i);
+        router.add(HttpVerb::GET, resource(i) + "/:id", i);
+        router.add(HttpVerb::PUT, resource(i) + "/:id", i);
+    }
+    std::vector<std::string> targets;
+    for(std::size_t i = 0; i < 64; ++i){
+        targets.push_back(resource(i * 7919 % routes) + "/12345");
+    }
+    HttpRouteParams params;
+    std::size_t matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < LOOKUPS; ++i){
+        matched += router.match(HttpVerb::GET, targets[i % targets.size()], params) != nullptr;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "{\"benchmark\":\"http-router\",\"templates\":" << router.size()
+              << ",\"lookups\":" << LOOKUPS << ",\"matched\":" << matched
+              << ",\"ns_per_match\":" << seconds * 1e9 / LOOKUPS << "}" << std::endl;
+}
+
+int main(){
+    for(std::size_t routes: {10, 100, 1000, 10000}){
+        bench(routes);
+    }
+    return 0;
+}
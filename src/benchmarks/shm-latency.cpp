@@ -0,0 +1,227 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// Round trip latency of small messages over a Unix domain session,
+// and over a shared memory session that was set up through it.
+// An echo peer runs on its own thread with its own io_context,
+// both sides sleep in the io_context between messages so the wakeup cost is included.
+// The same comparison is then made for GET requests answered by an HttpPresentation.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../session-layer/shared-memory/shm-session.hpp"
+#include "../presentation-layer/http-presentation/http-presentation.hpp"
+
+using namespace http;
+using namespace http::h_presentation;
+
+static const std::size_t WARMUP = 1000;
+static const std::size_t ITERATIONS = 20000;
+
+// Move everything in one session buffer to another, returning the number of bytes moved.
+static std::size_t drain(session::Buffer& from, session::Buffer* to){
+    char buf[4096];
+    std::size_t total = 0;
+    std::streamsize len;
+    while((len = from.rdbuf()->sgetn(buf, sizeof(buf))) > 0){
+        if(to != nullptr){
+            to->rdbuf()->sputn(buf, len);
+        }
+        total += len;
+    }
+    return total;
+}
+
+static void echo(const std::shared_ptr<session::Session>& session){
+    session->async_read([session](std::error_code ec){
+        if(ec){
+            return;
+        }
+        {
+            auto lk = session->lock();
+            drain(session->rbuf, &session->wbuf);
+        }
+        session->write();
+        echo(session);
+    });
+}
+
+static void report(const std::string& transport, const std::string& payload, std::size_t size, std::vector<std::uint64_t>& samples){
+    std::sort(samples.begin(), samples.end());
+    std::uint64_t sum = 0;
+    for(auto sample: samples){
+        sum += sample;
+    }
+    std::cout << "{\"benchmark\":\"shm-latency\",\"transport\":\"" << transport << "\",\"payload\":\"" << payload
+              << "\",\"bytes\":" << size
+              << ",\"iterations\":" << samples.size()
+              << ",\"mean_ns\":" << sum/samples.size()
+              << ",\"p50_ns\":" << samples[samples.size()/2]
+              << ",\"p99_ns\":" << samples[samples.size()*99/100]
+              << ",\"max_ns\":" << samples.back() << "}" << std::endl;
+}
+
+static void run(const std::string& transport, boost::asio::io_context& ioc, const std::shared_ptr<session::Session>& client, std::size_t size){
+    const std::string msg(size, 'x');
+    std::vector<std::uint64_t> samples;
+    samples.reserve(ITERATIONS);
+    for(std::size_t i = 0; i < WARMUP + ITERATIONS; ++i){
+        auto start = std::chrono::steady_clock::now();
+        {
+            auto lk = client->lock();
+            client->wbuf << msg;
+        }
+        client->write();
+        std::size_t received = 0;
+        while(received < size){
+            client->async_read([&](std::error_code){
+                auto lk = client->lock();
+                received += drain(client->rbuf, nullptr);
+            });
+            ioc.restart();
+            ioc.run();
+        }
+        auto end = std::chrono::steady_clock::now();
+        if(i >= WARMUP){
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count());
+        }
+    }
+    report(transport, "raw", size, samples);
+}
+
+static HttpRequest make_request(){
+    HttpRequest req{};
+    req.verb = HttpVerb::GET;
+    req.route = "/bench";
+    req.version = HttpVersion::V1_1;
+    req.headers.push_back(make_header(HttpHeaderField::HOST, "localhost"));
+    req.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+    return req;
+}
+
+static HttpResponse make_response(const std::string& body){
+    HttpResponse res{};
+    res.version = HttpVersion::V1_1;
+    res.status = HttpStatus::OK;
+    res.headers.push_back(make_header(HttpHeaderField::CONTENT_TYPE, "text/plain"));
+    res.headers.push_back(make_header(HttpHeaderField::CONTENT_LENGTH, std::to_string(body.size())));
+    res.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+    res.chunks.push_back(make_chunk(body));
+    return res;
+}
+
+template<class R>
+static bool complete(const R& r){
+    return r.num_headers > 0 && r.next_header == r.num_headers && r.next_chunk == r.num_chunks;
+}
+
+// Answer every request in the read buffer with a body of size bytes, then wait for more.
+static void serve(const std::shared_ptr<HttpPresentation>& p, std::size_t size){
+    p->async_read([p, size](std::error_code ec){
+        if(ec){
+            return;
+        }
+        while(complete(std::get<HttpRequest>(*p))){
+            std::get<HttpResponse>(*p) = make_response(std::string(size, 'x'));
+            p->write();
+            std::get<HttpRequest>(*p) = HttpRequest{};
+            p->read();
+        }
+        serve(p, size);
+    });
+}
+
+static void http_run(const std::string& transport, boost::asio::io_context& ioc, HttpPresentations& presentations, const std::shared_ptr<session::Session>& session, std::size_t size){
+    auto client = std::make_shared<HttpClientPresentation>(presentations, session);
+    std::vector<std::uint64_t> samples;
+    samples.reserve(ITERATIONS);
+    for(std::size_t i = 0; i < WARMUP + ITERATIONS; ++i){
+        auto start = std::chrono::steady_clock::now();
+        std::get<HttpRequest>(*client) = make_request();
+        std::get<HttpResponse>(*client) = HttpResponse{};
+        client->write();
+        while(!complete(std::get<HttpResponse>(*client))){
+            client->async_read([](std::error_code){});
+            ioc.restart();
+            ioc.run();
+        }
+        auto end = std::chrono::steady_clock::now();
+        if(i >= WARMUP){
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count());
+        }
+    }
+    report(transport, "http", size, samples);
+}
+
+// A connected pair of Unix domain sessions, and the pair of shared memory sessions set up through them.
+struct Transports
+{
+    std::shared_ptr<unix_session::uSession> client;
+    std::shared_ptr<unix_session::uSession> server;
+    std::shared_ptr<shm_session::shmSession> shm_client;
+    std::shared_ptr<shm_session::shmSession> shm_server;
+};
+
+static bool connect(Transports& t, boost::asio::io_context& client_ioc, boost::asio::io_context& server_ioc, unix_session::uServer& client_server, unix_session::uServer& server_server, shm_session::shmServer& client_shm, shm_session::shmServer& server_shm){
+    typedef boost::asio::local::stream_protocol::socket socket;
+    socket s1(client_ioc), s2(server_ioc);
+    boost::asio::local::connect_pair(s1, s2);
+    s1.non_blocking(true);
+    s2.non_blocking(true);
+    t.client = std::make_shared<unix_session::uSession>(std::move(s1), client_server);
+    t.server = std::make_shared<unix_session::uSession>(std::move(s2), server_server);
+
+    std::error_code ec;
+    t.shm_client = client_shm.open(t.client, ec);
+    if(ec){
+        std::cerr << "shm-latency:shmServer::open failed:" << ec.message() << std::endl;
+        return false;
+    }
+    t.shm_server = server_shm.accept(t.server, ec);
+    if(ec){
+        std::cerr << "shm-latency:shmServer::accept failed:" << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(){
+    boost::asio::io_context client_ioc, server_ioc;
+    unix_session::uServer client_server(client_ioc), server_server(server_ioc);
+    shm_session::shmServer client_shm(client_ioc), server_shm(server_ioc);
+    HttpPresentations client_presentations, server_presentations;
+
+    const std::size_t sizes[] = {64, 512};
+    Transports raw;
+    Transports http[2];
+    if(!connect(raw, client_ioc, server_ioc, client_server, server_server, client_shm, server_shm)){
+        return 1;
+    }
+    echo(raw.server);
+    echo(raw.shm_server);
+    for(std::size_t i = 0; i < 2; ++i){
+        if(!connect(http[i], client_ioc, server_ioc, client_server, server_server, client_shm, server_shm)){
+            return 1;
+        }
+        serve(std::make_shared<HttpPresentation>(server_presentations, http[i].server), sizes[i]);
+        serve(std::make_shared<HttpPresentation>(server_presentations, http[i].shm_server), sizes[i]);
+    }
+    std::thread t([&](){ server_ioc.run(); });
+    for(std::size_t size: sizes){
+        run("unix", client_ioc, raw.client, size);
+        run("shm", client_ioc, raw.shm_client, size);
+    }
+    for(std::size_t i = 0; i < 2; ++i){
+        http_run("unix", client_ioc, client_presentations, http[i].client, sizes[i]);
+        http_run("shm", client_ioc, client_presentations, http[i].shm_client, sizes[i]);
+    }
+    server_ioc.stop();
+    t.join();
+    return 0;
+}
@@ -4,7 +4,7 @@
 * file, You can obtain one at https://mozilla.org/MPL/2.0/.
 */
 #include <iostream>
-int main(int arg, char* argv[]){
+int main(){
     std::cout << "Hello World!" << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,172 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "counters.hpp"
+#include <malloc.h>
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace metrics
+{
+    thread_local Shard* current = nullptr;
+
+    namespace
+    {
+        struct Registry
+        {
+            std::mutex mtx;
+            std::vector<Shard*> shards;
+            // The counts of threads that have exited.
+            Snapshot retired;
+        };
+
+        Registry& registry(){
+            // Never destroyed, so that threads that exit during static destruction can still detach.
+            static Registry* r = new Registry();
+            return *r;
+        }
+
+        void collect(const Shard& shard, Snapshot& s){
+            for(std::size_t i = 0; i < COUNTERS; ++i){
+                s.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+            }
+            for(std::size_t i = 0; i < PEAKS; ++i){
+                s.peaks[i] = std::max(s.peaks[i], shard.peaks[i].load(std::memory_order_relaxed));
+            }
+        }
+
+        // Folds the shard of an exiting thread into the retired counts.
+        struct Detach
+        {
+            ~Detach(){
+                if(!current){
+                    return;
+                }
+                auto& r = registry();
+                {
+                    std::lock_guard<std::mutex> lk(r.mtx);
+                    collect(*current, r.retired);
+                    r.shards.erase(std::find(r.shards.begin(), r.shards.end(), current));
+                }
+                delete current;
+                current = nullptr;
+            }
+        };
+        thread_local Detach detach;
+
+        struct Description
+        {
+            const char* name;
+            const char* type;
+            const char* help;
+        };
+
+        const Description counters[COUNTERS] = {
+            {"openosi_session_read_bytes_total", "counter", "Bytes read from sessions."},
+            {"openosi_session_written_bytes_total", "counter", "Bytes written to sessions."},
+            {"openosi_session_reads_total", "counter", "Read system calls on sessions."},
+            {"openosi_session_writes_total", "counter", "Write system calls on sessions."},
+            {"openosi_http_requests_parsed_total", "counter", "HTTP requests parsed."},
+            {"openosi_http_parse_errors_total", "counter", "HTTP requests that could not be parsed."},
+            {"openosi_sessions_opened_total", "counter", "Sessions opened."},
+            {"openosi_sessions_closed_total", "counter", "Sessions closed."},
+            {"openosi_session_lock_contended_total", "counter", "Session locks that had to be waited for."},
+            {"openosi_session_lock_wait_seconds_total", "counter", "Time spent waiting for session locks."},
+            {"openosi_buffer_borrows_total", "counter", "Blocks borrowed from the session buffer pool."},
+            {"openosi_buffer_returns_total", "counter", "Blocks given back to the session buffer pool."},
+            {"openosi_buffer_allocated_bytes_total", "counter", "Bytes allocated for the session buffer pool."},
+            {"openosi_buffer_freed_bytes_total", "counter", "Bytes freed by the session buffer pool."},
+            {"openosi_session_reads_blocked_total", "counter", "Times that a session stopped reading at its high watermark."},
+            {"openosi_session_writes_blocked_total", "counter", "Times that a session suspended writes at its high watermark."},
+            {"openosi_sessions_timed_out_total", "counter", "Sessions closed for missing a deadline."}
+        };
+
+        const Description peaks[PEAKS] = {
+            {"openosi_session_rbuf_high_water_bytes", "gauge", "The most bytes waiting in a session read buffer."},
+            {"openosi_session_wbuf_high_water_bytes", "gauge", "The most bytes waiting in a session write buffer."}
+        };
+
+        void header(std::ostream& os, const Description& d){
+            os << "# HELP " << d.name << ' ' << d.help << '\n' << "# TYPE " << d.name << ' ' << d.type << '\n';
+        }
+    }
+
+    Shard* attach(){
+        current = new Shard();
+        // Touch the thread's detach so that it is constructed, and destroyed when the thread exits.
+        (void)&detach;
+        auto& r = registry();
+        std::lock_guard<std::mutex> lk(r.mtx);
+        r.shards.push_back(current);
+        return current;
+    }
+
+    Snapshot snapshot(){
+        auto& r = registry();
+        std::lock_guard<std::mutex> lk(r.mtx);
+        Snapshot s = r.retired;
+        for(const Shard* shard: r.shards){
+            collect(*shard, s);
+        }
+        return s;
+    }
+
+    void prometheus(std::ostream& os, const Snapshot& s){
+        for(std::size_t i = 0; i < COUNTERS; ++i){
+            header(os, counters[i]);
+            os << counters[i].name << ' ';
+            if(i == static_cast<std::size_t>(Counter::LOCK_WAIT_NS)){
+                os << s.counters[i] / 1e9;
+            } else {
+                os << s.counters[i];
+            }
+            os << '\n';
+        }
+        for(std::size_t i = 0; i < PEAKS; ++i){
+            header(os, peaks[i]);
+            os << peaks[i].name << ' ' << s.peaks[i] << '\n';
+        }
+        const Description active{"openosi_sessions_active", "gauge", "Sessions that are open."};
+        header(os, active);
+        os << active.name << ' ' << s.active_sessions() << '\n';
+    }
+
+    Allocator allocator(){
+        Allocator a;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 mi = ::mallinfo2();
+        a.arena = mi.arena;
+        a.mmapped = mi.hblkhd;
+        a.in_use = mi.uordblks + mi.hblkhd;
+        a.free = mi.fordblks;
+        a.releasable = mi.keepcost;
+#endif
+        return a;
+    }
+
+    void prometheus(std::ostream& os, const Allocator& a){
+        const Description gauges[] = {
+            {"openosi_malloc_arena_bytes", "gauge", "Bytes in the arenas of the allocator."},
+            {"openosi_malloc_mmapped_bytes", "gauge", "Bytes allocated in separate mappings."},
+            {"openosi_malloc_in_use_bytes", "gauge", "Bytes allocated."},
+            {"openosi_malloc_free_bytes", "gauge", "Free bytes in the arenas of the allocator."},
+            {"openosi_malloc_releasable_bytes", "gauge", "Free bytes that malloc_trim could give back to the system."}
+        };
+        const std::uint64_t values[] = {a.arena, a.mmapped, a.in_use, a.free, a.releasable};
+        for(std::size_t i = 0; i < sizeof(values)/sizeof(values[0]); ++i){
+            header(os, gauges[i]);
+            os << gauges[i].name << ' ' << values[i] << '\n';
+        }
+    }
+
+    std::string prometheus(){
+        std::ostringstream os;
+        prometheus(os, snapshot());
+        prometheus(os, allocator());
+        return os.str();
+    }
+}
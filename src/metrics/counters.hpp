@@ -0,0 +1,115 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+namespace metrics
+{
+    enum class Counter: std::size_t
+    {
+        BYTES_READ,
+        BYTES_WRITTEN,
+        // System calls that read or write a session's socket.
+        READS,
+        WRITES,
+        REQUESTS_PARSED,
+        PARSE_ERRORS,
+        SESSIONS_OPENED,
+        SESSIONS_CLOSED,
+        // Session locks that were already held by another thread, and the time spent waiting for them.
+        LOCK_CONTENDED,
+        LOCK_WAIT_NS,
+        // Session buffer blocks (see session::BufferPool), and the memory taken from and given back to the system for them.
+        BUFFER_BORROWS,
+        BUFFER_RETURNS,
+        BUFFER_ALLOCATED_BYTES,
+        BUFFER_FREED_BYTES,
+        // Times that a session stopped reading, or suspended its producers, at a high watermark (see session::Watermarks).
+        READS_BLOCKED,
+        WRITES_BLOCKED,
+        // Sessions closed by a TimerWheel for missing a deadline.
+        SESSIONS_TIMED_OUT,
+        COUNTERS
+    };
+
+    // The largest value that has been seen.
+    enum class Peak: std::size_t
+    {
+        // Bytes waiting in a session's read or write buffer.
+        RBUF_BYTES,
+        WBUF_BYTES,
+        PEAKS
+    };
+
+    static constexpr std::size_t COUNTERS = static_cast<std::size_t>(Counter::COUNTERS);
+    static constexpr std::size_t PEAKS = static_cast<std::size_t>(Peak::PEAKS);
+
+    /*
+    *  Every thread counts into its own shard, on its own cache lines, so counting never contends with another core.
+    *  A shard has only one writer, so updates are a plain load and store rather than a locked read-modify-write.
+    *  The counters are atomic only so that they can be read from other threads; readers sum the shards (and take the
+    *  largest of the peaks), along with whatever was counted by threads that have exited.
+    */
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<std::uint64_t>, COUNTERS> counters{};
+        std::array<std::atomic<std::uint64_t>, PEAKS> peaks{};
+    };
+
+    // The shard of the calling thread, it is created the first time that the thread counts something.
+    extern thread_local Shard* current;
+    Shard* attach();
+    inline Shard& shard() { return current ? *current : *attach(); }
+
+    inline void add(Counter counter, std::uint64_t n = 1){
+        auto& c = shard().counters[static_cast<std::size_t>(counter)];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline void peak(Peak p, std::uint64_t value){
+        auto& c = shard().peaks[static_cast<std::size_t>(p)];
+        if(value > c.load(std::memory_order_relaxed)){
+            c.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    struct Snapshot
+    {
+        std::array<std::uint64_t, COUNTERS> counters{};
+        std::array<std::uint64_t, PEAKS> peaks{};
+
+        std::uint64_t operator[](Counter c) const { return counters[static_cast<std::size_t>(c)]; }
+        std::uint64_t operator[](Peak p) const { return peaks[static_cast<std::size_t>(p)]; }
+        std::uint64_t active_sessions() const { return (*this)[Counter::SESSIONS_OPENED] - (*this)[Counter::SESSIONS_CLOSED]; }
+    };
+
+    // The counts of every thread, added up.
+    Snapshot snapshot();
+
+    // The statistics of the C allocator (glibc's mallinfo2), all zero where they are not available.
+    struct Allocator
+    {
+        // Bytes that the allocator has taken from the system, in its arenas and in separate mappings.
+        std::uint64_t arena = 0;
+        std::uint64_t mmapped = 0;
+        // Bytes that are allocated, and that are free within the arenas.
+        std::uint64_t in_use = 0;
+        std::uint64_t free = 0;
+        // Free bytes at the top of the main arena that malloc_trim could give back.
+        std::uint64_t releasable = 0;
+    };
+    Allocator allocator();
+
+    // Write the counters in the Prometheus text exposition format.
+    void prometheus(std::ostream& os, const Snapshot& s);
+    void prometheus(std::ostream& os, const Allocator& a);
+    std::string prometheus();
+}
+#endif
@@ -0,0 +1,51 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "histogram.hpp"
+#include <cmath>
+
+namespace metrics
+{
+    template<class Count>
+    std::uint64_t BasicHistogram<Count>::lowest(std::size_t bucket){
+        if(bucket < LINEAR){
+            return bucket;
+        }
+        std::size_t i = bucket - LINEAR;
+        unsigned shift = static_cast<unsigned>(i / HALF) + 1;
+        return static_cast<std::uint64_t>(HALF + i % HALF) << shift;
+    }
+
+    template<class Count>
+    std::uint64_t BasicHistogram<Count>::highest(std::size_t bucket){
+        if(bucket < LINEAR){
+            return bucket;
+        }
+        unsigned shift = static_cast<unsigned>((bucket - LINEAR) / HALF) + 1;
+        return lowest(bucket) + ((std::uint64_t(1) << shift) - 1);
+    }
+
+    template<class Count>
+    std::uint64_t BasicHistogram<Count>::percentile(double p) const {
+        std::uint64_t count = _count;
+        if(count == 0){
+            return 0;
+        }
+        std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(p / 100 * count));
+        rank = rank < 1 ? 1 : (rank > count ? count : rank);
+        std::uint64_t seen = 0;
+        for(std::size_t i = 0; i < BUCKETS; ++i){
+            seen += _counts[i];
+            if(seen >= rank){
+                std::uint64_t value = highest(i);
+                return value < _max ? value : static_cast<std::uint64_t>(_max);
+            }
+        }
+        return _max;
+    }
+
+    template class BasicHistogram<std::uint64_t>;
+    template class BasicHistogram<Relaxed>;
+}
@@ -0,0 +1,117 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+namespace metrics
+{
+    // A count with a single writer that any thread may read.
+    // Updates are a relaxed load and store, which cost the same as those of a plain integer.
+    class Relaxed
+    {
+        std::atomic<std::uint64_t> _value;
+
+    public:
+        Relaxed(std::uint64_t value = 0): _value(value) {}
+        Relaxed(const Relaxed& other): _value(other) {}
+        Relaxed& operator=(const Relaxed& other) { return *this = static_cast<std::uint64_t>(other); }
+        Relaxed& operator=(std::uint64_t value) { _value.store(value, std::memory_order_relaxed); return *this; }
+        Relaxed& operator+=(std::uint64_t n) { return *this = *this + n; }
+        operator std::uint64_t() const { return _value.load(std::memory_order_relaxed); }
+    };
+
+    /*
+    *  An HDR (high dynamic range) histogram of unsigned 64 bit values, such as latencies in nanoseconds.
+    *  Values below 2^PRECISION are counted exactly, larger values in buckets that are at most 1/2^(PRECISION-1) of their value wide,
+    *  so every value from 1 ns to centuries is covered with a bounded relative error, in a fixed amount of memory.
+    *  Recording a value is a handful of integer instructions and never allocates.
+    *  Histograms are not synchronized: each thread records into its own, and they are merged when they are read.
+    *  Histograms that are merged while their thread is still recording keep their counts in Relaxed (ConcurrentHistogram),
+    *  a merge then sees every count as it was at some point, though not all of them at the same point.
+    */
+    template<class Count>
+    class BasicHistogram
+    {
+    public:
+        static constexpr unsigned PRECISION = 7;
+        static constexpr std::size_t LINEAR = std::size_t(1) << PRECISION;
+        static constexpr std::size_t HALF = LINEAR / 2;
+        static constexpr std::size_t BUCKETS = LINEAR + (64 - PRECISION) * HALF;
+
+    private:
+        std::array<Count, BUCKETS> _counts{};
+        Count _count = 0;
+        Count _sum = 0;
+        Count _min = std::numeric_limits<std::uint64_t>::max();
+        Count _max = 0;
+
+        template<class Other>
+        friend class BasicHistogram;
+
+    public:
+        static std::size_t bucket(std::uint64_t value){
+            if(value < LINEAR){
+                return static_cast<std::size_t>(value);
+            }
+            unsigned shift = 63 - __builtin_clzll(value) - PRECISION + 1;
+            return LINEAR + (shift - 1) * HALF + static_cast<std::size_t>((value >> shift) - HALF);
+        }
+        // The smallest and the largest value that are counted in a bucket.
+        static std::uint64_t lowest(std::size_t bucket);
+        static std::uint64_t highest(std::size_t bucket);
+
+        void record(std::uint64_t value, std::uint64_t count = 1){
+            _counts[bucket(value)] += count;
+            _count += count;
+            _sum += value * count;
+            if(value < _min){
+                _min = value;
+            }
+            if(value > _max){
+                _max = value;
+            }
+        }
+        template<class Other>
+        void merge(const BasicHistogram<Other>& other){
+            for(std::size_t i = 0; i < BUCKETS; ++i){
+                _counts[i] += other._counts[i];
+            }
+            _count += other._count;
+            _sum += other._sum;
+            _min = std::min<std::uint64_t>(_min, other._min);
+            _max = std::max<std::uint64_t>(_max, other._max);
+        }
+        void reset(){
+            *this = BasicHistogram();
+        }
+
+        std::uint64_t count() const { return _count; }
+        std::uint64_t sum() const { return _sum; }
+        std::uint64_t min() const { return _count ? static_cast<std::uint64_t>(_min) : 0; }
+        std::uint64_t max() const { return _max; }
+        double mean() const { return _count ? static_cast<double>(_sum) / _count : 0; }
+        // The largest value counted in the bucket that holds the pth percentile (0 < p <= 100) of the values.
+        std::uint64_t percentile(double p) const;
+        std::uint64_t operator[](std::size_t bucket) const { return _counts[bucket]; }
+
+        // Call fn(highest, count) for every bucket that has been counted, in order.
+        template<class F>
+        void for_each(F&& fn) const {
+            for(std::size_t i = 0; i < BUCKETS; ++i){
+                if(_counts[i]){
+                    fn(highest(i), static_cast<std::uint64_t>(_counts[i]));
+                }
+            }
+        }
+    };
+    typedef BasicHistogram<std::uint64_t> Histogram;
+    typedef BasicHistogram<Relaxed> ConcurrentHistogram;
+}
+#endif
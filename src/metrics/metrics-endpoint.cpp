@@ -0,0 +1,97 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <sstream>
+#include "metrics-endpoint.hpp"
+
+namespace metrics
+{
+    using namespace http;
+    using namespace http::h_presentation;
+
+    static const HttpResponseTemplate& ok(){
+        static const HttpResponseTemplate tmpl(HttpVersion::V1_1, HttpStatus::OK, {
+            make_header(HttpHeaderField::CONTENT_TYPE, "text/plain; version=0.0.4")
+        });
+        return tmpl;
+    }
+
+    static const HttpResponseTemplate& not_found(){
+        static const HttpResponseTemplate tmpl(HttpVersion::V1_1, HttpStatus::NOT_FOUND, {
+            make_header(HttpHeaderField::CONTENT_TYPE, "text/plain")
+        });
+        return tmpl;
+    }
+
+    Endpoint::Endpoint(boost::asio::io_context& ioc, const Endpoint::endpoint& endpoint): _server(ioc, endpoint) {}
+
+    void Endpoint::accept(){
+        _server.accept([&](const std::error_code& ec, std::shared_ptr<unix_session::uSession> session){
+            if(!ec){
+                serve(std::make_shared<HttpPresentation>(_presentations, session));
+            }
+        });
+    }
+
+    // Answer every request in the read buffer, then wait for more.
+    void Endpoint::serve(const std::shared_ptr<HttpPresentation>& p){
+        p->async_read([&, p](std::error_code ec){
+            if(ec){
+                auto session = std::static_pointer_cast<unix_session::uSession>(p->session);
+                session->close();
+                _server.close(session);
+                return;
+            }
+            while(complete(std::get<HttpRequest>(*p))){
+                auto& req = std::get<HttpRequest>(*p);
+                if(req.verb == HttpVerb::GET && path(req) == "/metrics"){
+                    req = HttpRequest{};
+                    p->write(ok(), scrape());
+                } else {
+                    req = HttpRequest{};
+                    p->write(not_found(), "Not Found\n");
+                }
+                p->read();
+            }
+            serve(p);
+        });
+    }
+
+    std::string Endpoint::scrape(){
+        std::ostringstream os;
+        prometheus(os, snapshot());
+        prometheus(os, allocator());
+        for(auto& collector: _collectors){
+            collector(os);
+        }
+        return os.str();
+    }
+
+    void prometheus(std::ostream& os, std::string_view name, session::Server& server){
+        session::Statistics s = server.statistics();
+        session::Memory m = server.memory();
+        struct { const char* name; const char* type; std::uint64_t value; } metrics[] = {
+            {"openosi_server_sessions_total", "counter", server.total()},
+            {"openosi_server_read_bytes_total", "counter", s.bytes_read},
+            {"openosi_server_written_bytes_total", "counter", s.bytes_written},
+            {"openosi_server_reads_total", "counter", s.reads},
+            {"openosi_server_writes_total", "counter", s.writes},
+            {"openosi_server_rbuf_high_water_bytes", "gauge", s.rbuf_high_water},
+            {"openosi_server_wbuf_high_water_bytes", "gauge", s.wbuf_high_water},
+            {"openosi_server_rbuf_held_bytes", "gauge", m.rbuf},
+            {"openosi_server_wbuf_held_bytes", "gauge", m.wbuf},
+            {"openosi_server_rbuf_held_peak_bytes", "gauge", m.rbuf_peak},
+            {"openosi_server_wbuf_held_peak_bytes", "gauge", m.wbuf_peak}
+        };
+        for(auto& m: metrics){
+            os << "# TYPE " << m.name << ' ' << m.type << '\n' << m.name << "{server=\"" << name << "\"} " << m.value << '\n';
+        }
+    }
+
+    void prometheus(std::ostream& os, std::string_view name, HttpPresentations& presentations){
+        const char* metric = "openosi_presentation_message_bytes";
+        os << "# TYPE " << metric << " gauge\n" << metric << "{presentations=\"" << name << "\"} " << presentations.memory() << '\n';
+    }
+}
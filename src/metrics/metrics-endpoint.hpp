@@ -0,0 +1,52 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef METRICS_ENDPOINT_HPP
+#define METRICS_ENDPOINT_HPP
+#include <functional>
+#include <ostream>
+#include <vector>
+#include "counters.hpp"
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../presentation-layer/http-presentation/http-presentation.hpp"
+namespace metrics
+{
+    /*
+    *  Serves GET /metrics in the Prometheus text format over HTTP/1.1, on a Unix domain socket of its own
+    *  so that scrapes do not queue behind the traffic that is being measured.
+    *  Every scrape writes the counters and the allocator statistics (metrics::prometheus) followed by the output of each
+    *  collector, in the order that they were added, e.g. the statistics of a particular server.
+    *  The endpoint runs on the io_context that it is given, collectors are called from that io_context.
+    */
+    class Endpoint
+    {
+        typedef boost::asio::local::stream_protocol::endpoint endpoint;
+        typedef std::function<void(std::ostream& os)> Collector;
+
+        unix_session::uServer _server;
+        http::h_presentation::HttpPresentations _presentations;
+        std::vector<Collector> _collectors;
+
+        void accept();
+        void serve(const std::shared_ptr<http::h_presentation::HttpPresentation>& p);
+
+        public:
+            Endpoint(boost::asio::io_context& ioc, const endpoint& endpoint);
+
+            // Add a collector before the endpoint is started.
+            void add(Collector collector) { _collectors.push_back(std::move(collector)); }
+            void start() { accept(); }
+            // The body of a scrape.
+            std::string scrape();
+
+            ~Endpoint() = default;
+    };
+
+    // Write the statistics and the buffer memory of a server, labelled with server="name".
+    void prometheus(std::ostream& os, std::string_view name, session::Server& server);
+    // Write the heap bytes held by the messages of the presentations, labelled with presentations="name".
+    void prometheus(std::ostream& os, std::string_view name, http::h_presentation::HttpPresentations& presentations);
+}
+#endif
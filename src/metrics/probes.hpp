@@ -0,0 +1,44 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef PROBES_HPP
+#define PROBES_HPP
+/*
+*  USDT (statically defined tracing) probes for bpftrace, perf and SystemTap.
+*  The probes are named in the ELF notes of the binary, so they stay put when LTO renames or inlines functions,
+*  and cost a nop until a tracer attaches to them. They are compiled in if <sys/sdt.h> (systemtap-sdt-dev) is found
+*  and NO_PROBES is not defined, e.g.
+*
+*      bpftrace -e 'usdt:./bin/open-osi:open_osi:read { @bytes = hist(arg2); }'
+*
+*  Every probe carries the address of the session as its first argument.
+*      open_osi:accept(session, fd)
+*      open_osi:session__open(session, fd)
+*      open_osi:session__close(session, fd)
+*      open_osi:read(session, fd, bytes)
+*      open_osi:write(session, fd, bytes)
+*      open_osi:request__line(session, verb, route)           verb is an http::HttpVerb, route a C string.
+*      open_osi:headers(session, num_headers)
+*      open_osi:body(session, num_chunks, bytes)
+*/
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define OSI_PROBE(name, ...) STAP_PROBEV(open_osi, name, __VA_ARGS__)
+namespace metrics
+{
+    static constexpr bool PROBES = true;
+}
+#endif
+#endif
+
+#if !defined(OSI_PROBE)
+#define OSI_PROBE(name, ...) do {} while(0)
+namespace metrics
+{
+    static constexpr bool PROBES = false;
+}
+#endif
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "route-latency.hpp"
+
+namespace metrics
+{
+    namespace
+    {
+        struct Indices
+        {
+            std::mutex mtx;
+            std::vector<std::size_t> spare;
+            std::size_t next = 0;
+        };
+
+        Indices& indices(){
+            // Never destroyed, so that threads that exit during static destruction can still give their index back.
+            static Indices* i = new Indices();
+            return *i;
+        }
+
+        struct Index
+        {
+            std::size_t value;
+
+            Index(){
+                auto& i = indices();
+                std::lock_guard<std::mutex> lk(i.mtx);
+                if(i.spare.empty()){
+                    value = i.next++;
+                } else {
+                    value = i.spare.back();
+                    i.spare.pop_back();
+                }
+            }
+
+            ~Index(){
+                auto& i = indices();
+                std::lock_guard<std::mutex> lk(i.mtx);
+                i.spare.push_back(value);
+            }
+        };
+
+        const char* verb(http::HttpVerb verb){
+            switch(verb)
+            {
+                case http::HttpVerb::GET:
+                    return "GET";
+                case http::HttpVerb::POST:
+                    return "POST";
+                case http::HttpVerb::PATCH:
+                    return "PATCH";
+                case http::HttpVerb::PUT:
+                    return "PUT";
+                case http::HttpVerb::TRACE:
+                    return "TRACE";
+                case http::HttpVerb::DELETE:
+                    return "DELETE";
+                case http::HttpVerb::CONNECT:
+                    return "CONNECT";
+                default:
+                    return "";
+            }
+        }
+
+        // Label values escape backslashes, double quotes and line feeds.
+        void label(std::ostream& os, std::string_view value){
+            for(char c: value){
+                switch(c)
+                {
+                    case '\\':
+                        os << "\\\\";
+                        break;
+                    case '"':
+                        os << "\\\"";
+                        break;
+                    case '\n':
+                        os << "\\n";
+                        break;
+                    default:
+                        os << c;
+                }
+            }
+        }
+    }
+
+    std::size_t thread_index(){
+        thread_local Index index;
+        return index.value;
+    }
+
+    RouteLatency::Slot* RouteLatency::attach(std::size_t thread){
+        std::lock_guard<std::mutex> lk(_mtx);
+        Slot* shard = _shards[thread].load(std::memory_order_relaxed);
+        if(!shard){
+            shard = new Slot[_routes.size() + 1];
+            for(std::size_t i = 0; i <= _routes.size(); ++i){
+                shard[i].store(nullptr, std::memory_order_relaxed);
+            }
+            _shards[thread].store(shard, std::memory_order_release);
+        }
+        return shard;
+    }
+
+    ConcurrentHistogram* RouteLatency::allocate(RouteLatency::Slot& slot){
+        ConcurrentHistogram* h = new ConcurrentHistogram();
+        slot.store(h, std::memory_order_release);
+        return h;
+    }
+
+    Histogram RouteLatency::histogram(std::uint32_t route) const {
+        Histogram h;
+        for(auto& s: _shards){
+            const Slot* shard = s.load(std::memory_order_acquire);
+            if(!shard){
+                continue;
+            }
+            const ConcurrentHistogram* c = shard[index(route)].load(std::memory_order_acquire);
+            if(c){
+                h.merge(*c);
+            }
+        }
+        return h;
+    }
+
+    void RouteLatency::prometheus(std::ostream& os, std::string_view name) const {
+        os << "# TYPE " << name << " summary\n";
+        for(std::size_t i = 0; i <= _routes.size(); ++i){
+            std::uint32_t route = i < _routes.size() ? static_cast<std::uint32_t>(i) : UNMATCHED;
+            Histogram h = histogram(route);
+            if(h.count() == 0){
+                continue;
+            }
+            auto labels = [&](){
+                os << "{verb=\"" << (i < _routes.size() ? verb(_routes[i].verb) : "") << "\",route=\"";
+                if(i < _routes.size()){
+                    label(os, _routes[i].pattern);
+                }
+                os << '"';
+            };
+            for(double q: {0.5, 0.9, 0.99, 0.999}){
+                os << name;
+                labels();
+                os << ",quantile=\"" << q << "\"} " << h.percentile(q * 100) / 1e9 << '\n';
+            }
+            os << name << "_sum";
+            labels();
+            os << "} " << h.sum() / 1e9 << '\n' << name << "_count";
+            labels();
+            os << "} " << h.count() << '\n';
+        }
+    }
+
+    RouteLatency::~RouteLatency(){
+        for(auto& s: _shards){
+            Slot* shard = s.load(std::memory_order_relaxed);
+            if(!shard){
+                continue;
+            }
+            for(std::size_t i = 0; i <= _routes.size(); ++i){
+                delete shard[i].load(std::memory_order_relaxed);
+            }
+            delete[] shard;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef ROUTE_LATENCY_HPP
+#define ROUTE_LATENCY_HPP
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "histogram.hpp"
+#include "../presentation-layer/http-presentation/http-router.hpp"
+namespace metrics
+{
+    // A small number for the calling thread, below the number of threads that are running at once.
+    // Numbers are reused once their threads exit.
+    std::size_t thread_index();
+
+    /*
+    *  Latency histograms per route, keyed by the verb and the template of each route of an HttpRouter,
+    *  plus one for requests that matched no route.
+    *  Every thread records into histograms of its own, so recording is lock-free and never contends with another thread.
+    *  A thread's histogram for a route is allocated the first time that the thread records a request for it,
+    *  routes that a thread never serves only cost it a pointer.
+    *  Reads merge the histograms of every thread; a thread's histograms are kept when it exits, for the next thread
+    *  that gets its thread_index(). Threads beyond MAX_THREADS are not recorded.
+    */
+    class RouteLatency
+    {
+    public:
+        static constexpr std::uint32_t UNMATCHED = http::HttpRouteTree::NONE;
+        static constexpr std::size_t MAX_THREADS = 256;
+
+    private:
+        // Only the thread that owns a slot stores to it, readers load it.
+        typedef std::atomic<ConcurrentHistogram*> Slot;
+
+        std::vector<http::HttpRoute> _routes;
+        // For each thread, a slot per route followed by the one for unmatched requests.
+        std::array<std::atomic<Slot*>, MAX_THREADS> _shards{};
+        std::mutex _mtx;
+
+        Slot* attach(std::size_t thread);
+        static ConcurrentHistogram* allocate(Slot& slot);
+        std::size_t index(std::uint32_t route) const { return route < _routes.size() ? route : _routes.size(); }
+
+    public:
+        explicit RouteLatency(std::vector<http::HttpRoute> routes): _routes(std::move(routes)) {}
+        template<class Handler>
+        explicit RouteLatency(const http::HttpRouter<Handler>& router){
+            for(std::uint32_t i = 0; i < router.size(); ++i){
+                _routes.push_back(router.route(i));
+            }
+        }
+        RouteLatency(const RouteLatency&) = delete;
+        RouteLatency& operator=(const RouteLatency&) = delete;
+
+        // Record the latency of a request that matched route (a number from HttpRouter::find), or UNMATCHED.
+        void record(std::uint32_t route, std::uint64_t ns){
+            std::size_t thread = thread_index();
+            if(thread >= MAX_THREADS){
+                return;
+            }
+            Slot* shard = _shards[thread].load(std::memory_order_acquire);
+            if(!shard){
+                shard = attach(thread);
+            }
+            Slot& slot = shard[index(route)];
+            ConcurrentHistogram* h = slot.load(std::memory_order_relaxed);
+            if(!h){
+                h = allocate(slot);
+            }
+            h->record(ns);
+        }
+
+        // The latencies of a route (or UNMATCHED), merged over every thread.
+        Histogram histogram(std::uint32_t route) const;
+        std::size_t size() const { return _routes.size(); }
+        const http::HttpRoute& route(std::uint32_t i) const { return _routes[i]; }
+
+        // Write a Prometheus summary, in seconds, labelled with the verb and the template of each route that has been recorded.
+        // Unmatched requests have empty labels.
+        void prometheus(std::ostream& os, std::string_view name = "openosi_http_request_duration_seconds") const;
+
+        ~RouteLatency();
+    };
+}
+#endif
@@ -0,0 +1,150 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "trace.hpp"
+#include <unistd.h>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio/signal_set.hpp>
+
+namespace metrics
+{
+    std::atomic<bool> tracing_enabled{false};
+
+    void start_tracing(){ tracing_enabled.store(true, std::memory_order_relaxed); }
+    void stop_tracing(){ tracing_enabled.store(false, std::memory_order_relaxed); }
+
+    namespace
+    {
+        // Only the thread that owns the ring writes to it. The head counts every event that has been recorded,
+        // event i is in slot i % TRACE_EVENTS until event i + TRACE_EVENTS overwrites it.
+        struct Ring
+        {
+            std::atomic<std::uint64_t> head{0};
+            std::size_t tid;
+            TraceEvent events[TRACE_EVENTS];
+        };
+
+        struct Registry
+        {
+            std::mutex mtx;
+            std::vector<std::unique_ptr<Ring> > rings;
+            // Rings of threads that have exited, their events are kept until another thread reuses them.
+            std::vector<Ring*> spare;
+        };
+
+        Registry& registry(){
+            // Never destroyed, so that threads that exit during static destruction can still detach.
+            static Registry* r = new Registry();
+            return *r;
+        }
+
+        thread_local Ring* ring = nullptr;
+
+        struct Detach
+        {
+            ~Detach(){
+                if(ring){
+                    auto& r = registry();
+                    std::lock_guard<std::mutex> lk(r.mtx);
+                    r.spare.push_back(ring);
+                    ring = nullptr;
+                }
+            }
+        };
+        thread_local Detach detach;
+
+        Ring* attach(){
+            (void)&detach;
+            auto& r = registry();
+            std::lock_guard<std::mutex> lk(r.mtx);
+            if(!r.spare.empty()){
+                ring = r.spare.back();
+                r.spare.pop_back();
+            } else {
+                r.rings.push_back(std::make_unique<Ring>());
+                ring = r.rings.back().get();
+                ring->tid = r.rings.size();
+            }
+            return ring;
+        }
+
+        const char* const names[static_cast<std::size_t>(Event::EVENTS)] = {
+            "accept", "wakeup", "read", "write", "parse", "application", "close"
+        };
+
+        // Chrome traces are in microseconds.
+        void microseconds(std::ostream& os, std::uint64_t ns){
+            os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+        }
+    }
+
+    void record(const TraceEvent& event){
+        Ring* r = ring ? ring : attach();
+        std::uint64_t head = r->head.load(std::memory_order_relaxed);
+        r->events[head % TRACE_EVENTS] = event;
+        r->head.store(head + 1, std::memory_order_release);
+    }
+
+    void chrome_trace(std::ostream& os){
+        auto& r = registry();
+        std::lock_guard<std::mutex> lk(r.mtx);
+        auto pid = ::getpid();
+        std::vector<TraceEvent> events;
+        bool first = true;
+        os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        for(auto& rp: r.rings){
+            std::uint64_t head = rp->head.load(std::memory_order_acquire);
+            std::uint64_t from = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+            events.clear();
+            for(std::uint64_t i = from; i < head; ++i){
+                events.push_back(rp->events[i % TRACE_EVENTS]);
+            }
+            // The owner may have moved on while the events were copied, and may be writing the slot of event head - TRACE_EVENTS.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            std::uint64_t now = rp->head.load(std::memory_order_relaxed);
+            std::uint64_t valid = now + 1 > TRACE_EVENTS ? now + 1 - TRACE_EVENTS : 0;
+            for(std::uint64_t i = std::max(from, valid); i < head; ++i){
+                const TraceEvent& e = events[i - from];
+                os << (first ? "" : ",") << "\n{\"name\":\"" << names[static_cast<std::size_t>(e.event)]
+                   << "\",\"cat\":\"session\",\"pid\":" << pid << ",\"tid\":" << rp->tid << ",\"ts\":";
+                microseconds(os, e.start);
+                if(e.instant){
+                    os << ",\"ph\":\"i\",\"s\":\"t\"";
+                } else {
+                    os << ",\"ph\":\"X\",\"dur\":";
+                    microseconds(os, e.duration);
+                }
+                os << ",\"args\":{\"session\":\"" << e.id << "\",\"bytes\":" << e.bytes << "}}";
+                first = false;
+            }
+        }
+        os << "\n]}\n";
+    }
+
+    bool chrome_trace(const std::string& path){
+        std::ofstream out(path);
+        chrome_trace(out);
+        out.close();
+        return !out.fail();
+    }
+
+    static void wait(const std::shared_ptr<boost::asio::signal_set>& signals, const std::string& path){
+        signals->async_wait([signals, path](const boost::system::error_code& ec, int){
+            if(ec){
+                return;
+            }
+            chrome_trace(path);
+            wait(signals, path);
+        });
+    }
+
+    void dump_on_signal(boost::asio::io_context& ioc, int signo, const std::string& path){
+        wait(std::make_shared<boost::asio::signal_set>(ioc, signo), path);
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <boost/asio/io_context.hpp>
+namespace metrics
+{
+    // The lifecycle of a session and of the requests on it.
+    enum class Event: std::uint8_t
+    {
+        ACCEPT,
+        // async_wait found the socket ready.
+        WAKEUP,
+        // uSession reading and writing the socket, with the bytes transferred.
+        READ,
+        WRITE,
+        // The HTTP parser (operator>>).
+        PARSE,
+        // From a request being complete to its response being written.
+        APPLICATION,
+        CLOSE,
+        EVENTS
+    };
+
+    /*
+    *  Opt-in tracing of lifecycle events into a lock-free ring buffer per thread.
+    *  Each thread only writes to its own ring, so recording never contends; the newest TRACE_EVENTS events
+    *  of every thread are kept, older ones are overwritten. Rings are allocated when a thread first records
+    *  an event, so nothing is allocated until tracing is started.
+    *  While tracing is stopped every trace point is a single, predictable, branch on a relaxed load.
+    *  Building with -D NO_TRACING removes the trace points altogether.
+    *  Events are exported in the Chrome trace event format (JSON), which chrome://tracing and Perfetto load.
+    */
+    static constexpr std::size_t TRACE_EVENTS = std::size_t(1) << 16;
+
+    struct TraceEvent
+    {
+        // Nanoseconds on the steady clock.
+        std::uint64_t start;
+        std::uint64_t duration;
+        // The session that the event belongs to.
+        const void* id;
+        std::uint64_t bytes;
+        Event event;
+        // Events that are instants rather than spans.
+        bool instant;
+    };
+
+    extern std::atomic<bool> tracing_enabled;
+
+#if defined(NO_TRACING)
+    constexpr bool tracing() { return false; }
+#else
+    inline bool tracing() { return __builtin_expect(tracing_enabled.load(std::memory_order_relaxed), false); }
+#endif
+    void start_tracing();
+    void stop_tracing();
+
+    inline std::uint64_t trace_clock(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // Append an event to the ring of the calling thread.
+    void record(const TraceEvent& event);
+
+    inline void trace(Event event, const void* id, std::uint64_t bytes = 0){
+        if(tracing()){
+            record(TraceEvent{trace_clock(), 0, id, bytes, event, true});
+        }
+    }
+
+    // Traces the span from its construction to its destruction (or to end()).
+    // The clock is only read if tracing was on when the span began.
+    class Span
+    {
+        std::uint64_t _start;
+        const void* _id;
+        Event _event;
+
+        public:
+            Span(Event event, const void* id): _start(tracing() ? trace_clock() : 0), _id(id), _event(event) {}
+            Span(const Span&) = delete;
+            Span& operator=(const Span&) = delete;
+
+            void end(std::uint64_t bytes = 0){
+                if(_start){
+                    record(TraceEvent{_start, trace_clock() - _start, _id, bytes, _event, false});
+                    _start = 0;
+                }
+            }
+
+            ~Span() { end(); }
+    };
+
+    // Write the events of every thread, oldest first, as a Chrome trace (JSON object format).
+    // Events that are overwritten while they are being written out are left out.
+    void chrome_trace(std::ostream& os);
+    bool chrome_trace(const std::string& path);
+    // Write a Chrome trace to path every time that the process receives signo (e.g. SIGUSR1),
+    // the trace is written from the io_context, not from the signal handler.
+    void dump_on_signal(boost::asio::io_context& ioc, int signo, const std::string& path);
+}
+#endif
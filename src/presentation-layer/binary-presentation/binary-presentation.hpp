@@ -0,0 +1,153 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef BINARY_PRESENTATION_HPP
+#define BINARY_PRESENTATION_HPP
+#include "binary.hpp"
+#include "../presentation.hpp"
+namespace binary
+{
+    namespace b_presentation
+    {
+        /*
+        *  Exchanges Presentation<Types...> tuples in the binary encoding, for calls between our own processes.
+        *  Every message is a 32 bit length followed by the encoded tuple.
+        *  If every type has a fixed size the layout is known at compile time, and messages of any other length are rejected.
+        *
+        *  send() queues the tuple (or other values of the same types), write() sends everything queued.
+        *  read() decodes the next complete message into the tuple, and next() decodes any others that have already been read.
+        *  std::string_view and ArrayView<T> members are views into the receive buffer, they are valid until the next read().
+        *  Malformed or oversized messages fail the presentation, nothing more is decoded; error() returns the cause.
+        */
+        template<class... Types>
+        class BinaryPresentation: public presentation::Presentation<Types...>
+        {
+        public:
+            typedef presentation::Presentation<Types...> Presentation;
+            typedef presentation::Presentations<Types...> BinaryPresentations;
+            typedef Codec<std::tuple<Types...> > TupleCodec;
+
+            static constexpr std::size_t DEFAULT_MAX_MESSAGE = 16 << 20;
+
+        private:
+            std::size_t _max_message;
+            // Bytes that have been read from the session, the messages before _pos have already been decoded.
+            std::string _in;
+            std::size_t _pos = 0;
+            // Messages waiting to be written to the session.
+            std::string _out;
+            std::error_code _error;
+
+            void queue(const std::tuple<Types...>& values){
+                std::size_t len = TupleCodec::encoded_size(values);
+                _out.reserve(_out.size() + sizeof(Length) + len);
+                Codec<Length>::encode(_out, static_cast<Length>(len));
+                TupleCodec::encode(_out, values);
+            }
+
+            // Drain the session read buffer, the presentation lock must be held.
+            void receive(){
+                // Views into the messages that have been decoded are given up here.
+                _in.erase(0, _pos);
+                _pos = 0;
+                auto lk = this->session->lock();
+                char buf[4096];
+                std::streamsize len;
+                while((len = this->session->rbuf.rdbuf()->sgetn(buf, sizeof(buf))) > 0){
+                    _in.append(buf, len);
+                }
+            }
+
+            // Decode the message at _pos into the tuple, the presentation lock must be held.
+            bool decode(){
+                std::string_view in(_in);
+                in.remove_prefix(_pos);
+                Length len;
+                if(_error || !Codec<Length>::decode(in, len)){
+                    return false;
+                }
+                if(len > _max_message || (TupleCodec::fixed && len != TupleCodec::size)){
+                    _error = std::make_error_code(std::errc::message_size);
+                    return false;
+                }
+                if(in.size() < len){
+                    return false;
+                }
+                if(!binary::decode<std::tuple<Types...> >(in.substr(0, len), *this)){
+                    _error = std::make_error_code(std::errc::bad_message);
+                    return false;
+                }
+                _pos += sizeof(Length) + len;
+                return true;
+            }
+
+            bool flush(){
+                if(_out.empty()){
+                    return false;
+                }
+                {
+                    auto lk = this->session->lock();
+                    this->session->wbuf.rdbuf()->sputn(_out.data(), _out.size());
+                }
+                _out.clear();
+                return true;
+            }
+
+        public:
+            BinaryPresentation(BinaryPresentations& server, std::size_t max_message = DEFAULT_MAX_MESSAGE): Presentation(server), _max_message(max_message) {}
+            BinaryPresentation(BinaryPresentations& server, const std::shared_ptr<session::Session>& sp, std::size_t max_message = DEFAULT_MAX_MESSAGE): Presentation(server, sp), _max_message(max_message) {}
+
+            // Queue the current value of the tuple.
+            void send(){
+                auto lk = this->lock();
+                queue(*this);
+            }
+            void send(const std::tuple<Types...>& values){
+                auto lk = this->lock();
+                queue(values);
+            }
+
+            // Decode the next message that has already been read, returns false if there is none.
+            bool next(){
+                auto lk = this->lock();
+                return decode();
+            }
+
+            std::error_code error() { auto lk = this->lock(); return _error; }
+
+            using Presentation::operator=;
+
+            void read() override {
+                auto lk = this->lock();
+                receive();
+                decode();
+            }
+
+            void async_read(std::function<void(std::error_code ec)> cb) override {
+                this->session->async_read([&, cb](std::error_code ec){
+                    if(!ec){
+                        read();
+                    }
+                    cb(ec);
+                });
+            }
+
+            void write() override {
+                auto lk = this->lock();
+                flush();
+                this->session->write();
+            }
+
+            void async_write(std::function<void(std::error_code ec)> cb) override {
+                auto lk = this->lock();
+                flush();
+                this->session->async_write(cb);
+            }
+
+            ~BinaryPresentation() = default;
+        };
+    }
+}
+#endif
@@ -0,0 +1,254 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef BINARY_HPP
+#define BINARY_HPP
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace binary
+{
+    /*
+    *  A compact binary encoding of application native types, for processes on the same host (or the same architecture).
+    *  Values are laid out in the order that they are declared, with nothing between them:
+    *  - Trivially copyable types are copied as they are in memory, in host byte order.
+    *  - Strings and vectors are a 32 bit element count followed by their elements.
+    *  - Tuples are their elements, one after the other.
+    *
+    *  std::string_view and ArrayView<T> have the same encoding as std::string and std::vector<T>,
+    *  but decode to views into the input buffer instead of copies.
+    */
+    typedef std::uint32_t Length;
+
+    // A view of an array of trivially copyable values that are not necessarily aligned in the buffer that they point into.
+    template<class T>
+    class ArrayView
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ArrayView elements must be trivially copyable.");
+        const char* _data = nullptr;
+        std::size_t _size = 0;
+
+    public:
+        ArrayView() = default;
+        ArrayView(const char* data, std::size_t size): _data(data), _size(size) {}
+        ArrayView(const std::vector<T>& v): _data(reinterpret_cast<const char*>(v.data())), _size(v.size()) {}
+
+        std::size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+        const char* data() const { return _data; }
+        T operator[](std::size_t i) const {
+            T value;
+            std::memcpy(&value, _data + i*sizeof(T), sizeof(T));
+            return value;
+        }
+        std::vector<T> to_vector() const {
+            std::vector<T> v(_size);
+            if(_size){
+                std::memcpy(v.data(), _data, _size*sizeof(T));
+            }
+            return v;
+        }
+    };
+
+    template<class T>
+    struct is_view: std::false_type {};
+    template<>
+    struct is_view<std::string_view>: std::true_type {};
+    template<class T>
+    struct is_view<ArrayView<T> >: std::true_type {};
+
+    // Types that are encoded by copying their bytes, pointers are left out because they mean nothing to another process.
+    template<class T>
+    constexpr bool is_trivial_v = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !is_view<T>::value;
+
+    /*
+    *  Codec<T> encodes and decodes one type.
+    *  fixed is true if every value of the type has the same encoded size, which is then size.
+    *  encode appends to out, decode consumes from the front of in and returns false if in is too short.
+    *  Types without a Codec fail to compile.
+    */
+    template<class T, class Enable = void>
+    struct Codec;
+
+    template<class T>
+    struct Codec<T, std::enable_if_t<is_trivial_v<T> > >
+    {
+        static constexpr bool fixed = true;
+        static constexpr std::size_t size = sizeof(T);
+        static std::size_t encoded_size(const T&) { return sizeof(T); }
+        static void encode(std::string& out, const T& value){
+            out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        static bool decode(std::string_view& in, T& value){
+            if(in.size() < sizeof(T)){
+                return false;
+            }
+            std::memcpy(&value, in.data(), sizeof(T));
+            in.remove_prefix(sizeof(T));
+            return true;
+        }
+    };
+
+    // Read a length prefix, and check that the count elements of elem bytes each that it announces are all there.
+    inline bool decode_length(std::string_view& in, std::size_t elem, std::size_t& count){
+        Length len;
+        if(!Codec<Length>::decode(in, len) || (elem && in.size() / elem < len)){
+            return false;
+        }
+        count = len;
+        return true;
+    }
+
+    template<>
+    struct Codec<std::string>
+    {
+        static constexpr bool fixed = false;
+        static constexpr std::size_t size = 0;
+        static std::size_t encoded_size(const std::string& value) { return sizeof(Length) + value.size(); }
+        static void encode(std::string& out, const std::string& value){
+            Codec<Length>::encode(out, static_cast<Length>(value.size()));
+            out.append(value);
+        }
+        static bool decode(std::string_view& in, std::string& value){
+            std::size_t len;
+            if(!decode_length(in, 1, len)){
+                return false;
+            }
+            value.assign(in.data(), len);
+            in.remove_prefix(len);
+            return true;
+        }
+    };
+
+    template<>
+    struct Codec<std::string_view>
+    {
+        static constexpr bool fixed = false;
+        static constexpr std::size_t size = 0;
+        static std::size_t encoded_size(std::string_view value) { return sizeof(Length) + value.size(); }
+        static void encode(std::string& out, std::string_view value){
+            Codec<Length>::encode(out, static_cast<Length>(value.size()));
+            out.append(value);
+        }
+        static bool decode(std::string_view& in, std::string_view& value){
+            std::size_t len;
+            if(!decode_length(in, 1, len)){
+                return false;
+            }
+            value = in.substr(0, len);
+            in.remove_prefix(len);
+            return true;
+        }
+    };
+
+    template<class T>
+    struct Codec<std::vector<T> >
+    {
+        static constexpr bool fixed = false;
+        static constexpr std::size_t size = 0;
+        static std::size_t encoded_size(const std::vector<T>& value){
+            if constexpr (is_trivial_v<T>){
+                return sizeof(Length) + value.size()*sizeof(T);
+            } else {
+                std::size_t size = sizeof(Length);
+                for(const auto& v: value){
+                    size += Codec<T>::encoded_size(v);
+                }
+                return size;
+            }
+        }
+        static void encode(std::string& out, const std::vector<T>& value){
+            Codec<Length>::encode(out, static_cast<Length>(value.size()));
+            if constexpr (is_trivial_v<T>){
+                out.append(reinterpret_cast<const char*>(value.data()), value.size()*sizeof(T));
+            } else {
+                for(const auto& v: value){
+                    Codec<T>::encode(out, v);
+                }
+            }
+        }
+        static bool decode(std::string_view& in, std::vector<T>& value){
+            std::size_t len;
+            // Every element takes at least one byte, which bounds the count before anything is allocated.
+            if(!decode_length(in, is_trivial_v<T> ? sizeof(T) : 1, len)){
+                return false;
+            }
+            value.resize(len);
+            if constexpr (is_trivial_v<T>){
+                if(len){
+                    std::memcpy(value.data(), in.data(), len*sizeof(T));
+                }
+                in.remove_prefix(len*sizeof(T));
+            } else {
+                for(auto& v: value){
+                    if(!Codec<T>::decode(in, v)){
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+
+    template<class T>
+    struct Codec<ArrayView<T> >
+    {
+        static constexpr bool fixed = false;
+        static constexpr std::size_t size = 0;
+        static std::size_t encoded_size(const ArrayView<T>& value) { return sizeof(Length) + value.size()*sizeof(T); }
+        static void encode(std::string& out, const ArrayView<T>& value){
+            Codec<Length>::encode(out, static_cast<Length>(value.size()));
+            out.append(value.data(), value.size()*sizeof(T));
+        }
+        static bool decode(std::string_view& in, ArrayView<T>& value){
+            std::size_t len;
+            if(!decode_length(in, sizeof(T), len)){
+                return false;
+            }
+            value = ArrayView<T>(in.data(), len);
+            in.remove_prefix(len*sizeof(T));
+            return true;
+        }
+    };
+
+    // The condition keeps this apart from the trivially copyable case, for standard libraries whose tuples are trivially copyable.
+    template<class... Types>
+    struct Codec<std::tuple<Types...>, std::enable_if_t<!is_trivial_v<std::tuple<Types...> > > >
+    {
+        static constexpr bool fixed = (Codec<Types>::fixed && ...);
+        static constexpr std::size_t size = fixed ? (Codec<Types>::size + ... + 0) : 0;
+        static std::size_t encoded_size(const std::tuple<Types...>& value){
+            if constexpr (fixed){
+                return size;
+            } else {
+                return std::apply([](const Types&... v){ return (Codec<Types>::encoded_size(v) + ... + 0); }, value);
+            }
+        }
+        static void encode(std::string& out, const std::tuple<Types...>& value){
+            std::apply([&](const Types&... v){ (Codec<Types>::encode(out, v), ...); }, value);
+        }
+        static bool decode(std::string_view& in, std::tuple<Types...>& value){
+            return std::apply([&](Types&... v){ return (Codec<Types>::decode(in, v) && ...); }, value);
+        }
+    };
+
+    template<class T>
+    void encode(std::string& out, const T& value){
+        out.reserve(out.size() + Codec<T>::encoded_size(value));
+        Codec<T>::encode(out, value);
+    }
+
+    // Returns false unless the whole of in is exactly one value.
+    template<class T>
+    bool decode(std::string_view in, T& value){
+        return Codec<T>::decode(in, value) && in.empty();
+    }
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "http-metadata.hpp"
+#include <atomic>
+#include <ctime>
+#include <cstdio>
+
+namespace http
+{
+    static std::string server_name;
+    // Bumped whenever the server name changes so that thread caches know to rebuild.
+    static std::atomic<unsigned> server_generation{0};
+
+    struct MetadataCache
+    {
+        std::time_t second = -1;
+        unsigned generation = 0;
+        // The length of the Date line at the start of headers.
+        std::size_t date_length = 0;
+        std::string headers;
+    };
+
+    static MetadataCache& cache(){
+        thread_local MetadataCache metadata;
+        // The coarse clock is read from the vDSO without a system call, and only has to resolve seconds.
+        struct timespec now;
+        ::clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        unsigned generation = server_generation.load(std::memory_order_acquire);
+        if(now.tv_sec != metadata.second || generation != metadata.generation){
+            struct tm tm;
+            ::gmtime_r(&now.tv_sec, &tm);
+            // IMF-fixdate always uses the English day and month names, so strftime (which is locale dependent) is not used.
+            static const char days[][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+            static const char months[][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+            char buf[64];
+            int len = std::snprintf(buf, sizeof(buf), "Date: %s, %02d %s %04d %02d:%02d:%02d GMT\r\n",
+                days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+            metadata.headers.assign(buf, len);
+            metadata.date_length = len;
+            if(!server_name.empty()){
+                metadata.headers.append("Server: ").append(server_name).append("\r\n");
+            }
+            metadata.second = now.tv_sec;
+            metadata.generation = generation;
+        }
+        return metadata;
+    }
+
+    std::string_view HttpResponseMetadata::headers(){
+        return cache().headers;
+    }
+
+    std::string_view HttpResponseMetadata::date(){
+        auto& metadata = cache();
+        return std::string_view(metadata.headers.data(), metadata.date_length);
+    }
+
+    void HttpResponseMetadata::server(std::string_view name){
+        server_name.assign(name);
+        server_generation.fetch_add(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,29 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef HTTP_METADATA_HPP
+#define HTTP_METADATA_HPP
+#include <string>
+#include <string_view>
+
+namespace http{
+    // Response metadata that changes at most once a second.
+    // Each thread keeps its own serialized copy of the Date and Server headers, which is
+    // only reformatted when the wall clock second changes, so responses only pay for a copy.
+    class HttpResponseMetadata
+    {
+    public:
+        // Serialized "Date: <IMF-fixdate>\r\n" and "Server: <name>\r\n" header lines.
+        // The Server line is omitted if no server name has been set.
+        static std::string_view headers();
+        // Serialized "Date: <IMF-fixdate>\r\n" header line.
+        static std::string_view date();
+
+        // Set the value of the Server header.
+        // This should be called once, before any thread starts writing responses.
+        static void server(std::string_view name);
+    };
+}
+#endif
@@ -3,60 +3,78 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at https://mozilla.org/MPL/2.0/.
  */
+#include <algorithm>
+#include <cctype>
 #include "http-presentation.hpp"
 namespace http
 {
     namespace h_presentation
     {
-        void HttpPresentation::read(){
-            auto lk1 = lock();
-            {
-                auto lk2 = session->lock();
-                session->rbuf >> std::get<http::HttpRequest>(*this);
-            }  
+        // A response is complete once the status line, all of the headers, and all of the chunks have been parsed.
+        static bool complete(const http::HttpResponse& res){
+            return res.status_line_finished && res.num_headers > 0 && res.next_header == res.num_headers && res.next_chunk == res.num_chunks;
         }
 
-        void HttpPresentation::async_read(std::function<void(std::error_code ec)> cb){
-            session->async_read([&, cb](std::error_code ec){
-                if(!ec){
-                    read();
-                }
-                cb(ec);
+        // HTTP/1.1 connections are persistent unless the server says otherwise,
+        // HTTP/1.0 connections are only persistent if the server asks for keep-alive.
+        static bool keep_alive(const http::HttpResponse& res){
+            auto it = std::find_if(res.headers.cbegin(), res.headers.cend(), [](auto& header){
+                return header.field_name == HttpHeaderField::CONNECTION;
             });
-        }
-
-        void HttpPresentation::write(){
-            auto lk1 = lock();
-            auto& res = std::get<http::HttpResponse>(*this);
+            std::string value;
+            if(it != res.headers.cend()){
+                value = it->field_value;
+                std::transform(value.cbegin(), value.cend(), value.begin(), [](unsigned char c){ return std::tolower(c); });
+            }
+            switch(res.version)
             {
-                auto lk2 = session->lock();
-                session->wbuf << res;
+                case HttpVersion::V1_1:
+                    return value.find("close") == std::string::npos;
+                case HttpVersion::V1:
+                    return value.find("keep-alive") != std::string::npos;
+                default:
+                    return false;
             }
-            res.status_line_finished = true;
-            res.next_header = res.headers.size();
-            res.next_chunk = res.chunks.size();
-            session->write();
         }
-        
-        void HttpPresentation::async_write(std::function<void(std::error_code ec)> cb){
-            auto lk1 = lock();
-            auto& res = std::get<http::HttpResponse>(*this);
-            {
-                auto lk2 = session->lock();
-                session->wbuf << res;
+
+        bool complete(const http::HttpRequest& req){
+            return req.http_request_line_complete && req.num_headers > 0 && req.next_header == req.num_headers && req.next_chunk == req.num_chunks;
+        }
+
+        bool websocket(const http::HttpRequest& req){
+            auto it = std::find_if(req.headers.cbegin(), req.headers.cend(), [](auto& header){
+                return header.field_name == HttpHeaderField::UPGRADE;
+            });
+            if(it == req.headers.cend()){
+                return false;
             }
+            std::string value = it->field_value;
+            std::transform(value.cbegin(), value.cend(), value.begin(), [](unsigned char c){ return std::tolower(c); });
+            return value.find("websocket") != std::string::npos;
+        }
+
+        void write_metadata(std::streambuf& out, http::HttpResponse& res){
+            std::string_view version = version_prefix(res.version);
+            std::string_view status = status_line(res.status);
+            std::string_view headers = http::HttpResponseMetadata::headers();
+            out.sputn(version.data(), version.size());
+            out.sputn(status.data(), status.size());
+            out.sputn(headers.data(), headers.size());
             res.status_line_finished = true;
-            res.next_header = res.headers.size();
-            res.next_chunk = res.chunks.size();
-            session->async_write(cb);
         }
 
         //Http client sessions reverse the http server session logic.
         void HttpClientPresentation::read(){
             auto lk1 = lock();
+            auto& res = std::get<http::HttpResponse>(*this);
             {
                 auto lk2 = session->lock();
-                session->rbuf >> std::get<http::HttpResponse>(*this);
+                session->rbuf >> res;
+            }
+            if(release && complete(res)){
+                auto sp = std::move(session);
+                session.reset();
+                release(sp, keep_alive(res));
             }
         }
 
@@ -94,5 +112,125 @@ namespace http
             req.next_chunk = req.chunks.size();
             session->async_write(cb);
         }
+    
+        // Only idempotent requests, on a connection that is going to stay open, are safe to pipeline.
+        static bool pipelined(const http::HttpRequest& req){
+            switch(req.verb)
+            {
+                case HttpVerb::GET:
+                case HttpVerb::PUT:
+                case HttpVerb::DELETE:
+                case HttpVerb::TRACE:
+                    break;
+                default:
+                    return false;
+            }
+            auto it = std::find_if(req.headers.cbegin(), req.headers.cend(), [](auto& header){
+                return header.field_name == HttpHeaderField::CONNECTION;
+            });
+            if(it != req.headers.cend()){
+                std::string value = it->field_value;
+                std::transform(value.cbegin(), value.cend(), value.begin(), [](unsigned char c){ return std::tolower(c); });
+                return value.find("close") == std::string::npos;
+            }
+            return true;
+        }
+
+        bool HttpPipelinedClientPresentation::fill(){
+            bool filled = false;
+            while(!_queued.empty() && _in_flight.size() < _depth){
+                auto& next = _queued.front();
+                if(!_in_flight.empty() && (!next.pipelined || !_in_flight.back().pipelined)){
+                    break;
+                }
+                {
+                    auto lk = session->lock();
+                    session->wbuf << next.req;
+                }
+                _in_flight.push_back(std::move(next));
+                _queued.pop_front();
+                filled = true;
+            }
+            return filled;
+        }
+
+        void HttpPipelinedClientPresentation::request(http::HttpRequest req, HttpPipelinedClientPresentation::handler fn){
+            auto lk = lock();
+            bool p = pipelined(req);
+            _queued.push_back(Pending{std::move(req), std::move(fn), p});
+        }
+
+        void HttpPipelinedClientPresentation::cancel(const std::error_code& ec){
+            std::deque<Pending> cancelled;
+            {
+                auto lk = lock();
+                cancelled.swap(_in_flight);
+                cancelled.insert(cancelled.end(), std::make_move_iterator(_queued.begin()), std::make_move_iterator(_queued.end()));
+                _queued.clear();
+                std::get<http::HttpResponse>(*this) = http::HttpResponse();
+            }
+            for(auto& pending: cancelled){
+                http::HttpResponse res{};
+                pending.fn(ec, res);
+            }
+        }
+
+        void HttpPipelinedClientPresentation::read(){
+            std::vector<std::pair<handler, http::HttpResponse> > done;
+            bool filled = false;
+            {
+                auto lk1 = lock();
+                auto& res = std::get<http::HttpResponse>(*this);
+                // Several responses may have arrived in a single read.
+                while(!_in_flight.empty()){
+                    {
+                        auto lk2 = session->lock();
+                        session->rbuf >> res;
+                    }
+                    if(!complete(res)){
+                        break;
+                    }
+                    done.emplace_back(std::move(_in_flight.front().fn), std::move(res));
+                    _in_flight.pop_front();
+                    res = http::HttpResponse();
+                }
+            }
+            // Handlers are called without the lock so that they can queue more requests.
+            for(auto& [fn, res]: done){
+                fn(std::error_code(), res);
+            }
+            {
+                auto lk = lock();
+                filled = fill();
+            }
+            if(filled){
+                session->write();
+            }
+        }
+
+        void HttpPipelinedClientPresentation::async_read(std::function<void(std::error_code ec)> cb){
+            session->async_read([&, cb](std::error_code ec){
+                if(!ec){
+                    read();
+                }
+                cb(ec);
+            });
+        }
+
+        void HttpPipelinedClientPresentation::write(){
+            {
+                auto lk = lock();
+                fill();
+            }
+            session->write();
+        }
+
+        void HttpPipelinedClientPresentation::async_write(std::function<void(std::error_code ec)> cb){
+            {
+                auto lk = lock();
+                fill();
+            }
+            session->async_write(cb);
+        }
     }
 }
\ No newline at end of file
@@ -5,8 +5,15 @@
  */
 #ifndef HTTP_PRESENTATION_HPP
 #define HTTP_PRESENTATION_HPP
+#include <deque>
+#include <type_traits>
 #include "http-requests.hpp"
+#include "http-templates.hpp"
+#include "http-metadata.hpp"
 #include "../presentation.hpp"
+#include "../../metrics/trace.hpp"
+#include "../../metrics/probes.hpp"
+#include "../../metrics/route-latency.hpp"
 namespace http
 {
     namespace h_presentation
@@ -15,20 +22,297 @@ namespace http
         typedef presentation::Presentation<http::HttpRequest, http::HttpResponse> Presentation;
         typedef presentation::Presentations<http::HttpRequest, http::HttpResponse> HttpPresentations;
 
-        //Http Sessions Contain a single request, and a single response.
-        class HttpPresentation: public Presentation
+        // A request is complete once the request line, all of the headers, and all of the chunks have been parsed.
+        bool complete(const http::HttpRequest& req);
+        // The request asks to Upgrade: websocket.
+        bool websocket(const http::HttpRequest& req);
+        // Write the status line followed by the cached metadata headers,
+        // the rest of the response is then serialized as usual.
+        void write_metadata(std::streambuf& out, http::HttpResponse& res);
+
+        /*
+        *  Http Sessions Contain a single request, and a single response.
+        *
+        *  S is the type of the session. Every call to the session goes through S, so if S is a concrete session
+        *  (e.g. BasicHttpPresentation<unix_session::uSession>) nothing is dispatched virtually,
+        *  and the read, parse, and write path can be inlined; the session must then always be an S.
+        *  HttpPresentation works with any session through the virtual Session interface.
+        *  The presentation is final, so calls through a pointer to it are not dispatched virtually either.
+        *  The async writes honour the flow control of the session: while its write buffer is past the high watermark
+        *  the response is not serialized, and the write is resumed once the buffer has drained. The synchronous writes always
+        *  append to the write buffer.
+        */
+        template<class S>
+        class BasicHttpPresentation final: public Presentation
         {
+            static_assert(std::is_base_of_v<session::Session, S>, "BasicHttpPresentation needs a session type.");
+
+            S& transport() { return static_cast<S&>(*session); }
+
+            void session_write(){
+                if constexpr (std::is_abstract_v<S>){
+                    session->write();
+                } else {
+                    transport().S::write();
+                }
+            }
+
+            void session_async_read(std::function<void(std::error_code ec)> cb){
+                if constexpr (std::is_abstract_v<S>){
+                    session->async_read(std::move(cb));
+                } else {
+                    transport().S::async_read(std::move(cb));
+                }
+            }
+
+            void session_async_write(std::function<void(std::error_code ec)> cb){
+                if constexpr (std::is_abstract_v<S>){
+                    session->async_write(std::move(cb));
+                } else {
+                    transport().S::async_write(std::move(cb));
+                }
+            }
+
+            // When tracing, the time at which the current request was complete.
+            std::uint64_t _completed = 0;
+
+            std::size_t _memory_peak = 0;
+
+            // The heap bytes held by the request and the response, the presentation lock must be held.
+            std::size_t measure(){
+                std::size_t bytes = http::memory(std::get<http::HttpRequest>(*this)) + http::memory(std::get<http::HttpResponse>(*this));
+                _memory_peak = std::max(_memory_peak, bytes);
+                return bytes;
+            }
+
+            // When timing, the time at which the first byte of the current request was parsed.
+            std::uint64_t _started = 0;
+
+            // The response has been written, the presentation lock must be held.
+            void finished(){
+                if(_started){
+                    latency->record(route, metrics::trace_clock() - _started);
+                    _started = 0;
+                    route = http::HttpRouteTree::NONE;
+                }
+            }
+
+            // The application has answered the request, the presentation lock must be held.
+            void responded(){
+                if(_completed){
+                    metrics::record(metrics::TraceEvent{_completed, metrics::trace_clock() - _completed, session.get(), 0, metrics::Event::APPLICATION, false});
+                    _completed = 0;
+                }
+            }
+
+            void timed_async_write(std::function<void(std::error_code ec)> cb){
+                if(!_started){
+                    session_async_write(std::move(cb));
+                    return;
+                }
+                session_async_write([&, cb](std::error_code ec){
+                    {
+                        auto lk = lock();
+                        finished();
+                    }
+                    cb(ec);
+                });
+            }
+
+            // Start the read deadline of the phase that the request is in. Once the request is complete it is up to
+            // the application, until it has answered. The BODY deadline is restarted whenever progressed is set.
+            void deadline(bool answered, bool progressed = false){
+                auto& req = std::get<http::HttpRequest>(*this);
+                session::Deadline d = session::Deadline::IDLE;
+                if(complete(req)){
+                    d = answered ? session::Deadline::IDLE : session::Deadline::NONE;
+                } else if(req.http_request_line_complete && req.num_headers > 0 && req.next_header == req.num_headers){
+                    d = session::Deadline::BODY;
+                } else if(req.verb_started){
+                    d = session::Deadline::HEADER;
+                }
+                session->read_deadline(d, progressed);
+            }
+
+            // If the session write buffer is past its high watermark, resume is called once it has drained instead.
+            bool suspended(std::function<void()> resume){
+                auto lk = session->lock();
+                if(!session->write_blocked()){
+                    return false;
+                }
+                session->when_writable(std::move(resume));
+                return true;
+            }
+
+            // Serialize the response into the session write buffer, the presentation lock must be held.
+            void serialize(){
+                auto& res = std::get<http::HttpResponse>(*this);
+                {
+                    auto lk = session->lock();
+                    if(metadata && !res.status_line_finished){
+                        write_metadata(*session->wbuf.rdbuf(), res);
+                    }
+                    session->wbuf << res;
+                }
+                res.status_line_finished = true;
+                res.next_header = res.headers.size();
+                res.next_chunk = res.chunks.size();
+            }
+
         public:
-            HttpPresentation(HttpPresentations& server): Presentation(server) {}
-            HttpPresentation(HttpPresentations& server, const std::shared_ptr<session::Session>& sp): Presentation(server, sp) {}
+            BasicHttpPresentation(HttpPresentations& server): Presentation(server) {}
+            BasicHttpPresentation(HttpPresentations& server, const std::shared_ptr<S>& sp): Presentation(server, sp) {}
 
-            void read() override;
-            void async_read(std::function<void(std::error_code ec)> cb) override;
-            void write() override;
-            void async_write(std::function<void(std::error_code ec)> cb) override;
+            void read() override {
+                auto lk1 = lock();
+                auto& req = std::get<http::HttpRequest>(*this);
+                bool parsed = complete(req);
+                bool line = req.http_request_line_complete;
+                bool headers = line && req.num_headers > 0 && req.next_header == req.num_headers;
+                bool progressed = false;
+                {
+                    auto lk2 = session->lock();
+                    metrics::Span span(metrics::Event::PARSE, session.get());
+                    std::size_t buffered = session->rbuf.data().size();
+                    try {
+                        session->rbuf >> req;
+                        progressed = session->rbuf.data().size() < buffered;
+                    } catch(const char*) {
+                        // A number (e.g. a chunk size) could not be parsed, so the rest of the stream can not be framed.
+                        // Drop the request and everything that has been buffered behind it.
+                        metrics::add(metrics::Counter::PARSE_ERRORS);
+                        session->rbuf.str(std::string());
+                        session->rbuf.clear();
+                        req = http::HttpRequest{};
+                    }
+                }
+                if(latency && !_started && req.verb_started){
+                    _started = metrics::trace_clock();
+                }
+                if constexpr (metrics::PROBES){
+                    if(!line && req.http_request_line_complete){
+                        OSI_PROBE(request__line, session.get(), static_cast<int>(req.verb), req.route.c_str());
+                    }
+                    if(!headers && req.http_request_line_complete && req.num_headers > 0 && req.next_header == req.num_headers){
+                        OSI_PROBE(headers, session.get(), req.num_headers);
+                    }
+                    if(!parsed && complete(req)){
+                        std::size_t bytes = 0;
+                        for(auto& chunk: req.chunks){
+                            bytes += chunk.chunk_data.size();
+                        }
+                        OSI_PROBE(body, session.get(), req.num_chunks, bytes);
+                    }
+                }
+                if(!parsed && complete(req)){
+                    metrics::add(metrics::Counter::REQUESTS_PARSED);
+                    measure();
+                    if(metrics::tracing()){
+                        _completed = metrics::trace_clock();
+                    }
+                    if(req.verb == http::HttpVerb::UNKNOWN || req.version == http::HttpVersion::UNKNOWN){
+                        metrics::add(metrics::Counter::PARSE_ERRORS);
+                    }
+                }
+                deadline(false, progressed);
+                if(upgrade && complete(req) && websocket(req)){
+                    auto sp = std::move(session);
+                    session.reset();
+                    // From here on the session is only idle or not.
+                    sp->read_deadline(session::Deadline::IDLE);
+                    upgrade(sp, req);
+                }
+            }
+
+            void async_read(std::function<void(std::error_code ec)> cb) override {
+                session_async_read([&, cb](std::error_code ec){
+                    if(!ec){
+                        read();
+                    }
+                    cb(ec);
+                });
+            }
+
+            void write() override {
+                auto lk = lock();
+                responded();
+                serialize();
+                session_write();
+                finished();
+                deadline(true);
+            }
+
+            void async_write(std::function<void(std::error_code ec)> cb) override {
+                auto lk = lock();
+                if(suspended([&, cb](){ async_write(cb); })){
+                    return;
+                }
+                responded();
+                serialize();
+                deadline(true);
+                timed_async_write(std::move(cb));
+            }
 
-            ~HttpPresentation() = default;
+            // Write a response from a precompiled template, the HttpResponse slot is left untouched.
+            void write(const http::HttpResponseTemplate& tmpl, std::string_view body){
+                auto lk = lock();
+                responded();
+                {
+                    auto slk = session->lock();
+                    tmpl.write(*session->wbuf.rdbuf(), body, metadata ? http::HttpResponseMetadata::headers() : std::string_view());
+                }
+                session_write();
+                finished();
+                session->read_deadline(session::Deadline::IDLE);
+            }
+
+            void async_write(const http::HttpResponseTemplate& tmpl, std::string_view body, std::function<void(std::error_code ec)> cb){
+                auto lk = lock();
+                {
+                    auto slk = session->lock();
+                    if(session->write_blocked()){
+                        // The body is only borrowed, keep a copy of it until the write is resumed.
+                        session->when_writable([&, body = std::string(body), cb](){ async_write(tmpl, body, cb); });
+                        return;
+                    }
+                }
+                responded();
+                {
+                    auto slk = session->lock();
+                    tmpl.write(*session->wbuf.rdbuf(), body, metadata ? http::HttpResponseMetadata::headers() : std::string_view());
+                }
+                session->read_deadline(session::Deadline::IDLE);
+                timed_async_write(std::move(cb));
+            }
+
+            std::size_t memory() override {
+                auto lk = lock();
+                return measure();
+            }
+            // The most that the request and the response have held, as of the last complete request or call to memory().
+            std::size_t memory_peak() {
+                auto lk = lock();
+                measure();
+                return _memory_peak;
+            }
+
+            // If set, the cached Date and Server headers (see HttpResponseMetadata) are added to every response.
+            bool metadata = false;
+
+            // If set, every request is timed from the first of its bytes being parsed to the last of its response being written,
+            // and recorded in latency under route. The application sets route to the number of the route that the request
+            // matched (see HttpRouter::find) before it answers; it is reset to NONE (unmatched) after every response.
+            metrics::RouteLatency* latency = nullptr;
+            std::uint32_t route = http::HttpRouteTree::NONE;
+
+            // If set, a complete request that asks to Upgrade: websocket is not left for the application to answer,
+            // instead the session is detached from the presentation and passed to upgrade along with the request
+            // (e.g. to hand it over to a WsPresentation, which answers the handshake).
+            std::function<void(const std::shared_ptr<session::Session>& session, const http::HttpRequest& req)> upgrade;
+
+            ~BasicHttpPresentation() = default;
         };
+        typedef BasicHttpPresentation<session::Session> HttpPresentation;
 
         //Http client sessions reverse the http server session logic.
         class HttpClientPresentation: public Presentation
@@ -42,8 +326,61 @@ namespace http
             void write() override;
             void async_write(std::function<void(std::error_code ec)> cb) override;
 
+            // If set, the session is detached from the presentation and passed to release
+            // as soon as a response has been read completely (e.g. to return it to a connection pool).
+            // reusable is false if the server has asked for the connection to be closed.
+            std::function<void(const std::shared_ptr<session::Session>& session, bool reusable)> release;
+
             ~HttpClientPresentation() = default;
         };
+
+        // Pipelined Http clients queue many requests on a single session.
+        // Up to depth requests are written back to back in a single buffer,
+        // and responses are matched to their requests in FIFO order.
+        // Requests that are not safe to pipeline (non-idempotent verbs, or Connection: close)
+        // fall back to one request at a time: they are only written once every earlier response
+        // has been read, and nothing else is written until their own response has been read.
+        // The HttpResponse slot of the tuple holds the response that is currently being parsed.
+        class HttpPipelinedClientPresentation: public Presentation
+        {
+        public:
+            typedef std::function<void(const std::error_code& ec, http::HttpResponse& res)> handler;
+
+        private:
+            struct Pending
+            {
+                http::HttpRequest req;
+                handler fn;
+                bool pipelined;
+            };
+            std::deque<Pending> _queued;
+            std::deque<Pending> _in_flight;
+            std::size_t _depth;
+
+            // Serialize as many queued requests into the session write buffer as the pipeline allows.
+            // The presentation lock must be held.
+            bool fill();
+
+        public:
+            static constexpr std::size_t DEFAULT_DEPTH = 8;
+
+            HttpPipelinedClientPresentation(HttpPresentations& server, std::size_t depth = DEFAULT_DEPTH): Presentation(server), _depth(depth) {}
+            HttpPipelinedClientPresentation(HttpPresentations& server, const std::shared_ptr<session::Session>& sp, std::size_t depth = DEFAULT_DEPTH): Presentation(server, sp), _depth(depth) {}
+
+            // Queue a request, fn is called with its response.
+            // Queued requests are written by the next call to write(), or as soon as earlier responses have been read.
+            void request(http::HttpRequest req, handler fn);
+            // Fail every queued and in flight request, e.g. after the session has been closed.
+            void cancel(const std::error_code& ec);
+            std::size_t pending() { auto lk = lock(); return _queued.size() + _in_flight.size(); }
+
+            void read() override;
+            void async_read(std::function<void(std::error_code ec)> cb) override;
+            void write() override;
+            void async_write(std::function<void(std::error_code ec)> cb) override;
+
+            ~HttpPipelinedClientPresentation() = default;
+        };
     }
 }
 #endif
\ No newline at end of file
@@ -27,6 +27,10 @@ namespace http
         std::ptrdiff_t len = (hex_str.end() - (offset)*max_str_width) - hex_str.begin();
         hex_str_partitions[offset].reserve(len);
         hex_str_partitions[offset].insert(hex_str_partitions[offset].end(), hex_str.begin(), hex_str.end()-(offset)*max_str_width);
+        // If the string is a whole number of partitions wide, the last partition is empty.
+        if(hex_str_partitions.size() > 1 && hex_str_partitions.back().empty()){
+            hex_str_partitions.pop_back();
+        }
 
         for(auto it=hex_str_partitions.rbegin(); it != hex_str_partitions.rend(); ++it){
             std::size_t num;
@@ -473,6 +477,23 @@ namespace http
         return is;
     }
 
+    // Bodies with a Content-Length are copied in bulk, and never past the end of the body,
+    // so that the next message on a persistent connection is left in the stream.
+    static void read_content(std::istream& is, HttpChunk& chunk){
+        HttpBigNum remaining = chunk.chunk_size - chunk.received_bytes;
+        std::streamsize len = is.rdbuf()->in_avail();
+        if(remaining.size() == 1 && remaining[0] < static_cast<std::size_t>(len)){
+            len = remaining[0];
+        }
+        if(len > 0){
+            std::size_t offset = chunk.chunk_data.size();
+            chunk.chunk_data.resize(offset + len);
+            len = is.rdbuf()->sgetn(&chunk.chunk_data[offset], len);
+            chunk.chunk_data.resize(offset + len);
+            chunk.received_bytes += static_cast<std::size_t>(len);
+        }
+    }
+
     std::ostream& operator<<(std::ostream& os, const HttpChunk& chunk){
         os << chunk.chunk_size << "\r\n"
            << chunk.chunk_data << "\r\n";
@@ -546,6 +567,16 @@ namespace http
                             header.field_name = HttpHeaderField::TRANSFER_ENCODING;
                         } else if (header.buf == "CONNECTION") {
                             header.field_name = HttpHeaderField::CONNECTION;
+                        } else if (header.buf == "UPGRADE") {
+                            header.field_name = HttpHeaderField::UPGRADE;
+                        } else if (header.buf == "SEC-WEBSOCKET-KEY") {
+                            header.field_name = HttpHeaderField::SEC_WEBSOCKET_KEY;
+                        } else if (header.buf == "SEC-WEBSOCKET-ACCEPT") {
+                            header.field_name = HttpHeaderField::SEC_WEBSOCKET_ACCEPT;
+                        } else if (header.buf == "SEC-WEBSOCKET-VERSION") {
+                            header.field_name = HttpHeaderField::SEC_WEBSOCKET_VERSION;
+                        } else if (header.buf == "SEC-WEBSOCKET-EXTENSIONS") {
+                            header.field_name = HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS;
                         } else {
                             header.field_name = HttpHeaderField::UNKNOWN;
                         }
@@ -588,6 +619,20 @@ namespace http
         return is;
     }
 
+    HttpChunk make_chunk(std::string data){
+        HttpChunk chunk{};
+        chunk.chunk_size = {data.size()};
+        chunk.chunk_data = std::move(data);
+        return chunk;
+    }
+
+    HttpHeader make_header(HttpHeaderField field, std::string value){
+        HttpHeader header{};
+        header.field_name = field;
+        header.field_value = std::move(value);
+        return header;
+    }
+
     std::ostream& operator<<(std::ostream& os, const HttpHeader& header){
         switch(header.field_name)
         {
@@ -609,6 +654,21 @@ namespace http
             case HttpHeaderField::CONNECTION:
                 os << "Connection: ";
                 break;
+            case HttpHeaderField::UPGRADE:
+                os << "Upgrade: ";
+                break;
+            case HttpHeaderField::SEC_WEBSOCKET_KEY:
+                os << "Sec-WebSocket-Key: ";
+                break;
+            case HttpHeaderField::SEC_WEBSOCKET_ACCEPT:
+                os << "Sec-WebSocket-Accept: ";
+                break;
+            case HttpHeaderField::SEC_WEBSOCKET_VERSION:
+                os << "Sec-WebSocket-Version: ";
+                break;
+            case HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS:
+                os << "Sec-WebSocket-Extensions: ";
+                break;
             default:
                 return os;
         }
@@ -718,6 +778,10 @@ namespace http
                     }
                 } else if (!req.route_finished){
                     if(!std::isspace(c)){
+                        if(c == '?' && !req.query_found){
+                            req.query_found = true;
+                            req.query_pos = req.route.size();
+                        }
                         req.route.push_back(c);
                     } else {
                         req.route_finished = true;
@@ -804,6 +868,15 @@ namespace http
                     if(next_header.not_last){
                         ++(req.num_headers);
                         req.headers.emplace_back();
+                    } else if(!req.not_chunked_transfer){
+                        // A request without a Content-Length or a Transfer-Encoding has no body, whatever its verb (RFC 9112 6.3),
+                        // otherwise the next pipelined request would be parsed as a chunk.
+                        auto it = std::find_if(req.headers.begin(), req.headers.end(), [](auto& header){
+                            return header.field_name == HttpHeaderField::TRANSFER_ENCODING;
+                        });
+                        if(it == req.headers.end()){
+                            req.next_chunk = req.num_chunks;
+                        }
                     }
                     ++(req.next_header);
                 }
@@ -822,7 +895,7 @@ namespace http
                         next_chunk.chunk_size_found = true;
                         next_chunk.chunk_body_start = true;
                     }
-                    is >> next_chunk;
+                    read_content(is, next_chunk);
                     if(next_chunk.chunk_size == next_chunk.received_bytes){
                         // Finish parsing.
                         req.next_chunk = req.num_chunks;
@@ -894,21 +967,30 @@ namespace http
                     break;
             }
         }
+        // A request body is only framed by its Content-Length or its Transfer-Encoding (RFC 9112 6.3).
+        // A request with chunks but neither header is sent chunked, and says so, so that the peer reads its body.
+        auto cl = std::find_if(req.headers.begin(), req.headers.end(), [](auto& header){
+            return header.field_name == HttpHeaderField::CONTENT_LENGTH;
+        });
+        auto te = std::find_if(req.headers.begin(), req.headers.end(), [](auto& header){
+            return header.field_name == HttpHeaderField::TRANSFER_ENCODING;
+        });
+        std::size_t num_chunks = req.chunks.size();
+        bool chunked = cl == req.headers.end() && te == req.headers.end() && num_chunks > 0;
         std::size_t num_headers = req.headers.size();
         for(std::size_t i = req.next_header; i < num_headers; ++i){
             const http::HttpHeader& header = req.headers[i];
             if(header.field_name == HttpHeaderField::END_OF_HEADERS){
+                if(chunked){
+                    os << "Transfer-Encoding: chunked\r\n";
+                }
                 os << "\r\n";
             } else {
                 os << header;
             }
         }
-        std::size_t num_chunks = req.chunks.size();
-        if(req.verb != HttpVerb::GET && req.verb != HttpVerb::DELETE && req.verb != HttpVerb::TRACE && req.next_chunk < num_chunks){
-            auto it = std::find_if(req.headers.begin(), req.headers.end(), [](auto& header){
-                return header.field_name == HttpHeaderField::CONTENT_LENGTH;
-            });
-            if(it != req.headers.end()){
+        if(req.next_chunk < num_chunks){
+            if(cl != req.headers.end()){
                 os << req.chunks[0].chunk_data;
             } else {
                 for(std::size_t i = req.next_chunk; i < num_chunks; ++i ){
@@ -922,54 +1004,10 @@ namespace http
 
     std::ostream& operator<<(std::ostream& os, const HttpResponse& res){
         if(!res.status_line_finished){
-            switch(res.version)
-            {
-                case HttpVersion::V1:
-                    os << "HTTP/1.0 ";
-                    break;
-                case HttpVersion::V1_1:
-                    os << "HTTP/1.1 ";
-                    break;
-                case HttpVersion::V2:
-                    os << "HTTP/2 ";
-                    break;
-                case HttpVersion::V3:
-                    os << "HTTP/3 ";
-                    break;
-                case HttpVersion::V0_9:
-                    os << "HTTP/0.9 ";
-                    break;
-                default:
-                    os << "HTTP/1.0";
-                    break;
-            }
-            switch(res.status)
-            {
-                case HttpStatus::OK:
-                    os << "200 OK\r\n";
-                    break;
-                case HttpStatus::NOT_FOUND:
-                    os << "404 Not Found\r\n";
-                    break;
-                case HttpStatus::CONFLICT:
-                    os << "409 Conflict\r\n";
-                    break;
-                case HttpStatus::METHOD_NOT_ALLOWED:
-                    os << "405 Method Not Allowed\r\n";
-                    break;
-                case HttpStatus::INTERNAL_SERVER_ERROR:
-                    os << "500 Internal Server Error\r\n";
-                    break;
-                case HttpStatus::CREATED:
-                    os << "201 Created\r\n";
-                    break;
-                case HttpStatus::ACCEPTED:
-                    os << "202 Accepted\r\n";
-                    break;
-                default:
-                    os << "500 Internal Server Error\r\n";
-                    break;
-            }
+            std::string_view version = version_prefix(res.version);
+            std::string_view status = status_line(res.status);
+            os.rdbuf()->sputn(version.data(), version.size());
+            os.rdbuf()->sputn(status.data(), status.size());
         }
         std::size_t num_headers = res.headers.size();
         for(std::size_t i = res.next_header; i < num_headers; ++i){
@@ -1100,22 +1138,10 @@ namespace http
                         // until the first whitespace character.
                         res.status_buf.push_back(c);
                     } else {
-                        if(res.status_buf == "200"){
-                            res.status = HttpStatus::OK;
-                        } else if (res.status_buf == "204"){
-                            res.status = HttpStatus::NO_CONTENT;
-                        } else if (res.status_buf == "404"){
-                            res.status = HttpStatus::NOT_FOUND;
-                        } else if (res.status_buf == "409"){
-                            res.status = HttpStatus::CONFLICT;
-                        } else if (res.status_buf == "405"){
-                            res.status = HttpStatus::METHOD_NOT_ALLOWED;
-                        } else if (res.status_buf == "500"){
-                            res.status = HttpStatus::INTERNAL_SERVER_ERROR;
-                        } else if (res.status_buf == "201"){
-                            res.status = HttpStatus::CREATED;
-                        } else if (res.status_buf == "202"){
-                            res.status = HttpStatus::ACCEPTED;
+                        std::size_t code = 0;
+                        std::from_chars_result fc = std::from_chars(res.status_buf.data(), res.status_buf.data()+res.status_buf.size(), code, 10);
+                        if(fc.ec == std::errc{} && !status_line(code).empty()){
+                            res.status = static_cast<HttpStatus>(code);
                         } else {
                             res.status = HttpStatus::INTERNAL_SERVER_ERROR;
                         }
@@ -1143,6 +1169,13 @@ namespace http
                     if(next_header.not_last){
                         ++(res.num_headers);
                         res.headers.emplace_back();
+                    } else if(!res.not_chunked_transfer){
+                        // Informational, 204 No Content, and 304 Not Modified responses never have a body,
+                        // after a 101 Switching Protocols the rest of the stream belongs to the new protocol.
+                        std::size_t code = static_cast<std::size_t>(res.status);
+                        if(code < 200 || code == 204 || code == 304){
+                            res.next_chunk = res.num_chunks;
+                        }
                     }
                     ++(res.next_header);
                 }
@@ -1161,7 +1194,7 @@ namespace http
                         next_chunk.chunk_size_found = true;
                         next_chunk.chunk_body_start = true;
                     }
-                    is >> next_chunk;
+                    read_content(is, next_chunk);
                     if(next_chunk.chunk_size == next_chunk.received_bytes){
                         // Finish parsing.
                         res.next_chunk = res.num_chunks;
@@ -1182,4 +1215,115 @@ namespace http
         return is;        
     }
 
-}
\ No newline at end of file
+
+    static std::size_t query_start(const HttpRequest& req){
+        if(req.route_finished){
+            return req.query_found ? req.query_pos : req.route.size();
+        }
+        return std::min(req.route.find('?'), req.route.size());
+    }
+
+    std::string_view path(const HttpRequest& req){
+        return std::string_view(req.route).substr(0, query_start(req));
+    }
+
+    std::string_view query(const HttpRequest& req){
+        std::size_t pos = query_start(req);
+        return pos < req.route.size() ? std::string_view(req.route).substr(pos + 1) : std::string_view();
+    }
+
+    static int hex_digit(char c){
+        if(c >= '0' && c <= '9'){
+            return c - '0';
+        } else if(c >= 'a' && c <= 'f'){
+            return c - 'a' + 10;
+        } else if(c >= 'A' && c <= 'F'){
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool percent_decode(std::string_view in, char* buf, std::size_t size, std::string_view& out, bool plus){
+        std::size_t n = 0;
+        for(std::size_t i = 0; i < in.size(); ++i, ++n){
+            if(n == size){
+                return false;
+            }
+            char c = in[i];
+            if(c == '%'){
+                int hi, lo;
+                if(in.size() - i < 3 || (hi = hex_digit(in[i+1])) < 0 || (lo = hex_digit(in[i+2])) < 0){
+                    return false;
+                }
+                buf[n] = static_cast<char>(hi << 4 | lo);
+                i += 2;
+            } else if(plus && c == '+'){
+                buf[n] = ' ';
+            } else {
+                buf[n] = c;
+            }
+        }
+        out = std::string_view(buf, n);
+        return true;
+    }
+
+    void HttpQuery::iterator::next(){
+        while(!_rest.empty()){
+            std::size_t amp = std::min(_rest.find('&'), _rest.size());
+            std::string_view pair = _rest.substr(0, amp);
+            _rest.remove_prefix(std::min(amp + 1, _rest.size()));
+            if(pair.empty()){
+                continue;
+            }
+            std::size_t eq = std::min(pair.find('='), pair.size());
+            _param.name = pair.substr(0, eq);
+            _param.value = pair.substr(std::min(eq + 1, pair.size()));
+            return;
+        }
+        _param = HttpQueryParam{};
+    }
+
+    bool HttpQuery::find(std::string_view name, std::string_view& value) const {
+        for(const auto& param: *this){
+            if(param.name == name){
+                value = param.value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Strings that fit in the small string buffer hold no heap memory.
+    static std::size_t memory(const std::string& s){
+        static const std::size_t small = std::string().capacity();
+        return s.capacity() > small ? s.capacity() + 1 : 0;
+    }
+
+    static std::size_t memory(const HttpBigNum& n){
+        return n.capacity() * sizeof(std::size_t);
+    }
+
+    static std::size_t memory(const std::vector<HttpHeader>& headers){
+        std::size_t bytes = headers.capacity() * sizeof(HttpHeader);
+        for(auto& header: headers){
+            bytes += memory(header.field_value) + memory(header.buf);
+        }
+        return bytes;
+    }
+
+    static std::size_t memory(const std::vector<HttpChunk>& chunks){
+        std::size_t bytes = chunks.capacity() * sizeof(HttpChunk);
+        for(auto& chunk: chunks){
+            bytes += memory(chunk.chunk_size) + memory(chunk.chunk_data) + memory(chunk.received_bytes) + memory(chunk.chunk_header);
+        }
+        return bytes;
+    }
+
+    std::size_t memory(const HttpRequest& req){
+        return memory(req.route) + memory(req.version_buf) + memory(req.verb_buf) + memory(req.headers) + memory(req.chunks);
+    }
+
+    std::size_t memory(const HttpResponse& res){
+        return memory(res.version_buf) + memory(res.status_buf) + memory(res.headers) + memory(res.chunks);
+    }
+}
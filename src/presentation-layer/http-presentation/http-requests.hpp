@@ -5,8 +5,10 @@
  */
 #ifndef HTTP_REQUESTS_HPP
 #define HTTP_REQUESTS_HPP
+#include <array>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace http{
     enum class HttpVersion
@@ -31,19 +33,184 @@ namespace http{
         CONNECT
     };
 
-    // This is a non exhaustive list of status codes.
+    // The status codes in the IANA HTTP Status Code Registry.
     enum class HttpStatus
     {
+        CONTINUE = 100,
+        SWITCHING_PROTOCOLS = 101,
+        PROCESSING = 102,
+        EARLY_HINTS = 103,
         OK = 200,
+        CREATED = 201,
+        ACCEPTED = 202,
+        NON_AUTHORITATIVE_INFORMATION = 203,
         NO_CONTENT = 204,
+        RESET_CONTENT = 205,
+        PARTIAL_CONTENT = 206,
+        MULTI_STATUS = 207,
+        ALREADY_REPORTED = 208,
+        IM_USED = 226,
+        MULTIPLE_CHOICES = 300,
+        MOVED_PERMANENTLY = 301,
+        FOUND = 302,
+        SEE_OTHER = 303,
+        NOT_MODIFIED = 304,
+        USE_PROXY = 305,
+        TEMPORARY_REDIRECT = 307,
+        PERMANENT_REDIRECT = 308,
+        BAD_REQUEST = 400,
+        UNAUTHORIZED = 401,
+        PAYMENT_REQUIRED = 402,
+        FORBIDDEN = 403,
         NOT_FOUND = 404,
-        CONFLICT = 409,
         METHOD_NOT_ALLOWED = 405,
+        NOT_ACCEPTABLE = 406,
+        PROXY_AUTHENTICATION_REQUIRED = 407,
+        REQUEST_TIMEOUT = 408,
+        CONFLICT = 409,
+        GONE = 410,
+        LENGTH_REQUIRED = 411,
+        PRECONDITION_FAILED = 412,
+        CONTENT_TOO_LARGE = 413,
+        URI_TOO_LONG = 414,
+        UNSUPPORTED_MEDIA_TYPE = 415,
+        RANGE_NOT_SATISFIABLE = 416,
+        EXPECTATION_FAILED = 417,
+        MISDIRECTED_REQUEST = 421,
+        UNPROCESSABLE_CONTENT = 422,
+        LOCKED = 423,
+        FAILED_DEPENDENCY = 424,
+        TOO_EARLY = 425,
+        UPGRADE_REQUIRED = 426,
+        PRECONDITION_REQUIRED = 428,
+        TOO_MANY_REQUESTS = 429,
+        REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
+        UNAVAILABLE_FOR_LEGAL_REASONS = 451,
         INTERNAL_SERVER_ERROR = 500,
-        CREATED = 201,
-        ACCEPTED = 202
+        NOT_IMPLEMENTED = 501,
+        BAD_GATEWAY = 502,
+        SERVICE_UNAVAILABLE = 503,
+        GATEWAY_TIMEOUT = 504,
+        HTTP_VERSION_NOT_SUPPORTED = 505,
+        VARIANT_ALSO_NEGOTIATES = 506,
+        INSUFFICIENT_STORAGE = 507,
+        LOOP_DETECTED = 508,
+        NOT_EXTENDED = 510,
+        NETWORK_AUTHENTICATION_REQUIRED = 511
     };
 
+    // Serialized status lines (without the version) for every registered status code.
+    struct HttpStatusLine
+    {
+        HttpStatus status;
+        std::string_view line;
+    };
+    inline constexpr HttpStatusLine http_status_lines[] = {
+        {HttpStatus::CONTINUE, "100 Continue\r\n"},
+        {HttpStatus::SWITCHING_PROTOCOLS, "101 Switching Protocols\r\n"},
+        {HttpStatus::PROCESSING, "102 Processing\r\n"},
+        {HttpStatus::EARLY_HINTS, "103 Early Hints\r\n"},
+        {HttpStatus::OK, "200 OK\r\n"},
+        {HttpStatus::CREATED, "201 Created\r\n"},
+        {HttpStatus::ACCEPTED, "202 Accepted\r\n"},
+        {HttpStatus::NON_AUTHORITATIVE_INFORMATION, "203 Non-Authoritative Information\r\n"},
+        {HttpStatus::NO_CONTENT, "204 No Content\r\n"},
+        {HttpStatus::RESET_CONTENT, "205 Reset Content\r\n"},
+        {HttpStatus::PARTIAL_CONTENT, "206 Partial Content\r\n"},
+        {HttpStatus::MULTI_STATUS, "207 Multi-Status\r\n"},
+        {HttpStatus::ALREADY_REPORTED, "208 Already Reported\r\n"},
+        {HttpStatus::IM_USED, "226 IM Used\r\n"},
+        {HttpStatus::MULTIPLE_CHOICES, "300 Multiple Choices\r\n"},
+        {HttpStatus::MOVED_PERMANENTLY, "301 Moved Permanently\r\n"},
+        {HttpStatus::FOUND, "302 Found\r\n"},
+        {HttpStatus::SEE_OTHER, "303 See Other\r\n"},
+        {HttpStatus::NOT_MODIFIED, "304 Not Modified\r\n"},
+        {HttpStatus::USE_PROXY, "305 Use Proxy\r\n"},
+        {HttpStatus::TEMPORARY_REDIRECT, "307 Temporary Redirect\r\n"},
+        {HttpStatus::PERMANENT_REDIRECT, "308 Permanent Redirect\r\n"},
+        {HttpStatus::BAD_REQUEST, "400 Bad Request\r\n"},
+        {HttpStatus::UNAUTHORIZED, "401 Unauthorized\r\n"},
+        {HttpStatus::PAYMENT_REQUIRED, "402 Payment Required\r\n"},
+        {HttpStatus::FORBIDDEN, "403 Forbidden\r\n"},
+        {HttpStatus::NOT_FOUND, "404 Not Found\r\n"},
+        {HttpStatus::METHOD_NOT_ALLOWED, "405 Method Not Allowed\r\n"},
+        {HttpStatus::NOT_ACCEPTABLE, "406 Not Acceptable\r\n"},
+        {HttpStatus::PROXY_AUTHENTICATION_REQUIRED, "407 Proxy Authentication Required\r\n"},
+        {HttpStatus::REQUEST_TIMEOUT, "408 Request Timeout\r\n"},
+        {HttpStatus::CONFLICT, "409 Conflict\r\n"},
+        {HttpStatus::GONE, "410 Gone\r\n"},
+        {HttpStatus::LENGTH_REQUIRED, "411 Length Required\r\n"},
+        {HttpStatus::PRECONDITION_FAILED, "412 Precondition Failed\r\n"},
+        {HttpStatus::CONTENT_TOO_LARGE, "413 Content Too Large\r\n"},
+        {HttpStatus::URI_TOO_LONG, "414 URI Too Long\r\n"},
+        {HttpStatus::UNSUPPORTED_MEDIA_TYPE, "415 Unsupported Media Type\r\n"},
+        {HttpStatus::RANGE_NOT_SATISFIABLE, "416 Range Not Satisfiable\r\n"},
+        {HttpStatus::EXPECTATION_FAILED, "417 Expectation Failed\r\n"},
+        {HttpStatus::MISDIRECTED_REQUEST, "421 Misdirected Request\r\n"},
+        {HttpStatus::UNPROCESSABLE_CONTENT, "422 Unprocessable Content\r\n"},
+        {HttpStatus::LOCKED, "423 Locked\r\n"},
+        {HttpStatus::FAILED_DEPENDENCY, "424 Failed Dependency\r\n"},
+        {HttpStatus::TOO_EARLY, "425 Too Early\r\n"},
+        {HttpStatus::UPGRADE_REQUIRED, "426 Upgrade Required\r\n"},
+        {HttpStatus::PRECONDITION_REQUIRED, "428 Precondition Required\r\n"},
+        {HttpStatus::TOO_MANY_REQUESTS, "429 Too Many Requests\r\n"},
+        {HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE, "431 Request Header Fields Too Large\r\n"},
+        {HttpStatus::UNAVAILABLE_FOR_LEGAL_REASONS, "451 Unavailable For Legal Reasons\r\n"},
+        {HttpStatus::INTERNAL_SERVER_ERROR, "500 Internal Server Error\r\n"},
+        {HttpStatus::NOT_IMPLEMENTED, "501 Not Implemented\r\n"},
+        {HttpStatus::BAD_GATEWAY, "502 Bad Gateway\r\n"},
+        {HttpStatus::SERVICE_UNAVAILABLE, "503 Service Unavailable\r\n"},
+        {HttpStatus::GATEWAY_TIMEOUT, "504 Gateway Timeout\r\n"},
+        {HttpStatus::HTTP_VERSION_NOT_SUPPORTED, "505 HTTP Version Not Supported\r\n"},
+        {HttpStatus::VARIANT_ALSO_NEGOTIATES, "506 Variant Also Negotiates\r\n"},
+        {HttpStatus::INSUFFICIENT_STORAGE, "507 Insufficient Storage\r\n"},
+        {HttpStatus::LOOP_DETECTED, "508 Loop Detected\r\n"},
+        {HttpStatus::NOT_EXTENDED, "510 Not Extended\r\n"},
+        {HttpStatus::NETWORK_AUTHENTICATION_REQUIRED, "511 Network Authentication Required\r\n"}
+    };
+
+    // Status lines indexed directly by status code, so the lookup is a single load.
+    constexpr std::size_t HTTP_STATUS_MIN = 100;
+    constexpr std::size_t HTTP_STATUS_MAX = 599;
+    constexpr std::array<std::string_view, HTTP_STATUS_MAX - HTTP_STATUS_MIN + 1> make_http_status_table(){
+        std::array<std::string_view, HTTP_STATUS_MAX - HTTP_STATUS_MIN + 1> table{};
+        for(const auto& entry: http_status_lines){
+            table[static_cast<std::size_t>(entry.status) - HTTP_STATUS_MIN] = entry.line;
+        }
+        return table;
+    }
+    inline constexpr auto http_status_table = make_http_status_table();
+
+    // Returns the status line for a registered status code, or an empty string_view.
+    constexpr std::string_view status_line(std::size_t code){
+        if(code < HTTP_STATUS_MIN || code > HTTP_STATUS_MAX){
+            return std::string_view();
+        }
+        return http_status_table[code - HTTP_STATUS_MIN];
+    }
+    // Unregistered status codes are serialized as 500 Internal Server Error.
+    constexpr std::string_view status_line(HttpStatus status){
+        std::string_view line = status_line(static_cast<std::size_t>(status));
+        return line.empty() ? status_line(HttpStatus::INTERNAL_SERVER_ERROR) : line;
+    }
+
+    // The start of a status line, up to and including the space before the status code.
+    constexpr std::string_view version_prefix(HttpVersion version){
+        switch(version)
+        {
+            case HttpVersion::V1_1:
+                return "HTTP/1.1 ";
+            case HttpVersion::V2:
+                return "HTTP/2 ";
+            case HttpVersion::V3:
+                return "HTTP/3 ";
+            case HttpVersion::V0_9:
+                return "HTTP/0.9 ";
+            default:
+                return "HTTP/1.0 ";
+        }
+    }
+
     // This is a non-exhaustive list of HTTP headers
     enum class HttpHeaderField
     {
@@ -54,7 +221,12 @@ namespace http{
         HOST,
         TRANSFER_ENCODING,
         END_OF_HEADERS,
-        CONNECTION
+        CONNECTION,
+        UPGRADE,
+        SEC_WEBSOCKET_KEY,
+        SEC_WEBSOCKET_ACCEPT,
+        SEC_WEBSOCKET_VERSION,
+        SEC_WEBSOCKET_EXTENSIONS
     };
 
     // This represents arbitrarily large Http Chunk Size numbers.
@@ -117,6 +289,8 @@ namespace http{
     // Http chunks are extracted from input streams.
     std::istream& operator>>(std::istream& is, HttpChunk& chunk);
     std::ostream& operator<<(std::ostream& os, const HttpChunk& chunk);
+    // A chunk to be written that carries data, with all of the parser flags cleared.
+    HttpChunk make_chunk(std::string data);
     
     struct HttpHeader
     {
@@ -134,6 +308,8 @@ namespace http{
     };
     std::istream& operator>>(std::istream& is, HttpHeader& header);
     std::ostream& operator<<(std::ostream& os, const HttpHeader& header);
+    // A header to be written, with all of the parser flags cleared.
+    HttpHeader make_header(HttpHeaderField field, std::string value = std::string());
 
     // This is an HTTP1.1 Request Structure.
     // It is not comprehensive, and it only partially complies with the
@@ -178,6 +354,10 @@ namespace http{
         // flags to track the status of the route string buffer.
         bool route_started;
         bool route_finished;
+        // The parser records where the query string starts:
+        // if query_found is set, route[query_pos] is the '?' that separates the path from the query.
+        std::size_t query_pos;
+        bool query_found;
 
         //flags and buffers to track the status of the version string.
         std::string version_buf;
@@ -191,8 +371,9 @@ namespace http{
         bool verb_finished;
 
         // If this flag is true, then Content-Length header field must be present.
-        // Otherwise chunked transfer encoding is assumed.
-        // By default, chunked transfer encoding is assumed.
+        // Otherwise a request is framed by its headers: without a Content-Length or a Transfer-Encoding
+        // it is parsed as having no body. A request serialized with chunks but neither header
+        // is sent with Transfer-Encoding: chunked.
         bool not_chunked_transfer;
 
         // Overall stream control flags.
@@ -201,6 +382,61 @@ namespace http{
     std::istream& operator>>(std::istream& is, HttpRequest& req);
     std::ostream& operator<<(std::ostream& os, const HttpRequest& req);
 
+    // The route of a request without its query string, and the query string without its '?'.
+    // Requests whose route was set directly, rather than parsed, are searched for the '?'.
+    std::string_view path(const HttpRequest& req);
+    std::string_view query(const HttpRequest& req);
+
+    // Percent-decode in into the size bytes at buf, out is set to the decoded bytes.
+    // The decoded text is never longer than in, so a buffer of in.size() bytes is always enough.
+    // If plus is set '+' decodes to a space, as it does in query strings.
+    // Returns false if an escape is malformed or buf is too small.
+    bool percent_decode(std::string_view in, char* buf, std::size_t size, std::string_view& out, bool plus = false);
+
+    // A name=value pair of a query string, both still percent-encoded.
+    struct HttpQueryParam
+    {
+        std::string_view name;
+        std::string_view value;
+
+        bool decode_name(char* buf, std::size_t size, std::string_view& out) const { return percent_decode(name, buf, size, out, true); }
+        bool decode_value(char* buf, std::size_t size, std::string_view& out) const { return percent_decode(value, buf, size, out, true); }
+    };
+
+    // Iterates over the parameters of a query string, without decoding or copying them.
+    // Empty parameters (as in "a=1&&b=2") are skipped, and a parameter without an '=' has an empty value.
+    class HttpQuery
+    {
+        std::string_view _query;
+
+    public:
+        class iterator
+        {
+            std::string_view _rest;
+            HttpQueryParam _param;
+
+            void next();
+
+        public:
+            iterator() = default;
+            iterator(std::string_view query): _rest(query) { next(); }
+            const HttpQueryParam& operator*() const { return _param; }
+            const HttpQueryParam* operator->() const { return &_param; }
+            iterator& operator++() { next(); return *this; }
+            bool operator==(const iterator& other) const { return _param.name.data() == other._param.name.data(); }
+            bool operator!=(const iterator& other) const { return !(*this == other); }
+        };
+
+        HttpQuery(std::string_view query): _query(query) {}
+        HttpQuery(const HttpRequest& req): _query(query(req)) {}
+
+        iterator begin() const { return iterator(_query); }
+        iterator end() const { return iterator(); }
+        // The still encoded value of the first parameter with an encoded name equal to name.
+        // Returns false if there is none.
+        bool find(std::string_view name, std::string_view& value) const;
+    };
+
     struct HttpResponse
     {
         HttpVersion version;
@@ -250,6 +486,10 @@ namespace http{
         bool not_chunked_transfer;     
     };
     std::ostream& operator<<(std::ostream& os, const HttpResponse& res);
+
+    // Heap bytes held by a message: the capacity of its strings and vectors, which are kept until the message is reset.
+    std::size_t memory(const HttpRequest& req);
+    std::size_t memory(const HttpResponse& res);
     std::istream& operator>>(std::istream& is, HttpResponse& res);
 
 }
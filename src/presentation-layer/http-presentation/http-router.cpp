@@ -0,0 +1,168 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "http-router.hpp"
+#include <cstring>
+
+namespace http
+{
+    HttpRouteTree::HttpRouteTree(){
+        // The root is a literal node that matches nothing, so that every template starts among its children.
+        node(std::string_view());
+    }
+
+    std::uint32_t HttpRouteTree::node(std::string_view text){
+        Node n;
+        n.text = text;
+        _nodes.push_back(std::move(n));
+        return static_cast<std::uint32_t>(_nodes.size() - 1);
+    }
+
+    // Nodes are referred to by their index, since adding a node may move all of the others.
+    bool HttpRouteTree::insert(std::uint32_t n, std::string_view pattern, std::size_t verb, std::uint32_t handler){
+        if(pattern.empty()){
+            auto& h = _nodes[n].handlers[verb];
+            if(h != NONE){
+                return false;
+            }
+            h = handler;
+            return true;
+        }
+        if(pattern[0] == ':'){
+            std::size_t end = std::min(pattern.find('/'), pattern.size());
+            std::string_view name = pattern.substr(1, end - 1);
+            std::uint32_t child = _nodes[n].param;
+            if(child == NONE){
+                child = node(name);
+                _nodes[n].param = child;
+            } else if(_nodes[child].text != name){
+                return false;
+            }
+            return insert(child, pattern.substr(end), verb, handler);
+        }
+        if(pattern[0] == '*'){
+            std::string_view name = pattern.substr(1);
+            std::uint32_t child = _nodes[n].wildcard;
+            if(child == NONE){
+                child = node(name);
+                _nodes[n].wildcard = child;
+            } else if(_nodes[child].text != name){
+                return false;
+            }
+            return insert(child, std::string_view(), verb, handler);
+        }
+        std::string_view literal = pattern.substr(0, pattern.find_first_of(":*"));
+        std::size_t i = _nodes[n].first.find(literal[0]);
+        if(i == std::string::npos){
+            std::uint32_t child = node(literal);
+            _nodes[n].first.push_back(literal[0]);
+            _nodes[n].literals.push_back(child);
+            return insert(child, pattern.substr(literal.size()), verb, handler);
+        }
+        std::uint32_t child = _nodes[n].literals[i];
+        const std::string& text = _nodes[child].text;
+        std::size_t common = 0;
+        while(common < text.size() && common < literal.size() && text[common] == literal[common]){
+            ++common;
+        }
+        if(common < text.size()){
+            // Split the child where the literals part, the rest of it becomes its only child.
+            std::uint32_t tail = node(std::string(text.substr(common)));
+            Node& c = _nodes[child];
+            Node& t = _nodes[tail];
+            t.first = std::move(c.first);
+            t.literals = std::move(c.literals);
+            t.param = c.param;
+            t.wildcard = c.wildcard;
+            t.handlers = c.handlers;
+            c.text.resize(common);
+            c.first.assign(1, t.text[0]);
+            c.literals.assign(1, tail);
+            c.param = NONE;
+            c.wildcard = NONE;
+            c.handlers.fill(NONE);
+        }
+        return insert(child, pattern.substr(common), verb, handler);
+    }
+
+    bool HttpRouteTree::add(HttpVerb verb, std::string_view pattern, std::uint32_t handler){
+        std::size_t v = static_cast<std::size_t>(verb);
+        if(v >= NUM_VERBS || handler == NONE || pattern.empty() || pattern[0] != '/'){
+            return false;
+        }
+        std::size_t params = 0;
+        for(std::size_t i = 0; i < pattern.size(); ++i){
+            if(pattern[i] != ':' && pattern[i] != '*'){
+                continue;
+            }
+            if(pattern[i-1] != '/' || ++params > HttpRouteParams::MAX_PARAMS){
+                return false;
+            }
+            std::size_t end = std::min(pattern.find('/', i), pattern.size());
+            if(pattern[i] == '*' && end != pattern.size()){
+                return false;
+            }
+            std::string_view name = pattern.substr(i + 1, end - i - 1);
+            if(name.empty() || name.find_first_of(":*") != std::string_view::npos){
+                return false;
+            }
+            i = end;
+        }
+        return insert(0, pattern, v, handler);
+    }
+
+    std::uint32_t HttpRouteTree::find(std::uint32_t n, std::size_t verb, std::string_view route, std::size_t pos, HttpRouteParams& params) const {
+        const Node& node = _nodes[n];
+        if(pos == route.size()){
+            if(node.handlers[verb] != NONE){
+                return node.handlers[verb];
+            }
+        } else {
+            std::size_t i = node.first.find(route[pos]);
+            if(i != std::string::npos){
+                std::uint32_t child = node.literals[i];
+                const std::string& text = _nodes[child].text;
+                if(route.size() - pos >= text.size() && std::memcmp(route.data() + pos, text.data(), text.size()) == 0){
+                    std::uint32_t h = find(child, verb, route, pos + text.size(), params);
+                    if(h != NONE){
+                        return h;
+                    }
+                }
+            }
+            if(node.param != NONE){
+                std::size_t end = std::min(route.find('/', pos), route.size());
+                if(end > pos){
+                    std::size_t i = params._size++;
+                    params._names[i] = _nodes[node.param].text;
+                    params._values[i] = route.substr(pos, end - pos);
+                    std::uint32_t h = find(node.param, verb, route, end, params);
+                    if(h != NONE){
+                        return h;
+                    }
+                    params._size = i;
+                }
+            }
+        }
+        if(node.wildcard != NONE){
+            const Node& w = _nodes[node.wildcard];
+            if(w.handlers[verb] != NONE){
+                std::size_t i = params._size++;
+                params._names[i] = w.text;
+                params._values[i] = route.substr(pos);
+                return w.handlers[verb];
+            }
+        }
+        return NONE;
+    }
+
+    std::uint32_t HttpRouteTree::match(HttpVerb verb, std::string_view route, HttpRouteParams& params) const {
+        params.clear();
+        std::size_t v = static_cast<std::size_t>(verb);
+        if(v >= NUM_VERBS){
+            return NONE;
+        }
+        return find(0, v, route, 0, params);
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef HTTP_ROUTER_HPP
+#define HTTP_ROUTER_HPP
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "http-requests.hpp"
+
+namespace http{
+    // The parameters captured by a matched route, as views into the route and into the router.
+    class HttpRouteParams
+    {
+    public:
+        static constexpr std::size_t MAX_PARAMS = 16;
+
+    private:
+        std::array<std::string_view, MAX_PARAMS> _names;
+        std::array<std::string_view, MAX_PARAMS> _values;
+        std::size_t _size = 0;
+
+        friend class HttpRouteTree;
+
+    public:
+        std::size_t size() const { return _size; }
+        std::string_view name(std::size_t i) const { return _names[i]; }
+        std::string_view value(std::size_t i) const { return _values[i]; }
+        // The value of a named parameter, empty if there is none.
+        std::string_view operator[](std::string_view name) const {
+            for(std::size_t i = 0; i < _size; ++i){
+                if(_names[i] == name){
+                    return _values[i];
+                }
+            }
+            return std::string_view();
+        }
+        void clear() { _size = 0; }
+    };
+
+    // A compressed radix tree of route templates, that maps a verb and a route to the index of a handler.
+    // Templates are made of literal bytes, parameters, and a wildcard:
+    //
+    //     /users              matches only /users
+    //     /users/:id          matches /users/42, and captures id = "42"
+    //     /users/:id/posts    parameters match one non-empty path segment
+    //     /static/*path       matches /static/, /static/css/site.css, and captures path = "css/site.css"
+    //
+    // Parameters and wildcards start a path segment, and a wildcard ends the template.
+    // Where templates overlap, literals are preferred over parameters, and parameters over wildcards.
+    // A match walks the route once, comparing whole literal prefixes at a time, and only steps back
+    // to try a parameter or a wildcard where a literal that was preferred fails further on.
+    // So the cost of a match depends on the length of the route and the number of places where templates part along it,
+    // not on the number of templates.
+    // Routes are matched as they are, percent-encoded bytes included (see percent_decode),
+    // and matching a request leaves out its query string.
+    class HttpRouteTree
+    {
+    public:
+        static constexpr std::uint32_t NONE = UINT32_MAX;
+        static constexpr std::size_t NUM_VERBS = static_cast<std::size_t>(HttpVerb::CONNECT) + 1;
+
+    private:
+        struct Node
+        {
+            // The literal bytes of a literal node, or the name of a parameter or a wildcard.
+            std::string text;
+            // Literal children, and the first byte of each of them.
+            std::string first;
+            std::vector<std::uint32_t> literals;
+            std::uint32_t param = NONE;
+            std::uint32_t wildcard = NONE;
+            std::array<std::uint32_t, NUM_VERBS> handlers;
+
+            Node() { handlers.fill(NONE); }
+        };
+        std::vector<Node> _nodes;
+
+        std::uint32_t node(std::string_view text);
+        bool insert(std::uint32_t n, std::string_view pattern, std::size_t verb, std::uint32_t handler);
+        std::uint32_t find(std::uint32_t n, std::size_t verb, std::string_view route, std::size_t pos, HttpRouteParams& params) const;
+
+    public:
+        HttpRouteTree();
+
+        // Returns false if the template is malformed, has more than MAX_PARAMS parameters,
+        // names a parameter differently from a template that it overlaps with, or is already routed for the verb.
+        bool add(HttpVerb verb, std::string_view pattern, std::uint32_t handler);
+        // Returns NONE if nothing matches, params holds the captured parameters of a match.
+        std::uint32_t match(HttpVerb verb, std::string_view route, HttpRouteParams& params) const;
+        std::size_t size() const { return _nodes.size(); }
+    };
+
+    // A verb and the template that it was routed with.
+    struct HttpRoute
+    {
+        HttpVerb verb;
+        std::string pattern;
+    };
+
+    // Routes requests to handlers of any type, such as function pointers or std::function.
+    // Handlers are numbered from 0 in the order that they were added, so that the number of a match
+    // can key anything else that is kept per route (e.g. metrics::RouteLatency).
+    template<class Handler>
+    class HttpRouter
+    {
+        HttpRouteTree _tree;
+        std::vector<Handler> _handlers;
+        std::vector<HttpRoute> _routes;
+
+    public:
+        bool add(HttpVerb verb, std::string_view pattern, Handler handler){
+            if(!_tree.add(verb, pattern, static_cast<std::uint32_t>(_handlers.size()))){
+                return false;
+            }
+            _handlers.push_back(std::move(handler));
+            _routes.push_back(HttpRoute{verb, std::string(pattern)});
+            return true;
+        }
+
+        // Returns the number of the handler that matches, or HttpRouteTree::NONE.
+        std::uint32_t find(HttpVerb verb, std::string_view route, HttpRouteParams& params) const {
+            return _tree.match(verb, route, params);
+        }
+        std::uint32_t find(const HttpRequest& req, HttpRouteParams& params) const {
+            return find(req.verb, path(req), params);
+        }
+
+        // Returns nullptr if nothing matches.
+        const Handler* match(HttpVerb verb, std::string_view route, HttpRouteParams& params) const {
+            std::uint32_t i = find(verb, route, params);
+            return i == HttpRouteTree::NONE ? nullptr : &_handlers[i];
+        }
+        const Handler* match(const HttpRequest& req, HttpRouteParams& params) const {
+            return match(req.verb, path(req), params);
+        }
+
+        const Handler& operator[](std::uint32_t i) const { return _handlers[i]; }
+        const HttpRoute& route(std::uint32_t i) const { return _routes[i]; }
+        std::size_t size() const { return _handlers.size(); }
+    };
+}
+#endif
@@ -0,0 +1,51 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "http-templates.hpp"
+#include <charconv>
+#include <sstream>
+
+namespace http
+{
+    HttpResponseTemplate::HttpResponseTemplate(const HttpResponse& res): HttpResponseTemplate(res.version, res.status, res.headers) {}
+
+    HttpResponseTemplate::HttpResponseTemplate(HttpVersion version, HttpStatus status, const std::vector<HttpHeader>& headers){
+        std::ostringstream os;
+        os << version_prefix(version) << status_line(status);
+        for(const auto& header: headers){
+            switch(header.field_name)
+            {
+                case HttpHeaderField::CONTENT_LENGTH:
+                case HttpHeaderField::TRANSFER_ENCODING:
+                case HttpHeaderField::END_OF_HEADERS:
+                    break;
+                default:
+                    os << header;
+                    break;
+            }
+        }
+        os << "Content-Length: ";
+        _prefix = os.str();
+    }
+
+    void HttpResponseTemplate::write(std::streambuf& out, std::string_view body, std::string_view extra) const {
+        // Content-Length digits, the end of the Content-Length header, and the end of the headers.
+        char length[32];
+        char* end = std::to_chars(length, length + 20, body.size()).ptr;
+        *end++ = '\r';
+        *end++ = '\n';
+        out.sputn(_prefix.data(), _prefix.size());
+        if(extra.empty()){
+            *end++ = '\r';
+            *end++ = '\n';
+            out.sputn(length, end - length);
+        } else {
+            out.sputn(length, end - length);
+            out.sputn(extra.data(), extra.size());
+            out.sputn("\r\n", 2);
+        }
+        out.sputn(body.data(), body.size());
+    }
+}
@@ -0,0 +1,33 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef HTTP_TEMPLATES_HPP
+#define HTTP_TEMPLATES_HPP
+#include <streambuf>
+#include "http-requests.hpp"
+
+namespace http{
+    // Response templates serialize the status line and the fixed headers of a response once.
+    // Sending a response then only copies the serialized prefix, the Content-Length, and the body.
+    // Content-Length and Transfer-Encoding headers in the template response are ignored,
+    // and the body is always sent with a Content-Length.
+    class HttpResponseTemplate
+    {
+        // Everything up to and including "Content-Length: ".
+        std::string _prefix;
+
+    public:
+        HttpResponseTemplate(const HttpResponse& res);
+        HttpResponseTemplate(HttpVersion version, HttpStatus status, const std::vector<HttpHeader>& headers);
+
+        // Serialize a complete response.
+        // extra holds any additional serialized header lines (each terminated by "\r\n"),
+        // e.g. per second metadata such as the Date header.
+        void write(std::streambuf& out, std::string_view body, std::string_view extra = std::string_view()) const;
+
+        std::string_view prefix() const { return _prefix; }
+    };
+}
+#endif
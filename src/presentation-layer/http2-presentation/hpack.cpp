@@ -0,0 +1,441 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include "hpack.hpp"
+namespace http
+{
+    namespace hpack
+    {
+        struct StaticEntry
+        {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        // RFC 7541 Appendix A, the static table is indexed from 1.
+        static constexpr StaticEntry static_table[] = {
+            {":authority", ""},
+            {":method", "GET"},
+            {":method", "POST"},
+            {":path", "/"},
+            {":path", "/index.html"},
+            {":scheme", "http"},
+            {":scheme", "https"},
+            {":status", "200"},
+            {":status", "204"},
+            {":status", "206"},
+            {":status", "304"},
+            {":status", "400"},
+            {":status", "404"},
+            {":status", "500"},
+            {"accept-charset", ""},
+            {"accept-encoding", "gzip, deflate"},
+            {"accept-language", ""},
+            {"accept-ranges", ""},
+            {"accept", ""},
+            {"access-control-allow-origin", ""},
+            {"age", ""},
+            {"allow", ""},
+            {"authorization", ""},
+            {"cache-control", ""},
+            {"content-disposition", ""},
+            {"content-encoding", ""},
+            {"content-language", ""},
+            {"content-length", ""},
+            {"content-location", ""},
+            {"content-range", ""},
+            {"content-type", ""},
+            {"cookie", ""},
+            {"date", ""},
+            {"etag", ""},
+            {"expect", ""},
+            {"expires", ""},
+            {"from", ""},
+            {"host", ""},
+            {"if-match", ""},
+            {"if-modified-since", ""},
+            {"if-none-match", ""},
+            {"if-range", ""},
+            {"if-unmodified-since", ""},
+            {"last-modified", ""},
+            {"link", ""},
+            {"location", ""},
+            {"max-forwards", ""},
+            {"proxy-authenticate", ""},
+            {"proxy-authorization", ""},
+            {"range", ""},
+            {"referer", ""},
+            {"refresh", ""},
+            {"retry-after", ""},
+            {"server", ""},
+            {"set-cookie", ""},
+            {"strict-transport-security", ""},
+            {"transfer-encoding", ""},
+            {"user-agent", ""},
+            {"vary", ""},
+            {"via", ""},
+            {"www-authenticate", ""}
+        };
+        static constexpr std::size_t STATIC_TABLE_LENGTH = sizeof(static_table)/sizeof(StaticEntry);
+
+        struct HuffmanCode
+        {
+            std::uint32_t code;
+            std::uint8_t length;
+        };
+
+        // RFC 7541 Appendix B, indexed by symbol. The EOS symbol is never encoded so it is left out.
+        static constexpr HuffmanCode huffman_codes[256] = {
+            {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+            {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28}, {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+            {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+            {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+            {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+            {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+            {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+            {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+            {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+            {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+            {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7}, {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+            {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+            {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+            {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+            {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+            {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+            {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+            {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+            {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+            {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+            {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+            {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+            {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+            {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+            {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+            {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+            {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+            {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+            {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+            {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+            {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+            {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}
+        };
+
+        static constexpr std::size_t HUFFMAN_MAX_LENGTH = 30;
+
+        // HPACK's Huffman code is canonical: within a length, codes are consecutive and ordered by symbol,
+        // and every code is numerically larger than the prefixes of the same length of all shorter codes.
+        // So a left aligned bit window decodes to the first length L whose top L bits are below limit[L].
+        struct HuffmanDecoding
+        {
+            std::uint32_t first[HUFFMAN_MAX_LENGTH+1];
+            std::uint32_t limit[HUFFMAN_MAX_LENGTH+1];
+            std::uint16_t offset[HUFFMAN_MAX_LENGTH+1];
+            std::uint8_t symbols[256];
+        };
+
+        static constexpr HuffmanDecoding make_huffman_decoding(){
+            HuffmanDecoding decoding{};
+            std::uint16_t n = 0;
+            for(std::size_t length = 1; length <= HUFFMAN_MAX_LENGTH; ++length){
+                decoding.offset[length] = n;
+                bool found = false;
+                for(std::size_t symbol = 0; symbol < 256; ++symbol){
+                    if(huffman_codes[symbol].length == length){
+                        if(!found){
+                            decoding.first[length] = huffman_codes[symbol].code;
+                            found = true;
+                        }
+                        decoding.symbols[n++] = static_cast<std::uint8_t>(symbol);
+                        decoding.limit[length] = huffman_codes[symbol].code + 1;
+                    }
+                }
+            }
+            return decoding;
+        }
+        static constexpr HuffmanDecoding huffman_decoding = make_huffman_decoding();
+
+        std::size_t huffman_size(std::string_view in){
+            std::size_t bits = 0;
+            for(unsigned char c: in){
+                bits += huffman_codes[c].length;
+            }
+            return (bits + 7)/8;
+        }
+
+        void huffman_encode(std::string_view in, std::string& out){
+            std::uint64_t acc = 0;
+            std::size_t nbits = 0;
+            for(unsigned char c: in){
+                const HuffmanCode& code = huffman_codes[c];
+                acc = (acc << code.length) | code.code;
+                nbits += code.length;
+                while(nbits >= 8){
+                    nbits -= 8;
+                    out.push_back(static_cast<char>(acc >> nbits));
+                }
+            }
+            if(nbits > 0){
+                // Pad with the most significant bits of EOS, which are all ones.
+                out.push_back(static_cast<char>((acc << (8-nbits)) | (0xff >> nbits)));
+            }
+        }
+
+        bool huffman_decode(std::string_view in, std::string& out){
+            // The next nbits of input are left aligned in acc.
+            std::uint64_t acc = 0;
+            std::size_t nbits = 0;
+            auto it = in.cbegin();
+            while(true){
+                while(nbits <= 56 && it != in.cend()){
+                    acc |= static_cast<std::uint64_t>(static_cast<unsigned char>(*it++)) << (56 - nbits);
+                    nbits += 8;
+                }
+                std::size_t length = 5;
+                while(length <= nbits && length <= HUFFMAN_MAX_LENGTH && (acc >> (64 - length)) >= huffman_decoding.limit[length]){
+                    ++length;
+                }
+                if(length > nbits || length > HUFFMAN_MAX_LENGTH){
+                    break;
+                }
+                std::uint32_t code = acc >> (64 - length);
+                out.push_back(huffman_decoding.symbols[huffman_decoding.offset[length] + code - huffman_decoding.first[length]]);
+                acc <<= length;
+                nbits -= length;
+            }
+            if(it != in.cend() || nbits > 7){
+                return false;
+            }
+            // Padding must be shorter than a byte and consist of the most significant bits of EOS.
+            return nbits == 0 || (acc >> (64 - nbits)) == (1u << nbits) - 1;
+        }
+
+        void DynamicTable::evict(std::size_t size){
+            while(!_entries.empty() && _size + size > _max_size){
+                auto& field = _entries.back();
+                _size -= field.first.size() + field.second.size() + ENTRY_OVERHEAD;
+                _entries.pop_back();
+            }
+        }
+
+        void DynamicTable::insert(HeaderField field){
+            std::size_t size = field.first.size() + field.second.size() + ENTRY_OVERHEAD;
+            // An entry larger than the table empties it, and is not inserted.
+            evict(size);
+            if(size <= _max_size){
+                _size += size;
+                _entries.push_front(std::move(field));
+            }
+        }
+
+        void DynamicTable::resize(std::size_t max_size){
+            _max_size = max_size;
+            evict(0);
+        }
+
+        std::size_t DynamicTable::find(const HeaderField& field, bool& exact) const{
+            std::size_t name = 0;
+            for(std::size_t i = 0; i < _entries.size(); ++i){
+                if(_entries[i].first == field.first){
+                    if(_entries[i].second == field.second){
+                        exact = true;
+                        return i+1;
+                    }
+                    if(name == 0){
+                        name = i+1;
+                    }
+                }
+            }
+            exact = false;
+            return name;
+        }
+
+        // Integers are encoded in the low prefix bits of the first byte,
+        // with any remainder in 7 bit groups, least significant group first.
+        static void encode_integer(std::string& out, std::uint64_t value, std::size_t prefix, std::uint8_t flags){
+            const std::uint64_t max = (1u << prefix) - 1;
+            if(value < max){
+                out.push_back(static_cast<char>(flags | value));
+                return;
+            }
+            out.push_back(static_cast<char>(flags | max));
+            value -= max;
+            while(value >= 0x80){
+                out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        static bool decode_integer(std::string_view::const_iterator& it, std::string_view::const_iterator end, std::size_t prefix, std::uint64_t& value){
+            if(it == end){
+                return false;
+            }
+            const std::uint64_t max = (1u << prefix) - 1;
+            value = static_cast<unsigned char>(*it++) & max;
+            if(value < max){
+                return true;
+            }
+            // Nothing that we decode needs more than 32 bits.
+            for(std::size_t shift = 0; it != end && shift <= 28; shift += 7){
+                unsigned char c = *it++;
+                value += static_cast<std::uint64_t>(c & 0x7f) << shift;
+                if(!(c & 0x80)){
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void encode_string(std::string& out, std::string_view str){
+            std::size_t huffman = huffman_size(str);
+            if(huffman < str.size()){
+                encode_integer(out, huffman, 7, 0x80);
+                huffman_encode(str, out);
+            } else {
+                encode_integer(out, str.size(), 7, 0);
+                out.append(str);
+            }
+        }
+
+        static bool decode_string(std::string_view::const_iterator& it, std::string_view::const_iterator end, std::string& str){
+            if(it == end){
+                return false;
+            }
+            bool huffman = static_cast<unsigned char>(*it) & 0x80;
+            std::uint64_t length;
+            if(!decode_integer(it, end, 7, length) || length > static_cast<std::uint64_t>(end - it)){
+                return false;
+            }
+            std::string_view raw(&*it, length);
+            it += length;
+            if(huffman){
+                return huffman_decode(raw, str);
+            }
+            str.assign(raw);
+            return true;
+        }
+
+        bool Decoder::decode(std::string_view block, std::vector<HeaderField>& out){
+            auto it = block.cbegin();
+            bool first = true;
+            while(it != block.cend()){
+                unsigned char c = *it;
+                std::uint64_t index;
+                if(c & 0x80){
+                    // Indexed header field.
+                    if(!decode_integer(it, block.cend(), 7, index) || index == 0){
+                        return false;
+                    }
+                    if(index <= STATIC_TABLE_LENGTH){
+                        auto& entry = static_table[index-1];
+                        out.emplace_back(std::string(entry.name), std::string(entry.value));
+                    } else if(index - STATIC_TABLE_LENGTH <= _table.length()){
+                        out.push_back(_table.at(index - STATIC_TABLE_LENGTH));
+                    } else {
+                        return false;
+                    }
+                } else if((c & 0xe0) == 0x20){
+                    // Dynamic table size updates are only allowed at the start of a block.
+                    if(!first || !decode_integer(it, block.cend(), 5, index) || index > _max_table_size){
+                        return false;
+                    }
+                    _table.resize(index);
+                    continue;
+                } else {
+                    // Literal header fields, 01 is added to the dynamic table, 0000 and 0001 are not.
+                    bool indexing = (c & 0xc0) == 0x40;
+                    HeaderField field;
+                    if(!decode_integer(it, block.cend(), indexing ? 6 : 4, index)){
+                        return false;
+                    }
+                    if(index == 0){
+                        if(!decode_string(it, block.cend(), field.first)){
+                            return false;
+                        }
+                    } else if(index <= STATIC_TABLE_LENGTH){
+                        field.first = static_table[index-1].name;
+                    } else if(index - STATIC_TABLE_LENGTH <= _table.length()){
+                        field.first = _table.at(index - STATIC_TABLE_LENGTH).first;
+                    } else {
+                        return false;
+                    }
+                    if(!decode_string(it, block.cend(), field.second)){
+                        return false;
+                    }
+                    if(indexing){
+                        _table.insert(field);
+                    }
+                    out.push_back(std::move(field));
+                }
+                first = false;
+            }
+            return true;
+        }
+
+        void Encoder::max_table_size(std::size_t size){
+            size = std::min(size, DEFAULT_TABLE_SIZE);
+            if(size != _table.max_size()){
+                _table.resize(size);
+                _size_update = true;
+            }
+        }
+
+        // Credentials are never added to a compression context.
+        static bool sensitive(const std::string& name){
+            return name == "authorization" || name == "proxy-authorization";
+        }
+
+        void Encoder::encode(const std::vector<HeaderField>& fields, std::string& out){
+            if(_size_update){
+                encode_integer(out, _table.max_size(), 5, 0x20);
+                _size_update = false;
+            }
+            for(auto& field: fields){
+                std::size_t name = 0;
+                std::size_t index = 0;
+                for(std::size_t i = 0; i < STATIC_TABLE_LENGTH; ++i){
+                    if(static_table[i].name == field.first){
+                        if(name == 0){
+                            name = i+1;
+                        }
+                        if(static_table[i].value == field.second){
+                            index = i+1;
+                            break;
+                        }
+                    }
+                }
+                if(index == 0){
+                    bool exact;
+                    std::size_t dynamic = _table.find(field, exact);
+                    if(exact){
+                        index = dynamic + STATIC_TABLE_LENGTH;
+                    } else if(name == 0 && dynamic != 0){
+                        name = dynamic + STATIC_TABLE_LENGTH;
+                    }
+                }
+                if(index != 0){
+                    encode_integer(out, index, 7, 0x80);
+                    continue;
+                }
+                std::size_t size = field.first.size() + field.second.size() + DynamicTable::ENTRY_OVERHEAD;
+                if(sensitive(field.first)){
+                    encode_integer(out, name, 4, 0x10);
+                } else if(size > _table.max_size()){
+                    encode_integer(out, name, 4, 0);
+                } else {
+                    encode_integer(out, name, 6, 0x40);
+                    _table.insert(field);
+                }
+                if(name == 0){
+                    encode_string(out, field.first);
+                }
+                encode_string(out, field.second);
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef HPACK_HPP
+#define HPACK_HPP
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+namespace http
+{
+    // HPACK header compression for HTTP/2 (RFC 7541).
+    namespace hpack
+    {
+        // Header field names are always lower case in HTTP/2.
+        typedef std::pair<std::string, std::string> HeaderField;
+
+        // The default SETTINGS_HEADER_TABLE_SIZE.
+        constexpr std::size_t DEFAULT_TABLE_SIZE = 4096;
+
+        // Huffman coding with the static code from RFC 7541 Appendix B.
+        // decode returns false if the input is not a valid Huffman encoded string.
+        std::size_t huffman_size(std::string_view in);
+        void huffman_encode(std::string_view in, std::string& out);
+        bool huffman_decode(std::string_view in, std::string& out);
+
+        // The dynamic table is a FIFO of header fields, the newest field has the lowest index.
+        // The size of an entry is the length of its name and value plus 32 bytes of overhead.
+        class DynamicTable
+        {
+            std::deque<HeaderField> _entries;
+            std::size_t _size = 0;
+            std::size_t _max_size = DEFAULT_TABLE_SIZE;
+
+            void evict(std::size_t size);
+
+        public:
+            static constexpr std::size_t ENTRY_OVERHEAD = 32;
+
+            void insert(HeaderField field);
+            void resize(std::size_t max_size);
+
+            // index is 1 based, the caller must check it against length().
+            const HeaderField& at(std::size_t index) const { return _entries[index-1]; }
+            std::size_t length() const { return _entries.size(); }
+            std::size_t size() const { return _size; }
+            std::size_t max_size() const { return _max_size; }
+
+            // Returns the 1 based index of an exact match, or of an entry with a matching name, or 0.
+            std::size_t find(const HeaderField& field, bool& exact) const;
+        };
+
+        // A decoder holds the dynamic table of one direction of a connection,
+        // so it must see every header block that the peer sends, in order.
+        class Decoder
+        {
+            DynamicTable _table;
+            // The table size that we have advertised in SETTINGS_HEADER_TABLE_SIZE.
+            std::size_t _max_table_size = DEFAULT_TABLE_SIZE;
+
+        public:
+            // Decode a complete header block, fields are appended to out.
+            // Returns false on a decoding error, which is a connection error of type COMPRESSION_ERROR.
+            bool decode(std::string_view block, std::vector<HeaderField>& out);
+            void max_table_size(std::size_t size) { _max_table_size = size; }
+            const DynamicTable& table() const { return _table; }
+        };
+
+        class Encoder
+        {
+            DynamicTable _table;
+            // Set when the table has been resized since the last header block,
+            // the resize must be signalled at the start of the next one.
+            bool _size_update = false;
+
+        public:
+            // Encode a complete header block, appending it to out.
+            void encode(const std::vector<HeaderField>& fields, std::string& out);
+            // Called with the peer's SETTINGS_HEADER_TABLE_SIZE, the table never grows past the default.
+            void max_table_size(std::size_t size);
+            const DynamicTable& table() const { return _table; }
+        };
+    }
+}
+#endif
@@ -0,0 +1,989 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include "http2-presentation.hpp"
+namespace http
+{
+    namespace h2_presentation
+    {
+        static const std::string_view PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        static const std::size_t FRAME_HEADER = 9;
+
+        // Frame flags.
+        static const std::uint8_t END_STREAM = 0x1;
+        static const std::uint8_t ACK = 0x1;
+        static const std::uint8_t END_HEADERS = 0x4;
+        static const std::uint8_t PADDED = 0x8;
+        static const std::uint8_t PRIORITY = 0x20;
+
+        // Setting identifiers.
+        static const std::uint16_t SETTINGS_HEADER_TABLE_SIZE = 0x1;
+        static const std::uint16_t SETTINGS_ENABLE_PUSH = 0x2;
+        static const std::uint16_t SETTINGS_MAX_CONCURRENT_STREAMS = 0x3;
+        static const std::uint16_t SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+        static const std::uint16_t SETTINGS_MAX_FRAME_SIZE = 0x5;
+        static const std::uint16_t SETTINGS_MAX_HEADER_LIST_SIZE = 0x6;
+
+        // The size of a header field as counted against SETTINGS_MAX_HEADER_LIST_SIZE (RFC 9113 6.5.2).
+        static const std::size_t HEADER_FIELD_OVERHEAD = 32;
+
+        static const std::int64_t MAX_WINDOW_SIZE = 0x7fffffff;
+
+        static std::uint32_t get32(std::string_view buf, std::size_t pos){
+            return static_cast<std::uint32_t>(static_cast<unsigned char>(buf[pos])) << 24
+                | static_cast<std::uint32_t>(static_cast<unsigned char>(buf[pos+1])) << 16
+                | static_cast<std::uint32_t>(static_cast<unsigned char>(buf[pos+2])) << 8
+                | static_cast<std::uint32_t>(static_cast<unsigned char>(buf[pos+3]));
+        }
+
+        static void put(std::string& buf, std::uint32_t value, std::size_t bytes){
+            while(bytes-- > 0){
+                buf.push_back(static_cast<char>(value >> (bytes*8)));
+            }
+        }
+
+        static void setting(std::string& buf, std::uint16_t id, std::uint32_t value){
+            put(buf, id, 2);
+            put(buf, value, 4);
+        }
+
+        static std::string window_increment(std::uint32_t increment){
+            std::string payload;
+            put(payload, increment, 4);
+            return payload;
+        }
+
+        // Conversions between HTTP/1.1 style header fields and HTTP/2 header field names.
+        static HttpHeaderField header_field(const std::string& upper){
+            if(upper == "CONTENT-TYPE"){
+                return HttpHeaderField::CONTENT_TYPE;
+            } else if(upper == "CONTENT-LENGTH"){
+                return HttpHeaderField::CONTENT_LENGTH;
+            } else if(upper == "ACCEPT"){
+                return HttpHeaderField::ACCEPT;
+            } else if(upper == "HOST"){
+                return HttpHeaderField::HOST;
+            } else if(upper == "TRANSFER-ENCODING"){
+                return HttpHeaderField::TRANSFER_ENCODING;
+            } else if(upper == "CONNECTION"){
+                return HttpHeaderField::CONNECTION;
+            } else if(upper == "UPGRADE"){
+                return HttpHeaderField::UPGRADE;
+            } else if(upper == "SEC-WEBSOCKET-KEY"){
+                return HttpHeaderField::SEC_WEBSOCKET_KEY;
+            } else if(upper == "SEC-WEBSOCKET-ACCEPT"){
+                return HttpHeaderField::SEC_WEBSOCKET_ACCEPT;
+            } else if(upper == "SEC-WEBSOCKET-VERSION"){
+                return HttpHeaderField::SEC_WEBSOCKET_VERSION;
+            } else if(upper == "SEC-WEBSOCKET-EXTENSIONS"){
+                return HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS;
+            }
+            return HttpHeaderField::UNKNOWN;
+        }
+
+        static std::string header_name(const HttpHeader& header){
+            switch(header.field_name)
+            {
+                case HttpHeaderField::CONTENT_TYPE:
+                    return "content-type";
+                case HttpHeaderField::CONTENT_LENGTH:
+                    return "content-length";
+                case HttpHeaderField::ACCEPT:
+                    return "accept";
+                case HttpHeaderField::SEC_WEBSOCKET_KEY:
+                    return "sec-websocket-key";
+                case HttpHeaderField::SEC_WEBSOCKET_ACCEPT:
+                    return "sec-websocket-accept";
+                case HttpHeaderField::SEC_WEBSOCKET_VERSION:
+                    return "sec-websocket-version";
+                case HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS:
+                    return "sec-websocket-extensions";
+                case HttpHeaderField::UNKNOWN:
+                {
+                    std::string name = header.buf;
+                    std::transform(name.cbegin(), name.cend(), name.begin(), [](unsigned char c){ return std::tolower(c); });
+                    return name;
+                }
+                default:
+                    // Host is sent as :authority, and connection specific headers are not allowed in HTTP/2.
+                    return std::string();
+            }
+        }
+
+        static HttpVerb verb(std::string_view method){
+            if(method == "GET"){
+                return HttpVerb::GET;
+            } else if(method == "POST"){
+                return HttpVerb::POST;
+            } else if(method == "PATCH"){
+                return HttpVerb::PATCH;
+            } else if(method == "PUT"){
+                return HttpVerb::PUT;
+            } else if(method == "TRACE"){
+                return HttpVerb::TRACE;
+            } else if(method == "DELETE"){
+                return HttpVerb::DELETE;
+            } else if(method == "CONNECT"){
+                return HttpVerb::CONNECT;
+            }
+            return HttpVerb::UNKNOWN;
+        }
+
+        static std::string_view method(HttpVerb verb){
+            switch(verb)
+            {
+                case HttpVerb::POST:
+                    return "POST";
+                case HttpVerb::PATCH:
+                    return "PATCH";
+                case HttpVerb::PUT:
+                    return "PUT";
+                case HttpVerb::TRACE:
+                    return "TRACE";
+                case HttpVerb::DELETE:
+                    return "DELETE";
+                case HttpVerb::CONNECT:
+                    return "CONNECT";
+                default:
+                    return "GET";
+            }
+        }
+
+        // Append a regular header field, returns false if the field is not allowed in HTTP/2.
+        static bool header(std::vector<HttpHeader>& headers, const hpack::HeaderField& field){
+            HttpHeader header{};
+            header.buf = field.first;
+            for(auto& c: header.buf){
+                if(std::isupper(static_cast<unsigned char>(c))){
+                    return false;
+                }
+                c = std::toupper(static_cast<unsigned char>(c));
+            }
+            header.field_name = header_field(header.buf);
+            if(header.field_name == HttpHeaderField::CONNECTION || header.field_name == HttpHeaderField::TRANSFER_ENCODING || header.field_name == HttpHeaderField::UPGRADE){
+                return false;
+            }
+            header.field_value = field.second;
+            header.field_name_found = true;
+            header.field_delimiter_found = true;
+            header.field_value_started = true;
+            header.field_value_ended = true;
+            header.header_complete = true;
+            headers.push_back(std::move(header));
+            return true;
+        }
+
+        static void end_of_headers(std::vector<HttpHeader>& headers){
+            HttpHeader header{};
+            header.field_name = HttpHeaderField::END_OF_HEADERS;
+            header.header_complete = true;
+            headers.push_back(std::move(header));
+        }
+
+        static bool to_request(const std::vector<hpack::HeaderField>& fields, HttpRequest& req){
+            req.version = HttpVersion::V2;
+            bool regular = false;
+            for(auto& field: fields){
+                if(!field.first.empty() && field.first[0] == ':'){
+                    // Pseudo-headers must come before the regular header fields.
+                    if(regular){
+                        return false;
+                    }
+                    if(field.first == ":method"){
+                        req.verb_buf = field.second;
+                        req.verb = verb(field.second);
+                    } else if(field.first == ":path"){
+                        req.route = field.second;
+                    } else if(field.first == ":authority"){
+                        header(req.headers, hpack::HeaderField("host", field.second));
+                    } else if(field.first != ":scheme"){
+                        return false;
+                    }
+                } else {
+                    regular = true;
+                    if(!header(req.headers, field)){
+                        return false;
+                    }
+                }
+            }
+            if(req.verb_buf.empty() || (req.route.empty() && req.verb != HttpVerb::CONNECT)){
+                return false;
+            }
+            end_of_headers(req.headers);
+            req.num_headers = req.next_header = req.headers.size();
+            req.chunks.resize(1);
+            req.num_chunks = 1;
+            req.verb_started = req.verb_finished = true;
+            req.route_started = req.route_finished = true;
+            req.query_pos = req.route.find('?');
+            req.query_found = req.query_pos != std::string::npos;
+            req.version_finished = true;
+            req.not_chunked_transfer = true;
+            req.http_request_line_complete = true;
+            return true;
+        }
+
+        static bool to_response(const std::vector<hpack::HeaderField>& fields, HttpResponse& res){
+            res.version = HttpVersion::V2;
+            bool regular = false;
+            for(auto& field: fields){
+                if(!field.first.empty() && field.first[0] == ':'){
+                    if(regular || field.first != ":status"){
+                        return false;
+                    }
+                    res.status_buf = field.second;
+                    std::size_t code = 0;
+                    auto result = std::from_chars(field.second.data(), field.second.data() + field.second.size(), code);
+                    if(result.ec != std::errc() || status_line(code).empty()){
+                        return false;
+                    }
+                    res.status = static_cast<HttpStatus>(code);
+                } else {
+                    regular = true;
+                    if(!header(res.headers, field)){
+                        return false;
+                    }
+                }
+            }
+            if(res.status_buf.empty()){
+                return false;
+            }
+            end_of_headers(res.headers);
+            res.num_headers = res.next_header = res.headers.size();
+            res.chunks.resize(1);
+            res.num_chunks = 1;
+            res.version_finished = true;
+            res.status_started = res.status_finished = true;
+            res.status_line_finished = true;
+            res.not_chunked_transfer = true;
+            return true;
+        }
+
+        // The body is complete, mark its chunk the same way as a parsed Content-Length body.
+        static void finish(HttpChunk& chunk){
+            chunk.chunk_size = HttpBigNum{chunk.chunk_data.size()};
+            chunk.received_bytes = chunk.chunk_size;
+            chunk.chunk_size_started = chunk.chunk_size_found = true;
+            chunk.chunk_body_start = chunk.chunk_body_finished = true;
+            chunk.chunk_complete = true;
+        }
+
+        template<class Message>
+        static void finish(Message& msg){
+            if(!msg.chunks.empty()){
+                finish(msg.chunks.front());
+            }
+            msg.next_chunk = msg.num_chunks;
+        }
+
+        static std::string body(const std::vector<HttpChunk>& chunks){
+            std::string body;
+            for(auto& chunk: chunks){
+                body += chunk.chunk_data;
+            }
+            return body;
+        }
+
+        void Http2Presentation::frame(FrameType type, std::uint8_t flags, std::uint32_t id, std::string_view payload){
+            put(_out, payload.size(), 3);
+            _out.push_back(static_cast<char>(type));
+            _out.push_back(static_cast<char>(flags));
+            put(_out, id & 0x7fffffff, 4);
+            _out.append(payload);
+        }
+
+        void Http2Presentation::preface(){
+            std::string settings;
+            if(_role == Role::CLIENT){
+                _out.append(PREFACE);
+                _next_stream_id = 1;
+                setting(settings, SETTINGS_ENABLE_PUSH, 0);
+            } else {
+                _next_stream_id = 2;
+                setting(settings, SETTINGS_MAX_CONCURRENT_STREAMS, MAX_CONCURRENT_STREAMS);
+            }
+            setting(settings, SETTINGS_INITIAL_WINDOW_SIZE, WINDOW_SIZE);
+            setting(settings, SETTINGS_MAX_HEADER_LIST_SIZE, MAX_HEADER_LIST_SIZE);
+            frame(FrameType::SETTINGS, 0, 0, settings);
+            frame(FrameType::WINDOW_UPDATE, 0, 0, window_increment(CONNECTION_WINDOW_SIZE - DEFAULT_WINDOW_SIZE));
+        }
+
+        void Http2Presentation::connection_error(ErrorCode code){
+            if(_error != ErrorCode::NO_ERROR){
+                return;
+            }
+            _error = code;
+            std::string payload;
+            put(payload, _last_stream_id, 4);
+            put(payload, static_cast<std::uint32_t>(code), 4);
+            frame(FrameType::GOAWAY, 0, 0, payload);
+            _goaway = true;
+            auto& streams = std::get<Http2Streams>(*this);
+            if(_role == Role::CLIENT){
+                for(auto& [id, stream]: streams){
+                    stream.error = code;
+                    _ready.push_back(id);
+                }
+            } else {
+                streams.clear();
+            }
+        }
+
+        void Http2Presentation::reset(std::uint32_t id, ErrorCode code){
+            std::string payload;
+            put(payload, static_cast<std::uint32_t>(code), 4);
+            frame(FrameType::RST_STREAM, 0, id, payload);
+            auto& streams = std::get<Http2Streams>(*this);
+            auto it = streams.find(id);
+            if(it == streams.end()){
+                return;
+            }
+            if(_role == Role::CLIENT){
+                it->second.error = code;
+                it->second.local_closed = it->second.remote_closed = true;
+                it->second.pending.clear();
+                _ready.push_back(id);
+            } else if(id == _dispatching){
+                it->second.local_closed = it->second.remote_closed = true;
+                it->second.pending.clear();
+            } else {
+                streams.erase(it);
+            }
+        }
+
+        void Http2Presentation::goaway(ErrorCode code){
+            auto lk = lock();
+            if(_goaway){
+                return;
+            }
+            _goaway = true;
+            std::string payload;
+            put(payload, _last_stream_id, 4);
+            put(payload, static_cast<std::uint32_t>(code), 4);
+            frame(FrameType::GOAWAY, 0, 0, payload);
+        }
+
+        void Http2Presentation::send_headers(Http2Stream& stream, const std::vector<hpack::HeaderField>& fields, bool end_stream){
+            std::string block;
+            _encoder.encode(fields, block);
+            std::size_t offset = 0;
+            FrameType type = FrameType::HEADERS;
+            do{
+                std::size_t len = std::min<std::size_t>(_max_frame_size, block.size() - offset);
+                std::uint8_t flags = 0;
+                if(offset + len == block.size()){
+                    flags |= END_HEADERS;
+                }
+                if(type == FrameType::HEADERS && end_stream){
+                    flags |= END_STREAM;
+                }
+                frame(type, flags, stream.id, std::string_view(block).substr(offset, len));
+                offset += len;
+                type = FrameType::CONTINUATION;
+            } while(offset < block.size());
+            stream.local_open = true;
+            stream.local_closed = end_stream;
+        }
+
+        void Http2Presentation::send_data(Http2Stream& stream){
+            while(stream.local_open && !stream.local_closed){
+                std::int64_t window = std::min(_send_window, stream.send_window);
+                std::size_t len = std::min<std::size_t>(stream.pending.size() - stream.sent, _max_frame_size);
+                if(window <= 0 && len > 0){
+                    return;
+                }
+                len = std::min<std::size_t>(len, window);
+                bool last = stream.sent + len == stream.pending.size();
+                frame(FrameType::DATA, last ? END_STREAM : 0, stream.id, std::string_view(stream.pending).substr(stream.sent, len));
+                _send_window -= len;
+                stream.send_window -= len;
+                stream.sent += len;
+                if(last){
+                    stream.local_closed = true;
+                    stream.pending.clear();
+                    stream.sent = 0;
+                }
+            }
+        }
+
+        void Http2Presentation::open_streams(){
+            auto& streams = std::get<Http2Streams>(*this);
+            std::size_t open = std::count_if(streams.cbegin(), streams.cend(), [](auto& entry){ return entry.second.local_open; });
+            for(auto& [id, stream]: streams){
+                if(open >= _max_streams || _goaway){
+                    return;
+                }
+                if(stream.local_open){
+                    continue;
+                }
+                auto& req = stream.request;
+                std::vector<hpack::HeaderField> fields;
+                fields.emplace_back(":method", method(req.verb));
+                fields.emplace_back(":scheme", "http");
+                auto host = std::find_if(req.headers.cbegin(), req.headers.cend(), [](auto& header){
+                    return header.field_name == HttpHeaderField::HOST;
+                });
+                fields.emplace_back(":authority", host != req.headers.cend() ? host->field_value : "localhost");
+                fields.emplace_back(":path", req.route.empty() ? "/" : req.route);
+                for(auto& header: req.headers){
+                    std::string name = header_name(header);
+                    if(!name.empty()){
+                        fields.emplace_back(std::move(name), header.field_value);
+                    }
+                }
+                stream.pending = body(req.chunks);
+                send_headers(stream, fields, stream.pending.empty());
+                send_data(stream);
+                ++open;
+            }
+        }
+
+        bool Http2Presentation::respond(std::uint32_t id, const http::HttpResponse& res){
+            auto lk = lock();
+            auto& streams = std::get<Http2Streams>(*this);
+            auto it = streams.find(id);
+            if(it == streams.end() || it->second.local_open){
+                return false;
+            }
+            auto& stream = it->second;
+            stream.response = res;
+            std::vector<hpack::HeaderField> fields;
+            fields.emplace_back(":status", std::to_string(static_cast<std::size_t>(res.status)));
+            for(auto& header: res.headers){
+                std::string name = header_name(header);
+                if(!name.empty()){
+                    fields.emplace_back(std::move(name), header.field_value);
+                }
+            }
+            stream.pending = body(res.chunks);
+            send_headers(stream, fields, stream.pending.empty());
+            send_data(stream);
+            if(stream.local_closed && stream.remote_closed && id != _dispatching){
+                streams.erase(it);
+            }
+            return true;
+        }
+
+        std::uint32_t Http2Presentation::request(const http::HttpRequest& req, handler fn){
+            auto lk = lock();
+            if(_goaway){
+                return 0;
+            }
+            std::uint32_t id = _next_stream_id;
+            _next_stream_id += 2;
+            Http2Stream stream{};
+            stream.id = id;
+            stream.request = req;
+            stream.send_window = _initial_window;
+            stream.recv_window = WINDOW_SIZE;
+            stream.handler = std::move(fn);
+            std::get<Http2Streams>(*this).emplace(id, std::move(stream));
+            open_streams();
+            return id;
+        }
+
+        void Http2Presentation::on_headers(std::uint32_t id, bool end_stream){
+            std::vector<hpack::HeaderField> fields;
+            // The block has to be decoded even if the stream is refused, to keep the dynamic table in sync.
+            bool decoded = _decoder.decode(_header_block, fields);
+            _header_block.clear();
+            if(!decoded){
+                connection_error(ErrorCode::COMPRESSION_ERROR);
+                return;
+            }
+            // A small block can still decode to a large list through the dynamic table.
+            std::size_t list_size = 0;
+            for(auto& field: fields){
+                list_size += field.first.size() + field.second.size() + HEADER_FIELD_OVERHEAD;
+            }
+            if(list_size > MAX_HEADER_LIST_SIZE){
+                connection_error(ErrorCode::ENHANCE_YOUR_CALM);
+                return;
+            }
+            auto& streams = std::get<Http2Streams>(*this);
+            auto it = streams.find(id);
+            if(_role == Role::SERVER && it == streams.end()){
+                if(id % 2 == 0 || id <= _last_stream_id){
+                    connection_error(ErrorCode::PROTOCOL_ERROR);
+                    return;
+                }
+                _last_stream_id = id;
+                if(_goaway){
+                    return;
+                }
+                if(streams.size() >= MAX_CONCURRENT_STREAMS){
+                    reset(id, ErrorCode::REFUSED_STREAM);
+                    return;
+                }
+                Http2Stream stream{};
+                stream.id = id;
+                stream.send_window = _initial_window;
+                stream.recv_window = WINDOW_SIZE;
+                if(!to_request(fields, stream.request)){
+                    reset(id, ErrorCode::PROTOCOL_ERROR);
+                    return;
+                }
+                stream.headers_received = true;
+                it = streams.emplace(id, std::move(stream)).first;
+            } else if(it == streams.end()){
+                // A response to a stream that we have already given up on.
+                return;
+            } else if(it->second.remote_closed){
+                reset(id, ErrorCode::STREAM_CLOSED);
+                return;
+            } else if(!it->second.headers_received && _role == Role::CLIENT){
+                auto& res = it->second.response;
+                res = HttpResponse{};
+                if(!to_response(fields, res)){
+                    reset(id, ErrorCode::PROTOCOL_ERROR);
+                    return;
+                }
+                // Informational responses are followed by the final response.
+                if(static_cast<std::size_t>(res.status) < 200){
+                    return;
+                }
+                it->second.headers_received = true;
+            } else if(!end_stream){
+                // Trailers must end the stream, and they are not kept.
+                reset(id, ErrorCode::PROTOCOL_ERROR);
+                return;
+            }
+            if(end_stream){
+                auto& stream = it->second;
+                stream.remote_closed = true;
+                if(_role == Role::SERVER){
+                    finish(stream.request);
+                } else {
+                    finish(stream.response);
+                }
+                _ready.push_back(id);
+            }
+        }
+
+        void Http2Presentation::on_data(std::uint32_t id, std::uint8_t flags, std::string_view payload){
+            if(id == 0){
+                connection_error(ErrorCode::PROTOCOL_ERROR);
+                return;
+            }
+            // Padding counts towards flow control.
+            std::size_t len = payload.size();
+            _recv_window -= len;
+            if(_recv_window < 0){
+                connection_error(ErrorCode::FLOW_CONTROL_ERROR);
+                return;
+            }
+            if(_recv_window < CONNECTION_WINDOW_SIZE/2){
+                frame(FrameType::WINDOW_UPDATE, 0, 0, window_increment(CONNECTION_WINDOW_SIZE - _recv_window));
+                _recv_window = CONNECTION_WINDOW_SIZE;
+            }
+            if(flags & PADDED){
+                std::size_t padding = payload.empty() ? len : static_cast<unsigned char>(payload[0]) + 1;
+                if(padding > len){
+                    connection_error(ErrorCode::PROTOCOL_ERROR);
+                    return;
+                }
+                payload = payload.substr(1, len - padding);
+            }
+            auto& streams = std::get<Http2Streams>(*this);
+            auto it = streams.find(id);
+            // DATA on a stream that has never been opened, by either side, is a connection error (RFC 9113 5.1).
+            bool local = (id % 2 == 1) == (_role == Role::CLIENT);
+            if(it == streams.end() && (local ? id >= _next_stream_id : id > _last_stream_id)){
+                connection_error(ErrorCode::PROTOCOL_ERROR);
+                return;
+            }
+            if(it == streams.end() || !it->second.headers_received || it->second.remote_closed){
+                reset(id, ErrorCode::STREAM_CLOSED);
+                return;
+            }
+            auto& stream = it->second;
+            stream.recv_window -= len;
+            if(stream.recv_window < 0){
+                reset(id, ErrorCode::FLOW_CONTROL_ERROR);
+                return;
+            }
+            auto& chunks = _role == Role::SERVER ? stream.request.chunks : stream.response.chunks;
+            chunks.front().chunk_data.append(payload);
+            if(flags & END_STREAM){
+                stream.remote_closed = true;
+                if(_role == Role::SERVER){
+                    finish(stream.request);
+                } else {
+                    finish(stream.response);
+                }
+                _ready.push_back(id);
+            } else if(stream.recv_window < WINDOW_SIZE/2){
+                frame(FrameType::WINDOW_UPDATE, 0, id, window_increment(WINDOW_SIZE - stream.recv_window));
+                stream.recv_window = WINDOW_SIZE;
+            }
+        }
+
+        void Http2Presentation::on_settings(std::uint8_t flags, std::string_view payload){
+            if(flags & ACK){
+                if(!payload.empty()){
+                    connection_error(ErrorCode::FRAME_SIZE_ERROR);
+                }
+                return;
+            }
+            if(payload.size() % 6 != 0){
+                connection_error(ErrorCode::FRAME_SIZE_ERROR);
+                return;
+            }
+            auto& streams = std::get<Http2Streams>(*this);
+            for(std::size_t pos = 0; pos < payload.size(); pos += 6){
+                std::uint16_t id = static_cast<unsigned char>(payload[pos]) << 8 | static_cast<unsigned char>(payload[pos+1]);
+                std::uint32_t value = get32(payload, pos+2);
+                switch(id)
+                {
+                    case SETTINGS_HEADER_TABLE_SIZE:
+                        _encoder.max_table_size(value);
+                        break;
+                    case SETTINGS_ENABLE_PUSH:
+                        if(value > 1){
+                            connection_error(ErrorCode::PROTOCOL_ERROR);
+                            return;
+                        }
+                        break;
+                    case SETTINGS_MAX_CONCURRENT_STREAMS:
+                        _max_streams = value;
+                        break;
+                    case SETTINGS_INITIAL_WINDOW_SIZE:
+                    {
+                        if(value > MAX_WINDOW_SIZE){
+                            connection_error(ErrorCode::FLOW_CONTROL_ERROR);
+                            return;
+                        }
+                        // The change applies to the windows of every open stream.
+                        std::int64_t delta = static_cast<std::int64_t>(value) - _initial_window;
+                        for(auto& entry: streams){
+                            entry.second.send_window += delta;
+                        }
+                        _initial_window = value;
+                        break;
+                    }
+                    case SETTINGS_MAX_FRAME_SIZE:
+                        if(value < DEFAULT_MAX_FRAME_SIZE || value > 0xffffff){
+                            connection_error(ErrorCode::PROTOCOL_ERROR);
+                            return;
+                        }
+                        _max_frame_size = value;
+                        break;
+                    default:
+                        // Unknown settings are ignored.
+                        break;
+                }
+            }
+            frame(FrameType::SETTINGS, ACK, 0, std::string_view());
+            for(auto& entry: streams){
+                send_data(entry.second);
+            }
+            if(_role == Role::CLIENT){
+                open_streams();
+            }
+        }
+
+        void Http2Presentation::on_window_update(std::uint32_t id, std::string_view payload){
+            if(payload.size() != 4){
+                connection_error(ErrorCode::FRAME_SIZE_ERROR);
+                return;
+            }
+            std::uint32_t increment = get32(payload, 0) & 0x7fffffff;
+            auto& streams = std::get<Http2Streams>(*this);
+            if(id == 0){
+                if(increment == 0 || _send_window + increment > MAX_WINDOW_SIZE){
+                    connection_error(increment == 0 ? ErrorCode::PROTOCOL_ERROR : ErrorCode::FLOW_CONTROL_ERROR);
+                    return;
+                }
+                _send_window += increment;
+                for(auto& entry: streams){
+                    send_data(entry.second);
+                }
+                return;
+            }
+            auto it = streams.find(id);
+            if(it == streams.end()){
+                return;
+            }
+            if(increment == 0 || it->second.send_window + increment > MAX_WINDOW_SIZE){
+                reset(id, increment == 0 ? ErrorCode::PROTOCOL_ERROR : ErrorCode::FLOW_CONTROL_ERROR);
+                return;
+            }
+            it->second.send_window += increment;
+            send_data(it->second);
+        }
+
+        void Http2Presentation::on_frame(FrameType type, std::uint8_t flags, std::uint32_t id, std::string_view payload){
+            // A header block must not be interleaved with any other frame.
+            if(_continuation != 0 && (type != FrameType::CONTINUATION || id != _continuation)){
+                connection_error(ErrorCode::PROTOCOL_ERROR);
+                return;
+            }
+            auto& streams = std::get<Http2Streams>(*this);
+            switch(type)
+            {
+                case FrameType::DATA:
+                    on_data(id, flags, payload);
+                    break;
+                case FrameType::HEADERS:
+                {
+                    std::size_t offset = 0;
+                    std::size_t padding = 0;
+                    if(flags & PADDED){
+                        if(payload.empty()){
+                            connection_error(ErrorCode::PROTOCOL_ERROR);
+                            return;
+                        }
+                        padding = static_cast<unsigned char>(payload[0]);
+                        offset = 1;
+                    }
+                    if(flags & PRIORITY){
+                        offset += 5;
+                    }
+                    if(id == 0 || offset + padding > payload.size()){
+                        connection_error(ErrorCode::PROTOCOL_ERROR);
+                        return;
+                    }
+                    if(payload.size() - offset - padding > MAX_HEADER_LIST_SIZE){
+                        connection_error(ErrorCode::ENHANCE_YOUR_CALM);
+                        return;
+                    }
+                    _header_block.assign(payload.substr(offset, payload.size() - offset - padding));
+                    if(flags & END_HEADERS){
+                        on_headers(id, flags & END_STREAM);
+                    } else {
+                        _continuation = id;
+                        _continuation_end_stream = flags & END_STREAM;
+                    }
+                    break;
+                }
+                case FrameType::CONTINUATION:
+                    if(_continuation == 0){
+                        connection_error(ErrorCode::PROTOCOL_ERROR);
+                        return;
+                    }
+                    if(_header_block.size() + payload.size() > MAX_HEADER_LIST_SIZE){
+                        connection_error(ErrorCode::ENHANCE_YOUR_CALM);
+                        return;
+                    }
+                    _header_block.append(payload);
+                    if(flags & END_HEADERS){
+                        _continuation = 0;
+                        on_headers(id, _continuation_end_stream);
+                    }
+                    break;
+                case FrameType::PRIORITY:
+                    // Streams are not prioritized.
+                    if(id == 0){
+                        connection_error(ErrorCode::PROTOCOL_ERROR);
+                        return;
+                    }
+                    if(payload.size() != 5){
+                        reset(id, ErrorCode::FRAME_SIZE_ERROR);
+                    }
+                    break;
+                case FrameType::RST_STREAM:
+                {
+                    if(id == 0 || payload.size() != 4){
+                        connection_error(id == 0 ? ErrorCode::PROTOCOL_ERROR : ErrorCode::FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    auto it = streams.find(id);
+                    if(it == streams.end()){
+                        break;
+                    }
+                    if(_role == Role::CLIENT){
+                        it->second.error = static_cast<ErrorCode>(get32(payload, 0));
+                        it->second.local_closed = it->second.remote_closed = true;
+                        _ready.push_back(id);
+                    } else {
+                        streams.erase(it);
+                    }
+                    break;
+                }
+                case FrameType::SETTINGS:
+                    if(id != 0){
+                        connection_error(ErrorCode::PROTOCOL_ERROR);
+                        return;
+                    }
+                    on_settings(flags, payload);
+                    break;
+                case FrameType::PUSH_PROMISE:
+                    // Clients disable server push, and servers never receive it.
+                    connection_error(ErrorCode::PROTOCOL_ERROR);
+                    break;
+                case FrameType::PING:
+                    if(id != 0 || payload.size() != 8){
+                        connection_error(id != 0 ? ErrorCode::PROTOCOL_ERROR : ErrorCode::FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    if(!(flags & ACK)){
+                        frame(FrameType::PING, ACK, 0, payload);
+                    }
+                    break;
+                case FrameType::GOAWAY:
+                {
+                    if(id != 0 || payload.size() < 8){
+                        connection_error(ErrorCode::PROTOCOL_ERROR);
+                        return;
+                    }
+                    _goaway = true;
+                    // Streams above the last stream id were never processed, and are safe to retry.
+                    std::uint32_t last = get32(payload, 0) & 0x7fffffff;
+                    if(_role == Role::CLIENT){
+                        for(auto it = streams.upper_bound(last); it != streams.end(); ++it){
+                            it->second.error = ErrorCode::REFUSED_STREAM;
+                            _ready.push_back(it->first);
+                        }
+                    }
+                    break;
+                }
+                case FrameType::WINDOW_UPDATE:
+                    on_window_update(id, payload);
+                    break;
+                default:
+                    // Unknown frame types are ignored.
+                    break;
+            }
+        }
+
+        void Http2Presentation::receive(){
+            {
+                auto lk = session->lock();
+                char buf[4096];
+                std::streamsize len;
+                while((len = session->rbuf.rdbuf()->sgetn(buf, sizeof(buf))) > 0){
+                    _in.append(buf, len);
+                }
+            }
+            std::size_t pos = 0;
+            if(_role == Role::SERVER && !_preface_received){
+                std::size_t len = std::min(_in.size(), PREFACE.size());
+                if(std::string_view(_in).substr(0, len) != PREFACE.substr(0, len)){
+                    connection_error(ErrorCode::PROTOCOL_ERROR);
+                } else if(len == PREFACE.size()){
+                    _preface_received = true;
+                    pos = len;
+                }
+            }
+            while((_preface_received || _role == Role::CLIENT) && _error == ErrorCode::NO_ERROR && _in.size() - pos >= FRAME_HEADER){
+                std::string_view header(_in.data() + pos, FRAME_HEADER);
+                std::size_t len = get32(header, 0) >> 8;
+                if(len > DEFAULT_MAX_FRAME_SIZE){
+                    connection_error(ErrorCode::FRAME_SIZE_ERROR);
+                    break;
+                }
+                if(_in.size() - pos - FRAME_HEADER < len){
+                    break;
+                }
+                on_frame(static_cast<FrameType>(header[3]), header[4], get32(header, 5) & 0x7fffffff,
+                    std::string_view(_in.data() + pos + FRAME_HEADER, len));
+                pos += FRAME_HEADER + len;
+            }
+            if(_error != ErrorCode::NO_ERROR){
+                _in.clear();
+            } else {
+                _in.erase(0, pos);
+            }
+            if(_role == Role::SERVER){
+                // Streams that were answered before their request was complete are done once it is.
+                auto& streams = std::get<Http2Streams>(*this);
+                for(auto it = streams.begin(); it != streams.end();){
+                    if(it->second.local_closed && it->second.remote_closed){
+                        it = streams.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+        }
+
+        bool Http2Presentation::flush(){
+            if(_out.empty()){
+                return false;
+            }
+            {
+                auto lk = session->lock();
+                session->wbuf.rdbuf()->sputn(_out.data(), _out.size());
+            }
+            _out.clear();
+            return true;
+        }
+
+        void Http2Presentation::read(){
+            std::vector<std::uint32_t> ready;
+            {
+                auto lk = lock();
+                receive();
+                ready.swap(_ready);
+            }
+            auto& streams = std::get<Http2Streams>(*this);
+            for(auto id: ready){
+                Http2Stream* stream;
+                {
+                    auto lk = lock();
+                    auto it = streams.find(id);
+                    if(it == streams.end()){
+                        continue;
+                    }
+                    stream = &it->second;
+                    if(_role == Role::SERVER){
+                        _dispatching = id;
+                    }
+                }
+                if(_role == Role::SERVER){
+                    if(on_request){
+                        on_request(*stream);
+                    }
+                    auto lk = lock();
+                    _dispatching = 0;
+                    // The handler may have answered the stream in full, or it may have been reset.
+                    auto it = streams.find(id);
+                    if(it != streams.end() && it->second.local_closed && it->second.remote_closed){
+                        streams.erase(it);
+                    }
+                    continue;
+                }
+                if(stream->handler){
+                    stream->handler(*stream);
+                }
+                auto lk = lock();
+                // The response is complete, anything that we still had to send is no longer wanted.
+                if(!stream->local_closed){
+                    reset(id, ErrorCode::CANCEL);
+                }
+                streams.erase(id);
+                open_streams();
+            }
+            auto lk = lock();
+            if(flush()){
+                session->write();
+            }
+        }
+
+        void Http2Presentation::async_read(std::function<void(std::error_code ec)> cb){
+            session->async_read([&, cb](std::error_code ec){
+                if(!ec){
+                    read();
+                }
+                cb(ec);
+            });
+        }
+
+        void Http2Presentation::write(){
+            auto lk = lock();
+            flush();
+            session->write();
+        }
+
+        void Http2Presentation::async_write(std::function<void(std::error_code ec)> cb){
+            auto lk = lock();
+            flush();
+            session->async_write(cb);
+        }
+    }
+}
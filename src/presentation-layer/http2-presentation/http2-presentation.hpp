@@ -0,0 +1,201 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef HTTP2_PRESENTATION_HPP
+#define HTTP2_PRESENTATION_HPP
+#include <cstdint>
+#include <map>
+#include "hpack.hpp"
+#include "../http-presentation/http-requests.hpp"
+#include "../presentation.hpp"
+namespace http
+{
+    namespace h2_presentation
+    {
+        enum class FrameType: std::uint8_t
+        {
+            DATA = 0x0,
+            HEADERS = 0x1,
+            PRIORITY = 0x2,
+            RST_STREAM = 0x3,
+            SETTINGS = 0x4,
+            PUSH_PROMISE = 0x5,
+            PING = 0x6,
+            GOAWAY = 0x7,
+            WINDOW_UPDATE = 0x8,
+            CONTINUATION = 0x9
+        };
+
+        enum class ErrorCode: std::uint32_t
+        {
+            NO_ERROR = 0x0,
+            PROTOCOL_ERROR = 0x1,
+            INTERNAL_ERROR = 0x2,
+            FLOW_CONTROL_ERROR = 0x3,
+            SETTINGS_TIMEOUT = 0x4,
+            STREAM_CLOSED = 0x5,
+            FRAME_SIZE_ERROR = 0x6,
+            REFUSED_STREAM = 0x7,
+            CANCEL = 0x8,
+            COMPRESSION_ERROR = 0x9,
+            CONNECT_ERROR = 0xa,
+            ENHANCE_YOUR_CALM = 0xb,
+            INADEQUATE_SECURITY = 0xc,
+            HTTP_1_1_REQUIRED = 0xd
+        };
+
+        // Every stream carries a single request and its response.
+        // Bodies are collected into a single chunk, and the parsing flags are set
+        // the same way as the HTTP/1.1 parser sets them once a message is complete.
+        struct Http2Stream
+        {
+            std::uint32_t id;
+            http::HttpRequest request;
+            http::HttpResponse response;
+
+            // Flow control windows, for the data that we may send and the data that the peer may send.
+            std::int64_t send_window;
+            std::int64_t recv_window;
+            // Body bytes that are waiting for flow control credit.
+            std::string pending;
+            std::size_t sent;
+
+            bool headers_received;
+            // The peer has sent END_STREAM.
+            bool remote_closed;
+            // Our headers have been queued, and END_STREAM has been queued.
+            bool local_open;
+            bool local_closed;
+            // Set if the stream was reset by either side.
+            ErrorCode error;
+
+            // Client streams are completed through this handler.
+            std::function<void(Http2Stream& stream)> handler;
+        };
+        typedef std::map<std::uint32_t, Http2Stream> Http2Streams;
+        typedef presentation::Presentation<Http2Streams> Presentation;
+        typedef presentation::Presentations<Http2Streams> Http2Presentations;
+
+        /*
+        *  HTTP/2 multiplexes many concurrent streams over a single session.
+        *  Connections start with prior knowledge (h2c without an Upgrade), which suits local Unix sockets.
+        *
+        *  Servers get every complete request through on_request, and answer it with respond().
+        *  Clients start requests with request(), and the handler is called with the stream once its response is complete.
+        *  Both of these queue frames, write() sends them.
+        *  read() handles every complete frame in the session read buffer, and sends anything that the peer is owed
+        *  (SETTINGS and PING acknowledgements, WINDOW_UPDATEs, and DATA that was waiting for a WINDOW_UPDATE).
+        *  Handlers are called from read() without the presentation lock held.
+        *
+        *  Connection errors send a GOAWAY, after which nothing more is read; error() returns the cause.
+        */
+        class Http2Presentation: public Presentation
+        {
+        public:
+            enum class Role
+            {
+                SERVER,
+                CLIENT
+            };
+            typedef std::function<void(Http2Stream& stream)> handler;
+
+            static constexpr std::uint32_t DEFAULT_WINDOW_SIZE = 65535;
+            static constexpr std::uint32_t DEFAULT_MAX_FRAME_SIZE = 16384;
+            // The stream and connection windows that we advertise.
+            static constexpr std::uint32_t WINDOW_SIZE = 1 << 20;
+            static constexpr std::uint32_t CONNECTION_WINDOW_SIZE = 1 << 24;
+            static constexpr std::uint32_t MAX_CONCURRENT_STREAMS = 128;
+            // The largest header list that we advertise and accept, both as a header block and once decoded.
+            static constexpr std::uint32_t MAX_HEADER_LIST_SIZE = 1 << 16;
+
+        private:
+            Role _role;
+            hpack::Encoder _encoder;
+            hpack::Decoder _decoder;
+
+            // Bytes that have been read from the session but do not make up a complete frame yet.
+            std::string _in;
+            // Frames waiting to be written to the session.
+            std::string _out;
+            bool _preface_received = false;
+
+            // The peer's settings.
+            std::uint32_t _max_frame_size = DEFAULT_MAX_FRAME_SIZE;
+            std::uint32_t _initial_window = DEFAULT_WINDOW_SIZE;
+            // Until the peer's SETTINGS arrive, clients assume the smallest limit that RFC 9113 recommends.
+            std::uint32_t _max_streams = 100;
+
+            // Connection flow control windows.
+            std::int64_t _send_window = DEFAULT_WINDOW_SIZE;
+            std::int64_t _recv_window = CONNECTION_WINDOW_SIZE;
+
+            std::uint32_t _last_stream_id = 0;
+            std::uint32_t _next_stream_id = 1;
+
+            // A header block that is being continued with CONTINUATION frames.
+            std::uint32_t _continuation = 0;
+            bool _continuation_end_stream = false;
+            // Never grows past MAX_HEADER_LIST_SIZE, a longer block is a connection error.
+            std::string _header_block;
+
+            bool _goaway = false;
+            ErrorCode _error = ErrorCode::NO_ERROR;
+            // Streams whose messages are complete, or that have failed, waiting for their handlers.
+            std::vector<std::uint32_t> _ready;
+            // The stream whose request handler is running. It is not erased until the handler returns,
+            // even if the handler answers it in full.
+            std::uint32_t _dispatching = 0;
+
+            void frame(FrameType type, std::uint8_t flags, std::uint32_t id, std::string_view payload);
+            void connection_error(ErrorCode code);
+            void reset(std::uint32_t id, ErrorCode code);
+            void preface();
+
+            // Queue a header block, splitting it into HEADERS and CONTINUATION frames.
+            void send_headers(Http2Stream& stream, const std::vector<hpack::HeaderField>& fields, bool end_stream);
+            // Queue as much pending DATA as the flow control windows allow.
+            void send_data(Http2Stream& stream);
+
+            // Client streams are opened in order, as long as the peer's MAX_CONCURRENT_STREAMS allows.
+            void open_streams();
+
+            void on_frame(FrameType type, std::uint8_t flags, std::uint32_t id, std::string_view payload);
+            void on_headers(std::uint32_t id, bool end_stream);
+            void on_data(std::uint32_t id, std::uint8_t flags, std::string_view payload);
+            void on_settings(std::uint8_t flags, std::string_view payload);
+            void on_window_update(std::uint32_t id, std::string_view payload);
+
+            // Drain the session read buffer and handle every complete frame, the presentation lock must be held.
+            void receive();
+            // Move queued frames into the session write buffer, returns false if there are none.
+            bool flush();
+
+        public:
+            Http2Presentation(Http2Presentations& server, Role role = Role::SERVER): Presentation(server), _role(role) { preface(); }
+            Http2Presentation(Http2Presentations& server, const std::shared_ptr<session::Session>& sp, Role role = Role::SERVER): Presentation(server, sp), _role(role) { preface(); }
+
+            // Server side.
+            handler on_request;
+            // Queue the response to a request, returns false if the stream no longer exists.
+            bool respond(std::uint32_t id, const http::HttpResponse& res);
+
+            // Client side, returns the id of the new stream or 0 if the connection is closing.
+            std::uint32_t request(const http::HttpRequest& req, handler fn);
+
+            // Queue a GOAWAY, streams that are open keep going.
+            void goaway(ErrorCode code = ErrorCode::NO_ERROR);
+            ErrorCode error() { auto lk = lock(); return _error; }
+            std::size_t streams() { auto lk = lock(); return std::get<Http2Streams>(*this).size(); }
+
+            void read() override;
+            void async_read(std::function<void(std::error_code ec)> cb) override;
+            void write() override;
+            void async_write(std::function<void(std::error_code ec)> cb) override;
+
+            ~Http2Presentation() = default;
+        };
+    }
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <algorithm>
+#include "json-presentation.hpp"
+namespace json
+{
+    using http::HttpHeader;
+    using http::HttpHeaderField;
+
+    void feed(Parser& parser, http::HttpRequest& req){
+        // Chunks before next_chunk have been parsed completely.
+        std::size_t end = std::min(req.next_chunk, req.chunks.size());
+        for(; req.pos < end; ++req.pos){
+            parser.feed(req.chunks[req.pos].chunk_data);
+        }
+    }
+
+    bool parse(http::HttpRequest& req, Document& doc){
+        Parser parser;
+        req.pos = 0;
+        feed(parser, req);
+        return parser.finish(doc);
+    }
+
+    void respond(http::HttpResponse& res, std::string body){
+        // The body headers are replaced, and the headers are terminated again after them.
+        res.headers.erase(std::remove_if(res.headers.begin(), res.headers.end(), [](const HttpHeader& header){
+            return header.field_name == HttpHeaderField::CONTENT_TYPE
+                || header.field_name == HttpHeaderField::CONTENT_LENGTH
+                || header.field_name == HttpHeaderField::TRANSFER_ENCODING
+                || header.field_name == HttpHeaderField::END_OF_HEADERS;
+        }), res.headers.end());
+        HttpHeader content_type{};
+        content_type.field_name = HttpHeaderField::CONTENT_TYPE;
+        content_type.field_value = "application/json";
+        res.headers.push_back(content_type);
+        HttpHeader content_length{};
+        content_length.field_name = HttpHeaderField::CONTENT_LENGTH;
+        content_length.field_value = std::to_string(body.size());
+        res.headers.push_back(content_length);
+        HttpHeader end{};
+        end.field_name = HttpHeaderField::END_OF_HEADERS;
+        res.headers.push_back(end);
+        http::HttpChunk chunk{};
+        chunk.chunk_size = {body.size()};
+        chunk.chunk_data = std::move(body);
+        res.chunks.clear();
+        res.chunks.push_back(std::move(chunk));
+    }
+}
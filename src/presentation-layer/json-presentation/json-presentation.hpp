@@ -0,0 +1,36 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef JSON_PRESENTATION_HPP
+#define JSON_PRESENTATION_HPP
+#include "json.hpp"
+#include "../http-presentation/http-requests.hpp"
+namespace json
+{
+    /*
+    *  application/json bodies for HTTP requests and responses.
+    *
+    *  feed() indexes the chunks of a request body that have been parsed since the last call, tracking them with HttpRequest::pos,
+    *  so a handler can index a chunked body as it arrives and only finish() once the request is complete.
+    *  read() does all of that at once, and decodes the body into a native type.
+    */
+    void feed(Parser& parser, http::HttpRequest& req);
+    bool parse(http::HttpRequest& req, Document& doc);
+
+    // Values decoded as std::string_view point into doc.
+    template<class T>
+    bool read(http::HttpRequest& req, Document& doc, T& out){
+        return parse(req, doc) && decode(doc.root(), out);
+    }
+
+    // Set the body of a response, with its Content-Type and Content-Length.
+    void respond(http::HttpResponse& res, std::string body);
+
+    template<class T>
+    void write(http::HttpResponse& res, const T& value){
+        respond(res, write(value));
+    }
+}
+#endif
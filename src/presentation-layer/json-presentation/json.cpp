@@ -0,0 +1,625 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "json.hpp"
+namespace json
+{
+    static const std::size_t BLOCK = 64;
+
+    static bool is_whitespace(char c){
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    static bool is_operator(char c){
+        return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+    }
+
+    // Bitmasks of the characters in a block that matter to the structural index, one bit per byte.
+    struct Classes
+    {
+        std::uint64_t backslash;
+        std::uint64_t quote;
+        std::uint64_t op;
+        std::uint64_t whitespace;
+    };
+
+    static Classes classify(const char* block){
+        Classes c{0, 0, 0, 0};
+#if defined(__AVX2__)
+        for(std::size_t i = 0; i < BLOCK; i += 32){
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+            auto eq = [&](char ch){ return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(ch)); };
+            auto bits = [](__m256i m){ return static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(m))); };
+            c.backslash |= bits(eq('\\')) << i;
+            c.quote |= bits(eq('"')) << i;
+            c.op |= bits(_mm256_or_si256(_mm256_or_si256(_mm256_or_si256(eq('{'), eq('}')), _mm256_or_si256(eq('['), eq(']'))), _mm256_or_si256(eq(':'), eq(',')))) << i;
+            c.whitespace |= bits(_mm256_or_si256(_mm256_or_si256(eq(' '), eq('\t')), _mm256_or_si256(eq('\n'), eq('\r')))) << i;
+        }
+#elif defined(__SSE2__)
+        for(std::size_t i = 0; i < BLOCK; i += 16){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+            auto eq = [&](char ch){ return _mm_cmpeq_epi8(v, _mm_set1_epi8(ch)); };
+            auto bits = [](__m128i m){ return static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm_movemask_epi8(m))); };
+            c.backslash |= bits(eq('\\')) << i;
+            c.quote |= bits(eq('"')) << i;
+            c.op |= bits(_mm_or_si128(_mm_or_si128(_mm_or_si128(eq('{'), eq('}')), _mm_or_si128(eq('['), eq(']'))), _mm_or_si128(eq(':'), eq(',')))) << i;
+            c.whitespace |= bits(_mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), _mm_or_si128(eq('\n'), eq('\r')))) << i;
+        }
+#else
+        for(std::size_t i = 0; i < BLOCK; ++i){
+            std::uint64_t bit = std::uint64_t(1) << i;
+            char ch = block[i];
+            if(ch == '\\'){
+                c.backslash |= bit;
+            } else if(ch == '"'){
+                c.quote |= bit;
+            } else if(is_operator(ch)){
+                c.op |= bit;
+            } else if(is_whitespace(ch)){
+                c.whitespace |= bit;
+            }
+        }
+#endif
+        return c;
+    }
+
+    // Bit i of the result is the XOR of bits 0 to i, which turns quote positions into a mask of the string contents.
+    static std::uint64_t prefix_xor(std::uint64_t x){
+#if defined(__PCLMUL__)
+        __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(x)), _mm_set1_epi8(-1), 0);
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(r));
+#else
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+#endif
+    }
+
+    void Parser::index(const char* block, std::size_t offset){
+        Classes c = classify(block);
+
+        // Characters that are escaped by an odd length run of backslashes, runs may start in the last block.
+        const std::uint64_t even = 0x5555555555555555ULL;
+        std::uint64_t backslash = c.backslash & ~_prev_escaped;
+        std::uint64_t follows_escape = backslash << 1 | _prev_escaped;
+        std::uint64_t odd_starts = backslash & ~even & ~follows_escape;
+        std::uint64_t even_sequences;
+        _prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_sequences);
+        std::uint64_t escaped = (even ^ (even_sequences << 1)) & follows_escape;
+
+        std::uint64_t quote = c.quote & ~escaped;
+        std::uint64_t in_string = prefix_xor(quote) ^ _prev_in_string;
+        _prev_in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+        // The inside of every string and its closing quote, but not its opening quote.
+        std::uint64_t string_tail = in_string ^ quote;
+
+        // Scalars start at the first character that is not whitespace or an operator after one that is.
+        std::uint64_t scalar = ~(c.op | c.whitespace);
+        std::uint64_t nonquote_scalar = scalar & ~quote;
+        std::uint64_t follows_scalar = nonquote_scalar << 1 | _prev_scalar;
+        _prev_scalar = nonquote_scalar >> 63;
+        std::uint64_t structurals = (c.op | (scalar & ~follows_scalar)) & ~string_tail;
+
+        std::size_t n = _index.size();
+        _index.resize(n + __builtin_popcountll(structurals));
+        while(structurals){
+            _index[n++] = static_cast<std::uint32_t>(offset + __builtin_ctzll(structurals));
+            structurals &= structurals - 1;
+        }
+    }
+
+    void Parser::feed(std::string_view chunk){
+        _text.append(chunk);
+        for(; _indexed + BLOCK <= _text.size(); _indexed += BLOCK){
+            index(_text.data() + _indexed, _indexed);
+        }
+    }
+
+    void Parser::reset(){
+        _text.clear();
+        _index.clear();
+        _indexed = 0;
+        _prev_escaped = _prev_in_string = _prev_scalar = 0;
+    }
+
+    // The length of the number at the start of str, or 0 if it does not start with a valid number.
+    static std::size_t number_length(std::string_view str){
+        std::size_t i = 0;
+        auto digits = [&](){
+            std::size_t start = i;
+            while(i < str.size() && str[i] >= '0' && str[i] <= '9'){
+                ++i;
+            }
+            return i - start;
+        };
+        if(i < str.size() && str[i] == '-'){
+            ++i;
+        }
+        if(i < str.size() && str[i] == '0'){
+            ++i;
+        } else if(digits() == 0){
+            return 0;
+        }
+        if(i < str.size() && str[i] == '.'){
+            ++i;
+            if(digits() == 0){
+                return 0;
+            }
+        }
+        if(i < str.size() && (str[i] == 'e' || str[i] == 'E')){
+            ++i;
+            if(i < str.size() && (str[i] == '+' || str[i] == '-')){
+                ++i;
+            }
+            if(digits() == 0){
+                return 0;
+            }
+        }
+        return i;
+    }
+
+    std::string_view Document::token(std::uint32_t i) const {
+        std::size_t begin = _index[i];
+        std::size_t end = i + 1 < _index.size() ? _index[i+1] : _text.size();
+        while(end > begin && is_whitespace(_text[end-1])){
+            --end;
+        }
+        return std::string_view(_text).substr(begin, end - begin);
+    }
+
+    std::uint32_t Document::skip(std::uint32_t i) const {
+        char c = at(i);
+        return (c == '{' || c == '[') ? _close[i] + 1 : i + 1;
+    }
+
+    bool Parser::validate(std::vector<std::uint32_t>& close) const {
+        enum class Expect
+        {
+            VALUE,
+            VALUE_OR_END,
+            KEY,
+            KEY_OR_END,
+            COLON,
+            COMMA_OR_END,
+            NOTHING
+        };
+        Expect expect = Expect::VALUE;
+        std::vector<std::uint32_t> open;
+        std::string_view text(_text);
+        auto scalar = [&](std::uint32_t i){
+            std::size_t begin = _index[i];
+            std::size_t end = i + 1 < _index.size() ? _index[i+1] : text.size();
+            while(end > begin && is_whitespace(text[end-1])){
+                --end;
+            }
+            std::string_view token = text.substr(begin, end - begin);
+            switch(token[0]){
+                case '"':
+                    return token.size() >= 2 && token.back() == '"';
+                case 't':
+                    return token == "true";
+                case 'f':
+                    return token == "false";
+                case 'n':
+                    return token == "null";
+                default:
+                    return number_length(token) == token.size();
+            }
+        };
+        for(std::uint32_t i = 0; i < _index.size(); ++i){
+            char c = text[_index[i]];
+            switch(expect){
+                case Expect::VALUE:
+                case Expect::VALUE_OR_END:
+                    if(c == ']' && expect == Expect::VALUE_OR_END){
+                        close[open.back()] = i;
+                        open.pop_back();
+                    } else if(c == '{' || c == '['){
+                        open.push_back(i);
+                        expect = c == '{' ? Expect::KEY_OR_END : Expect::VALUE_OR_END;
+                        continue;
+                    } else if(is_operator(c) || !scalar(i)){
+                        return false;
+                    }
+                    expect = open.empty() ? Expect::NOTHING : Expect::COMMA_OR_END;
+                    break;
+                case Expect::KEY:
+                case Expect::KEY_OR_END:
+                    if(c == '}' && expect == Expect::KEY_OR_END){
+                        close[open.back()] = i;
+                        open.pop_back();
+                        expect = open.empty() ? Expect::NOTHING : Expect::COMMA_OR_END;
+                    } else if(c == '"' && scalar(i)){
+                        expect = Expect::COLON;
+                    } else {
+                        return false;
+                    }
+                    break;
+                case Expect::COLON:
+                    if(c != ':'){
+                        return false;
+                    }
+                    expect = Expect::VALUE;
+                    break;
+                case Expect::COMMA_OR_END:
+                {
+                    bool object = text[_index[open.back()]] == '{';
+                    if(c == ','){
+                        expect = object ? Expect::KEY : Expect::VALUE;
+                    } else if(c == (object ? '}' : ']')){
+                        close[open.back()] = i;
+                        open.pop_back();
+                        expect = open.empty() ? Expect::NOTHING : Expect::COMMA_OR_END;
+                    } else {
+                        return false;
+                    }
+                    break;
+                }
+                case Expect::NOTHING:
+                    return false;
+            }
+        }
+        return expect == Expect::NOTHING;
+    }
+
+    bool Parser::finish(Document& doc){
+        bool valid = _text.size() <= std::numeric_limits<std::uint32_t>::max();
+        if(valid && _indexed < _text.size()){
+            // The last partial block is padded with whitespace.
+            char block[BLOCK];
+            std::memset(block, ' ', BLOCK);
+            std::memcpy(block, _text.data() + _indexed, _text.size() - _indexed);
+            index(block, _indexed);
+        }
+        std::vector<std::uint32_t> close;
+        valid = valid && !_prev_in_string;
+        if(valid){
+            close.resize(_index.size());
+            valid = validate(close);
+        }
+        if(valid){
+            doc._text = std::move(_text);
+            doc._index = std::move(_index);
+            doc._close = std::move(close);
+        }
+        reset();
+        return valid;
+    }
+
+    bool parse(std::string_view text, Document& doc){
+        Parser parser;
+        parser.feed(text);
+        return parser.finish(doc);
+    }
+
+    Type Value::type() const {
+        if(!_doc){
+            return Type::INVALID;
+        }
+        switch(_doc->at(_i)){
+            case '{':
+                return Type::OBJECT;
+            case '[':
+                return Type::ARRAY;
+            case '"':
+                return Type::STRING;
+            case 't':
+            case 'f':
+                return Type::BOOLEAN;
+            case 'n':
+                return Type::NULL_VALUE;
+            default:
+                return Type::NUMBER;
+        }
+    }
+
+    Value::iterator& Value::iterator::operator++(){
+        std::uint32_t next = _doc->skip(_object ? _i + 2 : _i);
+        _i = _doc->at(next) == ',' ? next + 1 : next;
+        return *this;
+    }
+
+    Value::iterator Value::begin() const {
+        Type t = type();
+        if(t != Type::OBJECT && t != Type::ARRAY){
+            return iterator(_doc, 0, false);
+        }
+        return iterator(_doc, _i + 1, t == Type::OBJECT);
+    }
+
+    Value::iterator Value::end() const {
+        Type t = type();
+        if(t != Type::OBJECT && t != Type::ARRAY){
+            return iterator(_doc, 0, false);
+        }
+        return iterator(_doc, _doc->_close[_i], t == Type::OBJECT);
+    }
+
+    Value Value::operator[](std::string_view key) const {
+        if(type() != Type::OBJECT){
+            return Value();
+        }
+        for(auto it = begin(); it != end(); ++it){
+            if(key_equals(it.key(), key)){
+                return *it;
+            }
+        }
+        return Value();
+    }
+
+    Value Value::operator[](std::size_t index) const {
+        if(type() != Type::ARRAY){
+            return Value();
+        }
+        for(auto it = begin(); it != end(); ++it){
+            if(index-- == 0){
+                return *it;
+            }
+        }
+        return Value();
+    }
+
+    std::size_t Value::size() const {
+        std::size_t n = 0;
+        for(auto it = begin(); it != end(); ++it){
+            ++n;
+        }
+        return n;
+    }
+
+    std::string_view Value::raw() const {
+        Type t = type();
+        if(t == Type::INVALID){
+            return std::string_view();
+        }
+        if(t == Type::OBJECT || t == Type::ARRAY){
+            std::size_t begin = _doc->_index[_i];
+            return _doc->text().substr(begin, _doc->_index[_doc->_close[_i]] + 1 - begin);
+        }
+        return _doc->token(_i);
+    }
+
+    bool Value::get(bool& out) const {
+        if(type() != Type::BOOLEAN){
+            return false;
+        }
+        out = _doc->at(_i) == 't';
+        return true;
+    }
+
+    bool Value::get(std::int64_t& out) const {
+        if(type() != Type::NUMBER){
+            return false;
+        }
+        std::string_view token = _doc->token(_i);
+        auto res = std::from_chars(token.data(), token.data() + token.size(), out);
+        return res.ec == std::errc() && res.ptr == token.data() + token.size();
+    }
+
+    bool Value::get(std::uint64_t& out) const {
+        if(type() != Type::NUMBER || _doc->at(_i) == '-'){
+            return false;
+        }
+        std::string_view token = _doc->token(_i);
+        auto res = std::from_chars(token.data(), token.data() + token.size(), out);
+        return res.ec == std::errc() && res.ptr == token.data() + token.size();
+    }
+
+    bool Value::get(double& out) const {
+        if(type() != Type::NUMBER){
+            return false;
+        }
+        std::string_view token = _doc->token(_i);
+        auto res = std::from_chars(token.data(), token.data() + token.size(), out);
+        return res.ec == std::errc() && res.ptr == token.data() + token.size();
+    }
+
+    static void utf8(std::string& out, std::uint32_t cp){
+        if(cp < 0x80){
+            out.push_back(static_cast<char>(cp));
+        } else if(cp < 0x800){
+            out.push_back(static_cast<char>(0xc0 | cp >> 6));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        } else if(cp < 0x10000){
+            out.push_back(static_cast<char>(0xe0 | cp >> 12));
+            out.push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xf0 | cp >> 18));
+            out.push_back(static_cast<char>(0x80 | (cp >> 12 & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+    }
+
+    static bool hex4(std::string_view str, std::size_t i, std::uint32_t& out){
+        if(i + 4 > str.size()){
+            return false;
+        }
+        out = 0;
+        for(std::size_t j = i; j < i + 4; ++j){
+            char c = str[j];
+            out <<= 4;
+            if(c >= '0' && c <= '9'){
+                out |= c - '0';
+            } else if(c >= 'a' && c <= 'f'){
+                out |= c - 'a' + 10;
+            } else if(c >= 'A' && c <= 'F'){
+                out |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Decode the contents of a string, between its quotes.
+    static bool unescape(std::string_view str, std::string& out){
+        out.clear();
+        out.reserve(str.size());
+        std::size_t i = 0;
+        while(i < str.size()){
+            // Copy the run up to the next escape sequence in one go.
+            std::size_t run = i;
+            while(run < str.size() && str[run] != '\\'){
+                if(static_cast<unsigned char>(str[run]) < 0x20){
+                    return false;
+                }
+                ++run;
+            }
+            out.append(str.data() + i, run - i);
+            i = run;
+            if(i == str.size()){
+                break;
+            }
+            if(++i == str.size()){
+                return false;
+            }
+            char c = str[i++];
+            switch(c){
+                case '"':
+                case '\\':
+                case '/':
+                    out.push_back(c);
+                    break;
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'u':
+                {
+                    std::uint32_t cp;
+                    if(!hex4(str, i, cp)){
+                        return false;
+                    }
+                    i += 4;
+                    // Characters outside the BMP are written as a surrogate pair.
+                    if(cp >= 0xd800 && cp < 0xdc00){
+                        std::uint32_t low;
+                        if(i + 6 > str.size() || str[i] != '\\' || str[i+1] != 'u' || !hex4(str, i + 2, low) || low < 0xdc00 || low >= 0xe000){
+                            return false;
+                        }
+                        i += 6;
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    } else if(cp >= 0xdc00 && cp < 0xe000){
+                        return false;
+                    }
+                    utf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool Value::get(std::string& out) const {
+        if(type() != Type::STRING){
+            return false;
+        }
+        std::string_view token = _doc->token(_i);
+        return unescape(token.substr(1, token.size() - 2), out);
+    }
+
+    bool Value::get(std::string_view& out) const {
+        if(type() != Type::STRING){
+            return false;
+        }
+        std::string_view token = _doc->token(_i);
+        token = token.substr(1, token.size() - 2);
+        for(char c: token){
+            if(c == '\\' || static_cast<unsigned char>(c) < 0x20){
+                return false;
+            }
+        }
+        out = token;
+        return true;
+    }
+
+    bool key_equals(Value name, std::string_view key){
+        std::string_view token = name.raw();
+        if(token.size() < 2){
+            return false;
+        }
+        token = token.substr(1, token.size() - 2);
+        if(token.find('\\') == std::string_view::npos){
+            return token == key;
+        }
+        std::string unescaped;
+        return unescape(token, unescaped) && unescaped == key;
+    }
+
+    void quote(std::string& out, std::string_view str){
+        static const char hex[] = "0123456789abcdef";
+        out.reserve(out.size() + str.size() + 2);
+        out.push_back('"');
+        std::size_t i = 0;
+        while(i < str.size()){
+            std::size_t run = i;
+            while(run < str.size() && str[run] != '"' && str[run] != '\\' && static_cast<unsigned char>(str[run]) >= 0x20){
+                ++run;
+            }
+            out.append(str.data() + i, run - i);
+            i = run;
+            if(i == str.size()){
+                break;
+            }
+            unsigned char c = str[i++];
+            switch(c){
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                case '\r':
+                    out.append("\\r");
+                    break;
+                case '\t':
+                    out.append("\\t");
+                    break;
+                default:
+                    out.append("\\u00");
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 0xf]);
+                    break;
+            }
+        }
+        out.push_back('"');
+    }
+
+    void encode(std::string& out, double value){
+        if(value != value || value - value != 0){
+            out.append("null");
+            return;
+        }
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, res.ptr - buf);
+    }
+}
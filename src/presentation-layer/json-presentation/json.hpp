@@ -0,0 +1,353 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef JSON_HPP
+#define JSON_HPP
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+namespace json
+{
+    enum class Type
+    {
+        INVALID,
+        NULL_VALUE,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    class Document;
+
+    /*
+    *  A value in a Document, found on demand.
+    *  Nothing is converted until it is asked for, and looking up a member or an element
+    *  only walks the structural characters of the container, jumping straight over nested containers.
+    *  Looking up something that is not there returns an INVALID value, so lookups can be chained.
+    */
+    class Value
+    {
+        const Document* _doc = nullptr;
+        // The position of the value in the document's structural index.
+        std::uint32_t _i = 0;
+
+    public:
+        Value() = default;
+        Value(const Document* doc, std::uint32_t i): _doc(doc), _i(i) {}
+
+        Type type() const;
+        explicit operator bool() const { return type() != Type::INVALID; }
+        bool is_null() const { return type() == Type::NULL_VALUE; }
+
+        // The member of an object, or the element of an array.
+        Value operator[](std::string_view key) const;
+        Value operator[](std::size_t index) const;
+        // The number of members or elements.
+        std::size_t size() const;
+
+        // The text of the value, strings include their quotes.
+        std::string_view raw() const;
+
+        // Conversions return false if the value has a different type or does not fit.
+        bool get(bool& out) const;
+        bool get(std::int64_t& out) const;
+        bool get(std::uint64_t& out) const;
+        bool get(double& out) const;
+        bool get(std::string& out) const;
+        // A view into the document, only strings without escape sequences can be viewed.
+        bool get(std::string_view& out) const;
+
+        // Iterates over the elements of an array, or the members of an object.
+        class iterator
+        {
+            const Document* _doc;
+            std::uint32_t _i;
+            bool _object;
+
+        public:
+            iterator(const Document* doc, std::uint32_t i, bool object): _doc(doc), _i(i), _object(object) {}
+            Value operator*() const { return Value(_doc, _object ? _i + 2 : _i); }
+            // The name of the current member of an object.
+            Value key() const { return Value(_doc, _i); }
+            iterator& operator++();
+            bool operator==(const iterator& other) const { return _i == other._i; }
+            bool operator!=(const iterator& other) const { return _i != other._i; }
+        };
+        iterator begin() const;
+        iterator end() const;
+    };
+
+    /*
+    *  A parsed JSON text: the text itself, and the positions of its structural characters
+    *  (brackets, colons, commas, and the first character of every scalar) found by the Parser.
+    *  Values point into the document, so it must outlive them and must not be moved while they are in use.
+    */
+    class Document
+    {
+        friend class Parser;
+        friend class Value;
+
+        std::string _text;
+        std::vector<std::uint32_t> _index;
+        // For every opening bracket, the position of its closing bracket in the index.
+        std::vector<std::uint32_t> _close;
+
+        char at(std::uint32_t i) const { return _text[_index[i]]; }
+        // The position in the index that follows the value at i.
+        std::uint32_t skip(std::uint32_t i) const;
+        // The text of the scalar at i.
+        std::string_view token(std::uint32_t i) const;
+
+    public:
+        Value root() const { return _index.empty() ? Value() : Value(this, 0); }
+        std::string_view text() const { return _text; }
+        std::size_t structurals() const { return _index.size(); }
+    };
+
+    /*
+    *  Builds a Document from text that arrives in pieces, such as the chunks of an HTTP body.
+    *  Each complete 64 byte block is indexed as soon as it arrives, 16 or 32 bytes at a time where SIMD is available,
+    *  carrying the string and escape state from one block to the next.
+    *  finish() indexes the rest, and checks the grammar before handing the document over.
+    *  Numbers and literals are checked by finish(), string contents when they are converted.
+    */
+    class Parser
+    {
+        std::string _text;
+        std::vector<std::uint32_t> _index;
+        std::size_t _indexed = 0;
+        // Carried between blocks: a backslash at the end of the last block escapes the first character of the next,
+        // the last block ended inside a string, or in the middle of a scalar.
+        std::uint64_t _prev_escaped = 0;
+        std::uint64_t _prev_in_string = 0;
+        std::uint64_t _prev_scalar = 0;
+
+        void index(const char* block, std::size_t offset);
+        bool validate(std::vector<std::uint32_t>& close) const;
+
+    public:
+        void feed(std::string_view chunk);
+        // Returns false if the text is not valid JSON. The parser is reset either way.
+        bool finish(Document& doc);
+        void reset();
+    };
+
+    bool parse(std::string_view text, Document& doc);
+
+    // Escape and quote a string.
+    void quote(std::string& out, std::string_view str);
+
+    /*
+    *  Mapping to and from native types.
+    *  Structs are mapped by declaring their members in a static json_fields tuple:
+    *
+    *      struct User {
+    *          std::string name;
+    *          std::optional<int> age;
+    *          static constexpr auto json_fields = std::make_tuple(json::field("name", &User::name), json::field("age", &User::age));
+    *      };
+    *
+    *  Members that are missing from an object keep their values, and unknown members are ignored.
+    *  std::optional members are written as null when they are empty.
+    */
+    template<class T, class M>
+    struct Field
+    {
+        std::string_view name;
+        M T::* member;
+    };
+
+    template<class T, class M>
+    constexpr Field<T, M> field(std::string_view name, M T::* member) { return Field<T, M>{name, member}; }
+
+    template<class T, class Enable = void>
+    struct has_fields: std::false_type {};
+    template<class T>
+    struct has_fields<T, std::void_t<decltype(T::json_fields)> >: std::true_type {};
+
+    // Compare the name of an object member with a key, the name may contain escape sequences.
+    bool key_equals(Value name, std::string_view key);
+
+    inline bool decode(Value v, bool& out) { return v.get(out); }
+    inline bool decode(Value v, std::string& out) { return v.get(out); }
+    inline bool decode(Value v, std::string_view& out) { return v.get(out); }
+
+    template<class T>
+    std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, bool> decode(Value v, T& out){
+        if constexpr (std::is_signed_v<T>){
+            std::int64_t n;
+            if(!v.get(n) || n < std::numeric_limits<T>::min() || n > std::numeric_limits<T>::max()){
+                return false;
+            }
+            out = static_cast<T>(n);
+        } else {
+            std::uint64_t n;
+            if(!v.get(n) || n > std::numeric_limits<T>::max()){
+                return false;
+            }
+            out = static_cast<T>(n);
+        }
+        return true;
+    }
+
+    template<class T>
+    std::enable_if_t<std::is_floating_point_v<T>, bool> decode(Value v, T& out){
+        double d;
+        if(!v.get(d)){
+            return false;
+        }
+        out = static_cast<T>(d);
+        return true;
+    }
+
+    template<class T>
+    bool decode(Value v, std::optional<T>& out){
+        if(v.is_null()){
+            out.reset();
+            return true;
+        }
+        if(!out){
+            out.emplace();
+        }
+        return decode(v, *out);
+    }
+
+    template<class T>
+    bool decode(Value v, std::vector<T>& out){
+        if(v.type() != Type::ARRAY){
+            return false;
+        }
+        out.clear();
+        for(Value element: v){
+            out.emplace_back();
+            if(!decode(element, out.back())){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<class T>
+    std::enable_if_t<has_fields<T>::value, bool> decode(Value v, T& out){
+        if(v.type() != Type::OBJECT){
+            return false;
+        }
+        // Members usually arrive in the order that they are declared,
+        // so each search starts where the last one finished and wraps around.
+        Value::iterator begin = v.begin(), end = v.end(), cursor = begin;
+        auto find = [&](std::string_view name){
+            for(auto it = cursor; it != end; ++it){
+                if(key_equals(it.key(), name)){
+                    cursor = it;
+                    return *it;
+                }
+            }
+            for(auto it = begin; it != cursor; ++it){
+                if(key_equals(it.key(), name)){
+                    cursor = it;
+                    return *it;
+                }
+            }
+            return Value();
+        };
+        return std::apply([&](const auto&... fields){
+            auto member = [&](const auto& f){
+                Value m = find(f.name);
+                return !m || decode(m, out.*(f.member));
+            };
+            return (member(fields) && ...);
+        }, T::json_fields);
+    }
+
+    // Containers encode their elements with unqualified calls, which only find the overloads declared before them.
+    template<class T>
+    std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> > encode(std::string& out, T value);
+    template<class T>
+    void encode(std::string& out, const std::optional<T>& value);
+    template<class T>
+    void encode(std::string& out, const std::vector<T>& value);
+    template<class T>
+    std::enable_if_t<has_fields<T>::value> encode(std::string& out, const T& value);
+
+    inline void encode(std::string& out, bool value) { out.append(value ? "true" : "false"); }
+    inline void encode(std::string& out, std::string_view value) { quote(out, value); }
+    inline void encode(std::string& out, const std::string& value) { quote(out, value); }
+    inline void encode(std::string& out, const char* value) { quote(out, value); }
+
+    template<class T>
+    std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> > encode(std::string& out, T value){
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, res.ptr - buf);
+    }
+
+    // Non-finite numbers have no JSON representation, and are written as null.
+    void encode(std::string& out, double value);
+    inline void encode(std::string& out, float value) { encode(out, static_cast<double>(value)); }
+
+    template<class T>
+    void encode(std::string& out, const std::optional<T>& value){
+        if(value){
+            encode(out, *value);
+        } else {
+            out.append("null");
+        }
+    }
+
+    template<class T>
+    void encode(std::string& out, const std::vector<T>& value){
+        out.push_back('[');
+        for(std::size_t i = 0; i < value.size(); ++i){
+            if(i){
+                out.push_back(',');
+            }
+            encode(out, value[i]);
+        }
+        out.push_back(']');
+    }
+
+    template<class T>
+    std::enable_if_t<has_fields<T>::value> encode(std::string& out, const T& value){
+        out.push_back('{');
+        bool first = true;
+        std::apply([&](const auto&... fields){
+            auto member = [&](const auto& f){
+                if(!first){
+                    out.push_back(',');
+                }
+                first = false;
+                quote(out, f.name);
+                out.push_back(':');
+                encode(out, value.*(f.member));
+            };
+            (member(fields), ...);
+        }, T::json_fields);
+        out.push_back('}');
+    }
+
+    // Parse a complete text straight into a native type.
+    // The document does not outlive the call, so types with std::string_view members need parse() and decode() instead.
+    template<class T>
+    bool read(std::string_view text, T& out){
+        Document doc;
+        return parse(text, doc) && decode(doc.root(), out);
+    }
+
+    template<class T>
+    std::string write(const T& value){
+        std::string out;
+        encode(out, value);
+        return out;
+    }
+}
+#endif
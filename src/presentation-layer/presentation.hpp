@@ -62,6 +62,9 @@ namespace presentation{
 
             std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(_mtx); }
 
+            // Heap bytes held by the application data (e.g. parsed messages), for presentations that account for them.
+            virtual std::size_t memory() { return 0; }
+
             virtual ~Presentation() = default;
     };
 
@@ -99,6 +102,16 @@ namespace presentation{
             }
             std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(_mtx); }
 
+            // Heap bytes held by the application data of every presentation.
+            std::size_t memory(){
+                auto lk = lock();
+                std::size_t bytes = 0;
+                for(auto& p: *this){
+                    bytes += p->memory();
+                }
+                return bytes;
+            }
+
             ~Presentations() = default;
     };
 }
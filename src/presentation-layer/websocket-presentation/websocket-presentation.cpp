@@ -0,0 +1,732 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <zlib.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "websocket-presentation.hpp"
+namespace websocket
+{
+    namespace ws_presentation
+    {
+        using http::HttpHeader;
+        using http::HttpHeaderField;
+
+        static const std::string_view GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        // The trailer that permessage-deflate strips from every compressed message.
+        static const char DEFLATE_TRAILER[] = {0x00, 0x00, static_cast<char>(0xff), static_cast<char>(0xff)};
+        static const std::size_t MAX_CONTROL_PAYLOAD = 125;
+
+        static std::array<unsigned char, 20> sha1(std::string_view in){
+            std::uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+            std::string msg(in);
+            std::uint64_t bits = static_cast<std::uint64_t>(in.size()) * 8;
+            msg.push_back(static_cast<char>(0x80));
+            while(msg.size() % 64 != 56){
+                msg.push_back(0);
+            }
+            for(int i = 7; i >= 0; --i){
+                msg.push_back(static_cast<char>(bits >> (i*8)));
+            }
+            auto rotl = [](std::uint32_t x, int n){ return (x << n) | (x >> (32-n)); };
+            for(std::size_t block = 0; block < msg.size(); block += 64){
+                std::uint32_t w[80];
+                for(std::size_t i = 0; i < 16; ++i){
+                    const unsigned char* p = reinterpret_cast<const unsigned char*>(msg.data() + block + i*4);
+                    w[i] = static_cast<std::uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+                }
+                for(std::size_t i = 16; i < 80; ++i){
+                    w[i] = rotl(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+                }
+                std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+                for(std::size_t i = 0; i < 80; ++i){
+                    std::uint32_t f, k;
+                    if(i < 20){
+                        f = (b & c) | (~b & d);
+                        k = 0x5a827999;
+                    } else if(i < 40){
+                        f = b ^ c ^ d;
+                        k = 0x6ed9eba1;
+                    } else if(i < 60){
+                        f = (b & c) | (b & d) | (c & d);
+                        k = 0x8f1bbcdc;
+                    } else {
+                        f = b ^ c ^ d;
+                        k = 0xca62c1d6;
+                    }
+                    std::uint32_t tmp = rotl(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotl(b, 30);
+                    b = a;
+                    a = tmp;
+                }
+                h[0] += a;
+                h[1] += b;
+                h[2] += c;
+                h[3] += d;
+                h[4] += e;
+            }
+            std::array<unsigned char, 20> digest;
+            for(std::size_t i = 0; i < 20; ++i){
+                digest[i] = static_cast<unsigned char>(h[i/4] >> (24 - (i%4)*8));
+            }
+            return digest;
+        }
+
+        static std::string base64(const unsigned char* data, std::size_t len){
+            static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::string out;
+            for(std::size_t i = 0; i < len; i += 3){
+                std::uint32_t n = static_cast<std::uint32_t>(data[i]) << 16;
+                if(i+1 < len){
+                    n |= static_cast<std::uint32_t>(data[i+1]) << 8;
+                }
+                if(i+2 < len){
+                    n |= data[i+2];
+                }
+                out.push_back(alphabet[(n >> 18) & 0x3f]);
+                out.push_back(alphabet[(n >> 12) & 0x3f]);
+                out.push_back(i+1 < len ? alphabet[(n >> 6) & 0x3f] : '=');
+                out.push_back(i+2 < len ? alphabet[n & 0x3f] : '=');
+            }
+            return out;
+        }
+
+        std::string accept_key(std::string_view key){
+            std::string input(key);
+            input.append(GUID);
+            auto digest = sha1(input);
+            return base64(digest.data(), digest.size());
+        }
+
+        void mask(char* data, std::size_t len, const unsigned char key[4]){
+            std::uint32_t key32;
+            std::memcpy(&key32, key, 4);
+            std::size_t i = 0;
+            // Every wide step is a multiple of 4 bytes long, so the key stays aligned with the data.
+#if defined(__AVX2__)
+            const __m256i key256 = _mm256_set1_epi32(key32);
+            for(; i + 32 <= len; i += 32){
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(v, key256));
+            }
+#endif
+#if defined(__SSE2__)
+            const __m128i key128 = _mm_set1_epi32(key32);
+            for(; i + 16 <= len; i += 16){
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, key128));
+            }
+#endif
+            const std::uint64_t key64 = static_cast<std::uint64_t>(key32) << 32 | key32;
+            for(; i + 8 <= len; i += 8){
+                std::uint64_t v;
+                std::memcpy(&v, data + i, 8);
+                v ^= key64;
+                std::memcpy(data + i, &v, 8);
+            }
+            for(; i < len; ++i){
+                data[i] ^= key[i & 3];
+            }
+        }
+
+        static bool utf8(std::string_view str){
+            std::size_t i = 0;
+            while(i < str.size()){
+                // Skip ASCII 8 bytes at a time.
+                if(i + 8 <= str.size()){
+                    std::uint64_t v;
+                    std::memcpy(&v, str.data() + i, 8);
+                    if((v & 0x8080808080808080ULL) == 0){
+                        i += 8;
+                        continue;
+                    }
+                }
+                unsigned char c = str[i];
+                std::size_t n;
+                std::uint32_t cp;
+                if(c < 0x80){
+                    ++i;
+                    continue;
+                } else if((c & 0xe0) == 0xc0){
+                    n = 1;
+                    cp = c & 0x1f;
+                } else if((c & 0xf0) == 0xe0){
+                    n = 2;
+                    cp = c & 0x0f;
+                } else if((c & 0xf8) == 0xf0){
+                    n = 3;
+                    cp = c & 0x07;
+                } else {
+                    return false;
+                }
+                if(i + n >= str.size()){
+                    return false;
+                }
+                for(std::size_t j = 1; j <= n; ++j){
+                    unsigned char cc = str[i+j];
+                    if((cc & 0xc0) != 0x80){
+                        return false;
+                    }
+                    cp = cp << 6 | (cc & 0x3f);
+                }
+                // Overlong encodings, surrogates, and code points past U+10FFFF are invalid.
+                static const std::uint32_t min[] = {0, 0x80, 0x800, 0x10000};
+                if(cp < min[n] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)){
+                    return false;
+                }
+                i += n + 1;
+            }
+            return true;
+        }
+
+        static const HttpHeader* find(const std::vector<HttpHeader>& headers, HttpHeaderField field){
+            auto it = std::find_if(headers.cbegin(), headers.cend(), [&](auto& header){ return header.field_name == field; });
+            return it == headers.cend() ? nullptr : &*it;
+        }
+
+        // Case insensitive search for a token in a comma separated header value.
+        static bool contains(const HttpHeader* header, std::string_view token){
+            if(header == nullptr){
+                return false;
+            }
+            std::string value = header->field_value;
+            std::transform(value.cbegin(), value.cend(), value.begin(), [](unsigned char c){ return std::tolower(c); });
+            std::size_t pos = 0;
+            while(pos <= value.size()){
+                std::size_t end = std::min(value.find(',', pos), value.size());
+                std::size_t first = value.find_first_not_of(" \t", pos);
+                std::size_t last = value.find_last_not_of(" \t", end-1);
+                if(first < end && last != std::string::npos && value.compare(first, last-first+1, token) == 0){
+                    return true;
+                }
+                pos = end+1;
+            }
+            return false;
+        }
+
+        // Extensions are a comma separated list of offers, each a name followed by ';' separated parameters.
+        typedef std::vector<std::pair<std::string, std::string> > Parameters;
+        static std::vector<std::pair<std::string, Parameters> > parse_extensions(const std::string& value){
+            std::vector<std::pair<std::string, Parameters> > extensions;
+            auto trim = [](std::string str){
+                std::size_t first = str.find_first_not_of(" \t\"");
+                std::size_t last = str.find_last_not_of(" \t\"");
+                return first == std::string::npos ? std::string() : str.substr(first, last-first+1);
+            };
+            std::stringstream offers(value);
+            std::string offer;
+            while(std::getline(offers, offer, ',')){
+                std::stringstream params(offer);
+                std::string param;
+                std::getline(params, param, ';');
+                extensions.emplace_back(trim(param), Parameters());
+                while(std::getline(params, param, ';')){
+                    std::size_t eq = param.find('=');
+                    if(eq == std::string::npos){
+                        extensions.back().second.emplace_back(trim(param), std::string());
+                    } else {
+                        extensions.back().second.emplace_back(trim(param.substr(0, eq)), trim(param.substr(eq+1)));
+                    }
+                }
+            }
+            return extensions;
+        }
+
+        struct WsPresentation::Compression
+        {
+            z_stream deflater{};
+            z_stream inflater{};
+            // Reset the compression context after every message (no_context_takeover).
+            bool reset;
+
+            Compression(int window_bits, bool reset): reset(reset){
+                // Negative window bits select raw deflate, without the zlib header and trailer.
+                deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY);
+                inflateInit2(&inflater, -15);
+            }
+
+            void compress(std::string_view in, std::string& out){
+                deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+                deflater.avail_in = in.size();
+                std::size_t len = 0;
+                do{
+                    out.resize(len + deflateBound(&deflater, deflater.avail_in) + 16);
+                    deflater.next_out = reinterpret_cast<Bytef*>(&out[len]);
+                    deflater.avail_out = out.size() - len;
+                    deflate(&deflater, Z_SYNC_FLUSH);
+                    len = out.size() - deflater.avail_out;
+                } while(deflater.avail_out == 0);
+                // A sync flush always ends with an empty stored block, which is left out on the wire.
+                out.resize(len - sizeof(DEFLATE_TRAILER));
+                if(reset){
+                    deflateReset(&deflater);
+                }
+            }
+
+            bool decompress(std::string_view in, std::string& out, std::size_t max){
+                std::size_t len = out.size();
+                for(std::string_view input: {in, std::string_view(DEFLATE_TRAILER, sizeof(DEFLATE_TRAILER))}){
+                    inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+                    inflater.avail_in = input.size();
+                    while(inflater.avail_in > 0){
+                        out.resize(len + std::max<std::size_t>(input.size() * 4, 4096));
+                        inflater.next_out = reinterpret_cast<Bytef*>(&out[len]);
+                        inflater.avail_out = out.size() - len;
+                        int ret = inflate(&inflater, Z_SYNC_FLUSH);
+                        len = out.size() - inflater.avail_out;
+                        if(len > max){
+                            return false;
+                        }
+                        if(ret == Z_STREAM_END){
+                            // The peer ended the message with a final block, which also ends the stream.
+                            // Nothing follows it, not even the trailer, and the next message starts a new stream.
+                            inflateReset(&inflater);
+                            out.resize(len);
+                            return true;
+                        }
+                        if(ret != Z_OK && ret != Z_BUF_ERROR){
+                            return false;
+                        }
+                    }
+                }
+                out.resize(len);
+                return true;
+            }
+
+            ~Compression(){
+                deflateEnd(&deflater);
+                inflateEnd(&inflater);
+            }
+        };
+
+        WsPresentation::WsPresentation(WsPresentations& server, Role role): Presentation(server), _role(role), _rng(std::random_device()()) {}
+        WsPresentation::WsPresentation(WsPresentations& server, const std::shared_ptr<session::Session>& sp, Role role): Presentation(server, sp), _role(role), _rng(std::random_device()()) {}
+        WsPresentation::WsPresentation(WsPresentations& server, const std::shared_ptr<session::Session>& sp, Role role, const Options& options): Presentation(server, sp), _role(role), _options(options), _rng(std::random_device()()) {}
+        WsPresentation::~WsPresentation() = default;
+
+        bool WsPresentation::negotiate(const std::string& extensions, std::string& response){
+            // Each side only has to act on the parameters that describe its own compressor,
+            // the decompressor always accepts the largest window.
+            const std::string local = _role == Role::SERVER ? "server" : "client";
+            for(auto& [name, params]: parse_extensions(extensions)){
+                if(name != "permessage-deflate"){
+                    if(_role == Role::CLIENT){
+                        // Servers may only respond with extensions that we offered.
+                        return false;
+                    }
+                    continue;
+                }
+                int window_bits = 15;
+                bool reset = false;
+                bool valid = true;
+                std::string agreed = "permessage-deflate";
+                for(auto& [param, value]: params){
+                    if(param == "server_no_context_takeover" || param == "client_no_context_takeover"){
+                        valid = valid && value.empty();
+                        reset = reset || param == local + "_no_context_takeover";
+                        agreed += "; " + param;
+                    } else if(param == "server_max_window_bits" || param == "client_max_window_bits"){
+                        int bits = value.empty() ? 15 : std::atoi(value.c_str());
+                        // zlib can not deflate with a 256 byte window.
+                        valid = valid && bits >= 9 && bits <= 15 && (!value.empty() || param == "client_max_window_bits");
+                        if(param == local + "_max_window_bits"){
+                            window_bits = bits;
+                        }
+                        if(!value.empty() && param == "server_max_window_bits"){
+                            agreed += "; " + param + "=" + value;
+                        }
+                    } else {
+                        valid = false;
+                    }
+                }
+                if(valid){
+                    _compression = std::make_unique<Compression>(window_bits, reset);
+                    response = agreed;
+                    return true;
+                }
+                if(_role == Role::CLIENT){
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool WsPresentation::handshake(const http::HttpRequest& req){
+            auto lk = lock();
+            http::HttpResponse res{};
+            res.version = http::HttpVersion::V1_1;
+            const HttpHeader* key = find(req.headers, HttpHeaderField::SEC_WEBSOCKET_KEY);
+            const HttpHeader* version = find(req.headers, HttpHeaderField::SEC_WEBSOCKET_VERSION);
+            bool valid = req.verb == http::HttpVerb::GET
+                && contains(find(req.headers, HttpHeaderField::UPGRADE), "websocket")
+                && contains(find(req.headers, HttpHeaderField::CONNECTION), "upgrade")
+                && version != nullptr && version->field_value == "13"
+                && key != nullptr && key->field_value.size() == 24;
+            std::string extensions;
+            if(valid && _options.deflate){
+                std::string offers;
+                for(auto& header: req.headers){
+                    if(header.field_name == HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS){
+                        offers += (offers.empty() ? "" : ",") + header.field_value;
+                    }
+                }
+                negotiate(offers, extensions);
+            }
+            if(valid){
+                res.status = http::HttpStatus::SWITCHING_PROTOCOLS;
+                res.headers.push_back(make_header(HttpHeaderField::UPGRADE, "websocket"));
+                res.headers.push_back(make_header(HttpHeaderField::CONNECTION, "Upgrade"));
+                res.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_ACCEPT, accept_key(key->field_value)));
+                if(!extensions.empty()){
+                    res.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS, extensions));
+                }
+            } else {
+                res.status = http::HttpStatus::BAD_REQUEST;
+                res.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_VERSION, "13"));
+                res.headers.push_back(make_header(HttpHeaderField::CONTENT_LENGTH, "0"));
+                res.headers.push_back(make_header(HttpHeaderField::CONNECTION, "close"));
+                _close_sent = _close_received = _failed = true;
+            }
+            res.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+            std::ostringstream os;
+            os << res;
+            _out.append(os.str());
+            return valid;
+        }
+
+        http::HttpRequest WsPresentation::handshake_request(std::string_view host, std::string_view path){
+            auto lk = lock();
+            unsigned char nonce[16];
+            for(std::size_t i = 0; i < sizeof(nonce); i += 4){
+                std::uint32_t r = _rng();
+                std::memcpy(nonce + i, &r, 4);
+            }
+            _key = base64(nonce, sizeof(nonce));
+            http::HttpRequest req{};
+            req.verb = http::HttpVerb::GET;
+            req.route = path;
+            req.version = http::HttpVersion::V1_1;
+            req.headers.push_back(make_header(HttpHeaderField::HOST, std::string(host)));
+            req.headers.push_back(make_header(HttpHeaderField::UPGRADE, "websocket"));
+            req.headers.push_back(make_header(HttpHeaderField::CONNECTION, "Upgrade"));
+            req.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_KEY, _key));
+            req.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_VERSION, "13"));
+            if(_options.deflate){
+                req.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS, "permessage-deflate; client_max_window_bits"));
+            }
+            req.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+            return req;
+        }
+
+        bool WsPresentation::handshake(const http::HttpResponse& res){
+            auto lk = lock();
+            const HttpHeader* accept = find(res.headers, HttpHeaderField::SEC_WEBSOCKET_ACCEPT);
+            const HttpHeader* extensions = find(res.headers, HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS);
+            std::string agreed;
+            bool valid = res.status == http::HttpStatus::SWITCHING_PROTOCOLS
+                && contains(find(res.headers, HttpHeaderField::UPGRADE), "websocket")
+                && contains(find(res.headers, HttpHeaderField::CONNECTION), "upgrade")
+                && accept != nullptr && accept->field_value == accept_key(_key)
+                && (extensions == nullptr || (_options.deflate && negotiate(extensions->field_value, agreed)));
+            if(!valid){
+                _compression.reset();
+                _close_sent = _close_received = _failed = true;
+            }
+            return valid;
+        }
+
+        void WsPresentation::frame(WsOpcode opcode, bool compressed, std::string_view payload){
+            _out.push_back(static_cast<char>(0x80 | (compressed ? 0x40 : 0) | static_cast<std::uint8_t>(opcode)));
+            // Clients must mask every frame that they send, servers must not.
+            const char masked = _role == Role::CLIENT ? static_cast<char>(0x80) : 0;
+            std::size_t len = payload.size();
+            if(len < 126){
+                _out.push_back(masked | static_cast<char>(len));
+            } else if(len <= 0xffff){
+                _out.push_back(masked | 126);
+                _out.push_back(static_cast<char>(len >> 8));
+                _out.push_back(static_cast<char>(len));
+            } else {
+                _out.push_back(masked | 127);
+                for(int i = 7; i >= 0; --i){
+                    _out.push_back(static_cast<char>(static_cast<std::uint64_t>(len) >> (i*8)));
+                }
+            }
+            if(_role == Role::CLIENT){
+                unsigned char key[4];
+                std::uint32_t r = _rng();
+                std::memcpy(key, &r, 4);
+                _out.append(reinterpret_cast<const char*>(key), 4);
+                std::size_t start = _out.size();
+                _out.append(payload);
+                mask(&_out[start], len, key);
+            } else {
+                _out.append(payload);
+            }
+        }
+
+        void WsPresentation::fail(WsCloseCode code){
+            if(!_close_sent){
+                std::string payload;
+                payload.push_back(static_cast<char>(static_cast<std::uint16_t>(code) >> 8));
+                payload.push_back(static_cast<char>(static_cast<std::uint16_t>(code)));
+                frame(WsOpcode::CLOSE, false, payload);
+                _close_sent = true;
+            }
+            if(_close_code == WsCloseCode::NONE){
+                _close_code = code;
+            }
+            _failed = true;
+        }
+
+        void WsPresentation::send(WsOpcode opcode, std::string_view data){
+            auto lk = lock();
+            if(_close_sent){
+                return;
+            }
+            if(_compression && data.size() >= _options.deflate_threshold && (opcode == WsOpcode::TEXT || opcode == WsOpcode::BINARY)){
+                std::string compressed;
+                _compression->compress(data, compressed);
+                frame(opcode, true, compressed);
+            } else {
+                frame(opcode, false, data);
+            }
+        }
+
+        void WsPresentation::ping(std::string_view data){
+            auto lk = lock();
+            if(!_close_sent){
+                frame(WsOpcode::PING, false, data.substr(0, MAX_CONTROL_PAYLOAD));
+            }
+        }
+
+        void WsPresentation::close(WsCloseCode code, std::string_view reason){
+            auto lk = lock();
+            if(_close_sent){
+                return;
+            }
+            std::string payload;
+            payload.push_back(static_cast<char>(static_cast<std::uint16_t>(code) >> 8));
+            payload.push_back(static_cast<char>(static_cast<std::uint16_t>(code)));
+            payload.append(reason.substr(0, MAX_CONTROL_PAYLOAD - 2));
+            frame(WsOpcode::CLOSE, false, payload);
+            _close_sent = true;
+        }
+
+        void WsPresentation::deliver(WsOpcode opcode, bool compressed, std::string_view payload){
+            WsMessage msg{opcode, std::string()};
+            if(compressed){
+                if(!_compression->decompress(payload, msg.data, _options.max_message)){
+                    fail(msg.data.size() > _options.max_message ? WsCloseCode::MESSAGE_TOO_BIG : WsCloseCode::INVALID_PAYLOAD);
+                    return;
+                }
+            } else {
+                msg.data.assign(payload);
+            }
+            if(opcode == WsOpcode::TEXT && !utf8(msg.data)){
+                fail(WsCloseCode::INVALID_PAYLOAD);
+                return;
+            }
+            std::get<WsMessages>(*this).push_back(std::move(msg));
+        }
+
+        void WsPresentation::on_control(WsOpcode opcode, std::string_view payload){
+            switch(opcode)
+            {
+                case WsOpcode::PING:
+                    if(!_close_sent){
+                        frame(WsOpcode::PONG, false, payload);
+                    }
+                    break;
+                case WsOpcode::PONG:
+                    break;
+                case WsOpcode::CLOSE:
+                {
+                    if(payload.size() == 1){
+                        fail(WsCloseCode::PROTOCOL_ERROR);
+                        return;
+                    }
+                    std::uint16_t code = static_cast<std::uint16_t>(WsCloseCode::NO_STATUS);
+                    if(payload.size() >= 2){
+                        code = static_cast<unsigned char>(payload[0]) << 8 | static_cast<unsigned char>(payload[1]);
+                        // 1004 to 1006 and 1015 are reserved for reporting, and are never sent.
+                        bool valid = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+                        if(!valid){
+                            fail(WsCloseCode::PROTOCOL_ERROR);
+                            return;
+                        }
+                        if(!utf8(payload.substr(2))){
+                            fail(WsCloseCode::INVALID_PAYLOAD);
+                            return;
+                        }
+                    }
+                    _close_received = true;
+                    if(_close_code == WsCloseCode::NONE){
+                        _close_code = static_cast<WsCloseCode>(code);
+                    }
+                    std::get<WsMessages>(*this).push_back(WsMessage{WsOpcode::CLOSE, std::string(payload)});
+                    if(!_close_sent){
+                        // Echo the status code back to complete the closing handshake.
+                        frame(WsOpcode::CLOSE, false, payload.substr(0, std::min<std::size_t>(payload.size(), 2)));
+                        _close_sent = true;
+                    }
+                    break;
+                }
+                default:
+                    fail(WsCloseCode::PROTOCOL_ERROR);
+                    break;
+            }
+        }
+
+        void WsPresentation::receive(){
+            {
+                auto lk = session->lock();
+                char buf[4096];
+                std::streamsize len;
+                while((len = session->rbuf.rdbuf()->sgetn(buf, sizeof(buf))) > 0){
+                    _in.append(buf, len);
+                }
+            }
+            std::size_t pos = 0;
+            while(!_failed && !_close_received && _in.size() - pos >= 2){
+                unsigned char b0 = _in[pos];
+                unsigned char b1 = _in[pos+1];
+                bool fin = b0 & 0x80;
+                bool compressed = b0 & 0x40;
+                WsOpcode opcode = static_cast<WsOpcode>(b0 & 0x0f);
+                bool masked = b1 & 0x80;
+                bool control = static_cast<std::uint8_t>(opcode) & 0x8;
+                std::uint64_t len = b1 & 0x7f;
+                std::size_t header = 2;
+                if(len == 126){
+                    header += 2;
+                } else if(len == 127){
+                    header += 8;
+                }
+                if(masked){
+                    header += 4;
+                }
+                if(_in.size() - pos < header){
+                    break;
+                }
+                if(len == 126){
+                    len = static_cast<unsigned char>(_in[pos+2]) << 8 | static_cast<unsigned char>(_in[pos+3]);
+                } else if(len == 127){
+                    len = 0;
+                    for(std::size_t i = 0; i < 8; ++i){
+                        len = len << 8 | static_cast<unsigned char>(_in[pos+2+i]);
+                    }
+                }
+                // Servers only accept masked frames, and clients only accept unmasked frames.
+                // RSV1 marks a compressed message, and is only allowed on its first frame.
+                if(masked != (_role == Role::SERVER) || (b0 & 0x30)
+                    || (compressed && (!_compression || control || opcode == WsOpcode::CONTINUATION))
+                    || (control && (!fin || len > MAX_CONTROL_PAYLOAD))){
+                    fail(WsCloseCode::PROTOCOL_ERROR);
+                    break;
+                }
+                if(len > _options.max_message || (!control && _fragmented && _fragments.size() + len > _options.max_message)){
+                    fail(WsCloseCode::MESSAGE_TOO_BIG);
+                    break;
+                }
+                if(_in.size() - pos - header < len){
+                    break;
+                }
+                // Unmask in place, the payload is a view into the input buffer.
+                char* payload = &_in[pos + header];
+                if(masked){
+                    mask(payload, len, reinterpret_cast<const unsigned char*>(&_in[pos + header - 4]));
+                }
+                std::string_view data(payload, len);
+                pos += header + len;
+                if(control){
+                    on_control(opcode, data);
+                } else if(opcode == WsOpcode::CONTINUATION){
+                    if(!_fragmented){
+                        fail(WsCloseCode::PROTOCOL_ERROR);
+                        break;
+                    }
+                    _fragments.append(data);
+                    if(fin){
+                        _fragmented = false;
+                        deliver(_fragment_opcode, _fragment_compressed, _fragments);
+                        _fragments.clear();
+                    }
+                } else if(opcode == WsOpcode::TEXT || opcode == WsOpcode::BINARY){
+                    if(_fragmented){
+                        fail(WsCloseCode::PROTOCOL_ERROR);
+                        break;
+                    }
+                    if(fin){
+                        deliver(opcode, compressed, data);
+                    } else {
+                        _fragmented = true;
+                        _fragment_opcode = opcode;
+                        _fragment_compressed = compressed;
+                        _fragments.assign(data);
+                    }
+                } else {
+                    fail(WsCloseCode::PROTOCOL_ERROR);
+                }
+            }
+            if(_failed){
+                _in.clear();
+            } else {
+                _in.erase(0, pos);
+            }
+        }
+
+        bool WsPresentation::flush(){
+            if(_out.empty()){
+                return false;
+            }
+            {
+                auto lk = session->lock();
+                session->wbuf.rdbuf()->sputn(_out.data(), _out.size());
+            }
+            _out.clear();
+            return true;
+        }
+
+        void WsPresentation::read(){
+            auto lk = lock();
+            receive();
+            // Pongs and the closing handshake are answered straight away.
+            if(flush()){
+                session->write();
+            }
+        }
+
+        void WsPresentation::async_read(std::function<void(std::error_code ec)> cb){
+            session->async_read([&, cb](std::error_code ec){
+                if(!ec){
+                    read();
+                }
+                cb(ec);
+            });
+        }
+
+        void WsPresentation::write(){
+            auto lk = lock();
+            flush();
+            session->write();
+        }
+
+        void WsPresentation::async_write(std::function<void(std::error_code ec)> cb){
+            auto lk = lock();
+            flush();
+            session->async_write(cb);
+        }
+    }
+}
@@ -0,0 +1,157 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef WEBSOCKET_PRESENTATION_HPP
+#define WEBSOCKET_PRESENTATION_HPP
+#include <cstdint>
+#include <deque>
+#include <random>
+#include "../http-presentation/http-requests.hpp"
+#include "../presentation.hpp"
+namespace websocket
+{
+    namespace ws_presentation
+    {
+        enum class WsOpcode: std::uint8_t
+        {
+            CONTINUATION = 0x0,
+            TEXT = 0x1,
+            BINARY = 0x2,
+            CLOSE = 0x8,
+            PING = 0x9,
+            PONG = 0xa
+        };
+
+        enum class WsCloseCode: std::uint16_t
+        {
+            NONE = 0,
+            NORMAL = 1000,
+            GOING_AWAY = 1001,
+            PROTOCOL_ERROR = 1002,
+            UNSUPPORTED_DATA = 1003,
+            NO_STATUS = 1005,
+            INVALID_PAYLOAD = 1007,
+            POLICY_VIOLATION = 1008,
+            MESSAGE_TOO_BIG = 1009,
+            INTERNAL_ERROR = 1011
+        };
+
+        // A complete (reassembled, and decompressed) message.
+        // The peer's close frame is delivered as a CLOSE message with the raw close payload.
+        struct WsMessage
+        {
+            WsOpcode opcode;
+            std::string data;
+        };
+        typedef std::deque<WsMessage> WsMessages;
+        typedef presentation::Presentation<WsMessages> Presentation;
+        typedef presentation::Presentations<WsMessages> WsPresentations;
+
+        // The Sec-WebSocket-Accept value for a Sec-WebSocket-Key.
+        std::string accept_key(std::string_view key);
+
+        // XOR data with a 4 byte masking key, 16 or 32 bytes at a time where SIMD is available.
+        void mask(char* data, std::size_t len, const unsigned char key[4]);
+
+        /*
+        *  WebSocket (RFC 6455) messaging over a session that has been upgraded from HTTP/1.1.
+        *
+        *  Servers are handed the session by HttpPresentation::upgrade, and answer the upgrade request with handshake(req).
+        *  Clients write handshake_request() with an HttpClientPresentation, and pass the response to handshake(res).
+        *  Any bytes already in the session read buffer after the handshake belong to the WebSocket.
+        *
+        *  read() appends every complete message to the WsMessages slot and answers pings and close frames.
+        *  send(), ping(), and close() queue frames, write() sends them.
+        *  permessage-deflate (RFC 7692) is negotiated if Options::deflate is set.
+        */
+        class WsPresentation: public Presentation
+        {
+        public:
+            enum class Role
+            {
+                SERVER,
+                CLIENT
+            };
+
+            struct Options
+            {
+                // Messages larger than this, before or after decompression, fail the connection.
+                std::size_t max_message = 16 << 20;
+                // Offer or accept permessage-deflate.
+                bool deflate = true;
+                // Messages smaller than this are sent uncompressed.
+                std::size_t deflate_threshold = 64;
+            };
+
+        private:
+            struct Compression;
+
+            Role _role;
+            Options _options;
+            std::unique_ptr<Compression> _compression;
+            std::mt19937 _rng;
+
+            // Bytes that have been read from the session but do not make up a complete frame yet.
+            std::string _in;
+            // Frames waiting to be written to the session.
+            std::string _out;
+
+            // A fragmented message that is being reassembled.
+            bool _fragmented = false;
+            bool _fragment_compressed = false;
+            WsOpcode _fragment_opcode = WsOpcode::CONTINUATION;
+            std::string _fragments;
+
+            bool _close_sent = false;
+            bool _close_received = false;
+            // Set once the connection has failed, nothing more is read.
+            bool _failed = false;
+            WsCloseCode _close_code = WsCloseCode::NONE;
+
+            // The key that was sent in the client's handshake request.
+            std::string _key;
+
+            void frame(WsOpcode opcode, bool compressed, std::string_view payload);
+            void fail(WsCloseCode code);
+            void deliver(WsOpcode opcode, bool compressed, std::string_view payload);
+            void on_control(WsOpcode opcode, std::string_view payload);
+            // Drain the session read buffer and handle every complete frame, the presentation lock must be held.
+            void receive();
+            bool flush();
+            // Parse a Sec-WebSocket-Extensions header, and set up compression if permessage-deflate was agreed.
+            bool negotiate(const std::string& extensions, std::string& response);
+
+        public:
+            WsPresentation(WsPresentations& server, Role role = Role::SERVER);
+            WsPresentation(WsPresentations& server, const std::shared_ptr<session::Session>& sp, Role role = Role::SERVER);
+            WsPresentation(WsPresentations& server, const std::shared_ptr<session::Session>& sp, Role role, const Options& options);
+
+            // Server side: queue the 101 Switching Protocols response to an upgrade request.
+            // If the request is not a valid WebSocket handshake a 400 Bad Request is queued instead and false is returned.
+            bool handshake(const http::HttpRequest& req);
+
+            // Client side: the upgrade request, and the check of the server's response.
+            http::HttpRequest handshake_request(std::string_view host, std::string_view path);
+            bool handshake(const http::HttpResponse& res);
+
+            void send(WsOpcode opcode, std::string_view data);
+            void ping(std::string_view data = std::string_view());
+            void close(WsCloseCode code = WsCloseCode::NORMAL, std::string_view reason = std::string_view());
+
+            // Both sides have sent a close frame, the session can be closed.
+            bool closed() { auto lk = lock(); return _close_sent && _close_received; }
+            WsCloseCode close_code() { auto lk = lock(); return _close_code; }
+            bool compressed() { auto lk = lock(); return static_cast<bool>(_compression); }
+
+            void read() override;
+            void async_read(std::function<void(std::error_code ec)> cb) override;
+            void write() override;
+            void async_write(std::function<void(std::error_code ec)> cb) override;
+
+            ~WsPresentation();
+        };
+    }
+}
+#endif
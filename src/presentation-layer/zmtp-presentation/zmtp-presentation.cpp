@@ -0,0 +1,396 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <cstring>
+#include <strings.h>
+#include "zmtp-presentation.hpp"
+namespace zmtp
+{
+    namespace z_presentation
+    {
+        static const std::uint8_t MORE = 0x01;
+        static const std::uint8_t LONG = 0x02;
+        static const std::uint8_t COMMAND = 0x04;
+        static const std::string_view MECHANISM = "NULL";
+
+        static std::string_view type_name(ZmtpPresentation::SocketType type){
+            switch(type){
+                case ZmtpPresentation::SocketType::REQ:
+                    return "REQ";
+                case ZmtpPresentation::SocketType::REP:
+                    return "REP";
+                case ZmtpPresentation::SocketType::PUSH:
+                    return "PUSH";
+                case ZmtpPresentation::SocketType::PULL:
+                    return "PULL";
+            }
+            return "";
+        }
+
+        // The peer socket types that each socket type may be connected to.
+        static bool compatible(ZmtpPresentation::SocketType type, std::string_view peer){
+            switch(type){
+                case ZmtpPresentation::SocketType::REQ:
+                    return peer == "REP" || peer == "ROUTER";
+                case ZmtpPresentation::SocketType::REP:
+                    return peer == "REQ" || peer == "DEALER";
+                case ZmtpPresentation::SocketType::PUSH:
+                    return peer == "PULL";
+                case ZmtpPresentation::SocketType::PULL:
+                    return peer == "PUSH";
+            }
+            return false;
+        }
+
+        static void put_property(std::string& out, std::string_view name, std::string_view value){
+            out.push_back(static_cast<char>(name.size()));
+            out.append(name);
+            for(int i = 3; i >= 0; --i){
+                out.push_back(static_cast<char>(value.size() >> (i*8)));
+            }
+            out.append(value);
+        }
+
+        void ZmtpPresentation::handshake(){
+            // The signature's padding carries an empty ZMTP/1.0 identity, which is what libzmq sends.
+            std::string greeting(GREETING, '\0');
+            greeting[0] = static_cast<char>(0xff);
+            greeting[8] = 0x01;
+            greeting[9] = 0x7f;
+            greeting[10] = 3;
+            greeting[11] = 1;
+            std::memcpy(&greeting[12], MECHANISM.data(), MECHANISM.size());
+            _out = std::move(greeting);
+            std::string properties;
+            put_property(properties, "Socket-Type", type_name(_type));
+            command("READY", properties);
+        }
+
+        void ZmtpPresentation::frame(std::string& out, std::uint8_t flags, std::string_view body){
+            if(body.size() > 255){
+                out.push_back(static_cast<char>(flags | LONG));
+                for(int i = 7; i >= 0; --i){
+                    out.push_back(static_cast<char>(static_cast<std::uint64_t>(body.size()) >> (i*8)));
+                }
+            } else {
+                out.push_back(static_cast<char>(flags));
+                out.push_back(static_cast<char>(body.size()));
+            }
+            out.append(body);
+        }
+
+        void ZmtpPresentation::command(std::string_view name, std::string_view body){
+            std::string cmd;
+            cmd.reserve(1 + name.size() + body.size());
+            cmd.push_back(static_cast<char>(name.size()));
+            cmd.append(name);
+            cmd.append(body);
+            frame(_out, COMMAND, cmd);
+        }
+
+        void ZmtpPresentation::fail(std::errc err, std::string_view reason){
+            if(_error){
+                return;
+            }
+            _error = std::make_error_code(err);
+            // Once the greeting has been exchanged the peer is told why, before the session is closed.
+            if(_greeting_received){
+                std::string body;
+                body.push_back(static_cast<char>(reason.size()));
+                body.append(reason);
+                command("ERROR", body);
+            }
+        }
+
+        bool ZmtpPresentation::on_greeting(std::string_view greeting){
+            if(static_cast<unsigned char>(greeting[0]) != 0xff || greeting[9] != 0x7f || greeting[10] < 3){
+                fail(std::errc::protocol_not_supported, "unsupported version");
+                return false;
+            }
+            _greeting_received = true;
+            std::string_view mechanism = greeting.substr(12, 20);
+            mechanism = mechanism.substr(0, mechanism.find('\0'));
+            if(mechanism != MECHANISM){
+                fail(std::errc::protocol_not_supported, "unsupported mechanism");
+                return false;
+            }
+            return true;
+        }
+
+        void ZmtpPresentation::on_command(std::string_view body){
+            if(body.empty() || static_cast<unsigned char>(body[0]) >= body.size()){
+                fail(std::errc::protocol_error, "malformed command");
+                return;
+            }
+            std::string_view name = body.substr(1, static_cast<unsigned char>(body[0]));
+            std::string_view data = body.substr(1 + name.size());
+            if(!_ready_received){
+                if(name == "ERROR"){
+                    _error = std::make_error_code(std::errc::connection_aborted);
+                    return;
+                } else if(name != "READY"){
+                    fail(std::errc::protocol_error, "expected READY");
+                    return;
+                }
+                while(!data.empty()){
+                    std::size_t len = static_cast<unsigned char>(data[0]);
+                    if(data.size() < 1 + len + 4){
+                        fail(std::errc::protocol_error, "malformed metadata");
+                        return;
+                    }
+                    std::string_view property = data.substr(1, len);
+                    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + 1 + len);
+                    std::size_t size = static_cast<std::size_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+                    data.remove_prefix(1 + len + 4);
+                    if(data.size() < size){
+                        fail(std::errc::protocol_error, "malformed metadata");
+                        return;
+                    }
+                    // Property names are case-insensitive.
+                    if(property.size() == 11 && strncasecmp(property.data(), "Socket-Type", 11) == 0){
+                        _peer_type.assign(data.substr(0, size));
+                    }
+                    data.remove_prefix(size);
+                }
+                if(!compatible(_type, _peer_type)){
+                    fail(std::errc::protocol_error, "invalid socket type");
+                    return;
+                }
+                _ready_received = true;
+                _out.append(_queued);
+                _queued.clear();
+            } else if(name == "PING"){
+                // A PING is a 2 byte TTL followed by up to 16 bytes of context, which the PONG echoes.
+                if(data.size() < 2 || data.size() > 18){
+                    fail(std::errc::protocol_error, "malformed PING");
+                    return;
+                }
+                command("PONG", data.substr(2));
+            } else if(name == "ERROR"){
+                _error = std::make_error_code(std::errc::connection_aborted);
+            }
+            // Anything else, including PONG and SUBSCRIBE, has no meaning for these socket types.
+        }
+
+        void ZmtpPresentation::on_message(){
+            auto& messages = std::get<ZmtpMessages>(*this);
+            ZmtpMessage message = std::move(_message);
+            _message = ZmtpMessage();
+            _message_size = 0;
+            switch(_type){
+                case SocketType::REQ:
+                {
+                    // Replies start with the empty delimiter, anything else (or a reply that was not asked for) is dropped.
+                    if(!_awaiting_reply || message.frames.empty() || !message.frames.front().empty()){
+                        return;
+                    }
+                    _awaiting_reply = false;
+                    message.frames.erase(message.frames.begin());
+                    break;
+                }
+                case SocketType::REP:
+                {
+                    // The envelope is everything up to and including the empty delimiter.
+                    std::size_t delimiter = 0;
+                    while(delimiter < message.frames.size() && !message.frames[delimiter].empty()){
+                        ++delimiter;
+                    }
+                    if(delimiter == message.frames.size()){
+                        return;
+                    }
+                    ZmtpMessage envelope;
+                    envelope.frames.assign(message.frames.begin(), message.frames.begin() + delimiter + 1);
+                    envelope.buffers = message.buffers;
+                    _envelopes.push_back(std::move(envelope));
+                    message.frames.erase(message.frames.begin(), message.frames.begin() + delimiter + 1);
+                    break;
+                }
+                case SocketType::PUSH:
+                    fail(std::errc::protocol_error, "PUSH sockets do not receive");
+                    return;
+                case SocketType::PULL:
+                    break;
+            }
+            messages.push_back(std::move(message));
+        }
+
+        void ZmtpPresentation::receive(){
+            {
+                // The one copy that is made: the session buffer is reused once it has been consumed.
+                auto lk = session->lock();
+                std::string_view data = session->rbuf.data();
+                _in.append(data);
+                session->rbuf.consume(data.size());
+            }
+            if(_error){
+                _in.clear();
+                return;
+            }
+            // Frames are decoded in place: the input buffer is handed over to the messages that point into it,
+            // and only the bytes of an incomplete frame at its end are carried over to the next read.
+            auto buffer = std::make_shared<std::string>(std::move(_in));
+            _in.clear();
+            std::string_view in(*buffer);
+            std::size_t pos = 0;
+            bool shared = false;
+            std::size_t partial = 0;
+            if(!_greeting_received){
+                if(in.size() < GREETING){
+                    _in = std::move(*buffer);
+                    return;
+                }
+                if(!on_greeting(in.substr(0, GREETING))){
+                    return;
+                }
+                pos = GREETING;
+            }
+            while(!_error && in.size() - pos >= 2){
+                std::uint8_t flags = in[pos];
+                std::size_t header = (flags & LONG) ? 9 : 2;
+                if(in.size() - pos < header){
+                    break;
+                }
+                std::uint64_t len = 0;
+                if(flags & LONG){
+                    for(std::size_t i = 0; i < 8; ++i){
+                        len = len << 8 | static_cast<unsigned char>(in[pos+1+i]);
+                    }
+                } else {
+                    len = static_cast<unsigned char>(in[pos+1]);
+                }
+                // Commands are never multipart, and no command may arrive in the middle of a message.
+                if((flags & 0xf8) || ((flags & COMMAND) && ((flags & MORE) || !_message.frames.empty()))
+                    || (!(flags & COMMAND) && !_ready_received)){
+                    fail(std::errc::protocol_error, "malformed frame");
+                    break;
+                }
+                // Checked before any of the frame is buffered, this also keeps header + len from wrapping.
+                if(len > ((flags & COMMAND) ? _max_message : _max_message - _message_size)){
+                    fail(std::errc::message_size, "message too large");
+                    break;
+                }
+                if(in.size() - pos - header < len){
+                    partial = header + len;
+                    break;
+                }
+                std::string_view body = in.substr(pos + header, len);
+                pos += header + len;
+                if(flags & COMMAND){
+                    on_command(body);
+                    continue;
+                }
+                _message.frames.push_back(body);
+                _message_size += len;
+                if(!shared){
+                    _message.buffers.push_back(buffer);
+                    shared = true;
+                }
+                if(!(flags & MORE)){
+                    on_message();
+                    shared = false;
+                }
+            }
+            if(_error){
+                _in.clear();
+                _message = ZmtpMessage();
+                _message_size = 0;
+            } else if(pos == 0){
+                _in = std::move(*buffer);
+            } else {
+                _in.append(in.substr(pos));
+            }
+            // Reserve the rest of a large frame, so that it is not reallocated as it arrives.
+            if(partial > _in.capacity()){
+                _in.reserve(partial);
+            }
+        }
+
+        bool ZmtpPresentation::send(const std::vector<std::string_view>& frames){
+            auto lk = lock();
+            if(_error){
+                return false;
+            }
+            std::string& out = _ready_received ? _out : _queued;
+            const std::vector<std::string_view>* envelope = nullptr;
+            ZmtpMessage reply;
+            switch(_type){
+                case SocketType::REQ:
+                    if(_awaiting_reply){
+                        return false;
+                    }
+                    _awaiting_reply = true;
+                    frame(out, MORE, std::string_view());
+                    break;
+                case SocketType::REP:
+                    if(_envelopes.empty()){
+                        return false;
+                    }
+                    reply = std::move(_envelopes.front());
+                    _envelopes.pop_front();
+                    envelope = &reply.frames;
+                    break;
+                case SocketType::PUSH:
+                    break;
+                case SocketType::PULL:
+                    return false;
+            }
+            if(envelope){
+                for(auto f: *envelope){
+                    frame(out, MORE, f);
+                }
+            }
+            for(std::size_t i = 0; i < frames.size(); ++i){
+                frame(out, i + 1 < frames.size() ? MORE : 0, frames[i]);
+            }
+            // A message with no frames is sent as a single empty frame.
+            if(frames.empty()){
+                frame(out, 0, std::string_view());
+            }
+            return true;
+        }
+
+        bool ZmtpPresentation::flush(){
+            if(_out.empty()){
+                return false;
+            }
+            {
+                auto lk = session->lock();
+                session->wbuf.rdbuf()->sputn(_out.data(), _out.size());
+            }
+            _out.clear();
+            return true;
+        }
+
+        void ZmtpPresentation::read(){
+            auto lk = lock();
+            receive();
+            // PONGs and ERRORs are answered straight away.
+            if(flush()){
+                session->write();
+            }
+        }
+
+        void ZmtpPresentation::async_read(std::function<void(std::error_code ec)> cb){
+            session->async_read([&, cb](std::error_code ec){
+                if(!ec){
+                    read();
+                }
+                cb(ec);
+            });
+        }
+
+        void ZmtpPresentation::write(){
+            auto lk = lock();
+            flush();
+            session->write();
+        }
+
+        void ZmtpPresentation::async_write(std::function<void(std::error_code ec)> cb){
+            auto lk = lock();
+            flush();
+            session->async_write(cb);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef ZMTP_PRESENTATION_HPP
+#define ZMTP_PRESENTATION_HPP
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../presentation.hpp"
+namespace zmtp
+{
+    namespace z_presentation
+    {
+        // A multipart message.
+        // Received bytes are copied once, out of the session buffer which is reused as soon as it has been consumed.
+        // Frames are views into that copy, which the message keeps alive, so decoding does not copy a frame body again.
+        struct ZmtpMessage
+        {
+            std::vector<std::string_view> frames;
+            std::vector<std::shared_ptr<const std::string> > buffers;
+        };
+        typedef std::deque<ZmtpMessage> ZmtpMessages;
+        typedef presentation::Presentation<ZmtpMessages> Presentation;
+        typedef presentation::Presentations<ZmtpMessages> ZmtpPresentations;
+
+        /*
+        *  ZMTP 3.1 (ZeroMQ RFC 37) with the NULL security mechanism, over a single session.
+        *  The greeting and READY command are queued on construction, and sent by the first write().
+        *  Messages are held back until the peer's READY command has been read.
+        *
+        *  REQ and REP follow ZeroMQ RFC 28: a REQ sends one request at a time behind an empty delimiter frame,
+        *  and a REP answers requests in the order that they arrived, with the envelope that they arrived with.
+        *  PUSH only sends and PULL only receives (RFC 30).
+        *
+        *  read() appends every complete message to the ZmtpMessages slot, without its envelope.
+        *  send() queues a message, and returns false if the socket type does not allow it right now,
+        *  so many messages can be written to the session together.
+        *  Protocol errors, including an incompatible peer socket type, fail the presentation; error() returns the cause.
+        */
+        class ZmtpPresentation: public Presentation
+        {
+        public:
+            enum class SocketType
+            {
+                REQ,
+                REP,
+                PUSH,
+                PULL
+            };
+
+            static constexpr std::size_t GREETING = 64;
+            static constexpr std::size_t DEFAULT_MAX_MESSAGE = 16 << 20;
+
+        private:
+            SocketType _type;
+            // The longest message, summed over its frames, or command that will be received.
+            std::size_t _max_message;
+
+            // Bytes that have been read from the session but do not make up a complete frame yet.
+            std::string _in;
+            // Frames waiting to be written to the session.
+            std::string _out;
+            // Messages that were sent before the handshake completed, libzmq drops connections that send them any earlier.
+            std::string _queued;
+
+            bool _greeting_received = false;
+            bool _ready_received = false;
+            std::string _peer_type;
+            std::error_code _error;
+
+            // The message that is being received, and the envelopes of the requests that a REP has not answered yet.
+            ZmtpMessage _message;
+            std::size_t _message_size = 0;
+            std::deque<ZmtpMessage> _envelopes;
+            // A REQ has sent a request, and not received its reply.
+            bool _awaiting_reply = false;
+
+            // Queue the greeting and the READY command.
+            void handshake();
+            void frame(std::string& out, std::uint8_t flags, std::string_view body);
+            void command(std::string_view name, std::string_view body);
+            void fail(std::errc err, std::string_view reason);
+            bool on_greeting(std::string_view greeting);
+            void on_command(std::string_view body);
+            void on_message();
+            // Drain the session read buffer and decode every complete frame, the presentation lock must be held.
+            void receive();
+            bool flush();
+
+        public:
+            ZmtpPresentation(ZmtpPresentations& server, SocketType type, std::size_t max_message = DEFAULT_MAX_MESSAGE): Presentation(server), _type(type), _max_message(max_message) { handshake(); }
+            ZmtpPresentation(ZmtpPresentations& server, const std::shared_ptr<session::Session>& sp, SocketType type, std::size_t max_message = DEFAULT_MAX_MESSAGE):
+                Presentation(server, sp), _type(type), _max_message(max_message) { handshake(); }
+
+            bool send(const std::vector<std::string_view>& frames);
+
+            // The peer's READY command has been received.
+            bool ready() { auto lk = lock(); return _ready_received; }
+            std::string peer_type() { auto lk = lock(); return _peer_type; }
+            std::error_code error() { auto lk = lock(); return _error; }
+
+            void read() override;
+            void async_read(std::function<void(std::error_code ec)> cb) override;
+            void write() override;
+            void async_write(std::function<void(std::error_code ec)> cb) override;
+
+            ~ZmtpPresentation() = default;
+        };
+    }
+}
+#endif
@@ -0,0 +1,267 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <climits>
+#include <cstring>
+#include <sys/mman.h>
+#include "buffer-pool.hpp"
+#include "../metrics/counters.hpp"
+
+namespace session
+{
+    namespace
+    {
+        struct Cache
+        {
+            BufferPool* pool = nullptr;
+            std::array<std::vector<char*>, BufferPool::CLASSES> free;
+
+            ~Cache(){
+                if(pool){
+                    pool->flush();
+                }
+            }
+        };
+        thread_local Cache cache;
+    }
+
+    BufferPool& BufferPool::global(){
+        // Never destroyed, so that threads that exit during static destruction can still give their blocks back.
+        static BufferPool* pool = new BufferPool();
+        return *pool;
+    }
+
+    char* BufferPool::carve(std::size_t c){
+        std::size_t size = MIN_BLOCK << c;
+        void* slab = ::mmap(nullptr, SLAB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(slab == MAP_FAILED){
+            // Out of address space for a slab, the block is allocated instead. Like every block of a
+            // huge page pool it is never deleted, so it is safe to keep it in the free lists once given back.
+            metrics::add(metrics::Counter::BUFFER_ALLOCATED_BYTES, size);
+            return new char[size];
+        }
+        ::madvise(slab, SLAB, MADV_HUGEPAGE);
+        metrics::add(metrics::Counter::BUFFER_ALLOCATED_BYTES, SLAB);
+        char* block = static_cast<char*>(slab);
+        // The first block is returned, the rest are free.
+        for(std::size_t offset = size; offset + size <= SLAB; offset += size){
+            _free[c].push_back(block + offset);
+        }
+        return block;
+    }
+
+    char* BufferPool::borrow(std::size_t& size){
+        metrics::add(metrics::Counter::BUFFER_BORROWS);
+        if(size > MAX_BLOCK){
+            metrics::add(metrics::Counter::BUFFER_ALLOCATED_BYTES, size);
+            return new char[size];
+        }
+        std::size_t c = size_class(size);
+        size = MIN_BLOCK << c;
+        auto& local = cache.free[c];
+        if(local.empty()){
+            cache.pool = this;
+            auto lk = std::unique_lock<std::mutex>(_mtx);
+            // Every thread's first borrow of a class comes through here.
+            _used = true;
+            // Refill half of the thread cache at a time, so that a thread that only borrows takes the lock less often.
+            while(!_free[c].empty() && local.size() < THREAD_CACHE / 2){
+                local.push_back(_free[c].back());
+                _free[c].pop_back();
+            }
+            if(local.empty()){
+                if(_huge_pages){
+                    return carve(c);
+                }
+                lk.unlock();
+                metrics::add(metrics::Counter::BUFFER_ALLOCATED_BYTES, size);
+                return new char[size];
+            }
+        }
+        char* block = local.back();
+        local.pop_back();
+        return block;
+    }
+
+    bool BufferPool::huge_pages(bool on){
+        auto lk = std::unique_lock<std::mutex>(_mtx);
+        // Blocks that were carved from slabs must never be deleted, nor blocks that were allocated given to munmap.
+        if(_used){
+            return _huge_pages == on;
+        }
+        _huge_pages = on;
+        return true;
+    }
+
+    void BufferPool::give_back(char* block, std::size_t size){
+        metrics::add(metrics::Counter::BUFFER_RETURNS);
+        if(size > MAX_BLOCK){
+            metrics::add(metrics::Counter::BUFFER_FREED_BYTES, size);
+            delete[] block;
+            return;
+        }
+        std::size_t c = size_class(size);
+        auto& local = cache.free[c];
+        cache.pool = this;
+        local.push_back(block);
+        if(local.size() <= THREAD_CACHE){
+            return;
+        }
+        // Spill half of the thread cache, and free what the shared lists have no room for.
+        std::vector<char*> spill(local.end() - THREAD_CACHE / 2, local.end());
+        local.resize(local.size() - THREAD_CACHE / 2);
+        auto lk = std::unique_lock<std::mutex>(_mtx);
+        for(char* b: spill){
+            if(_huge_pages || _free[c].size() < SHARED_CACHE){
+                _free[c].push_back(b);
+            } else {
+                metrics::add(metrics::Counter::BUFFER_FREED_BYTES, size);
+                delete[] b;
+            }
+        }
+    }
+
+    void BufferPool::flush(){
+        auto lk = std::unique_lock<std::mutex>(_mtx);
+        for(std::size_t c = 0; c < CLASSES; ++c){
+            for(char* b: cache.free[c]){
+                if(_huge_pages || _free[c].size() < SHARED_CACHE){
+                    _free[c].push_back(b);
+                } else {
+                    metrics::add(metrics::Counter::BUFFER_FREED_BYTES, MIN_BLOCK << c);
+                    delete[] b;
+                }
+            }
+            cache.free[c].clear();
+        }
+    }
+
+    bool PooledBuffer::reserve(std::size_t n){
+        std::size_t unread = _block ? pptr() - gptr() : 0;
+        if(_block && static_cast<std::size_t>(epptr() - pptr()) >= n){
+            return true;
+        }
+        char* block = _block;
+        std::size_t size = _size;
+        if(!_block || unread + n > _size){
+            size = unread + n;
+            block = BufferPool::global().borrow(size);
+        }
+        // Move the unread bytes to the front of the (new) block.
+        if(unread){
+            std::memmove(block, gptr(), unread);
+        }
+        if(block != _block && _block){
+            BufferPool::global().give_back(_block, _size);
+        }
+        _block = block;
+        _size = size;
+        setg(_block, _block, _block + unread);
+        setp(_block, _block + _size);
+        put_bump(unread);
+        return true;
+    }
+
+    void PooledBuffer::drained(){
+        if(_block && gptr() == pptr()){
+            reset();
+        }
+    }
+
+    void PooledBuffer::reset(){
+        if(_block){
+            BufferPool::global().give_back(_block, _size);
+        }
+        _block = nullptr;
+        _size = 0;
+        setg(nullptr, nullptr, nullptr);
+        setp(nullptr, nullptr);
+    }
+
+    PooledBuffer::int_type PooledBuffer::underflow(){
+        if(!_block){
+            return traits_type::eof();
+        }
+        sync_get();
+        if(gptr() < egptr()){
+            return traits_type::to_int_type(*gptr());
+        }
+        reset();
+        return traits_type::eof();
+    }
+
+    PooledBuffer::int_type PooledBuffer::overflow(int_type c){
+        if(traits_type::eq_int_type(c, traits_type::eof())){
+            return traits_type::not_eof(c);
+        }
+        reserve(1);
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+        sync_get();
+        return c;
+    }
+
+    std::streamsize PooledBuffer::xsputn(const char* s, std::streamsize n){
+        if(n <= 0){
+            return 0;
+        }
+        reserve(static_cast<std::size_t>(n));
+        std::memcpy(pptr(), s, n);
+        put_bump(static_cast<std::size_t>(n));
+        sync_get();
+        return n;
+    }
+
+    std::streamsize PooledBuffer::xsgetn(char* s, std::streamsize n){
+        if(!_block || n <= 0){
+            return 0;
+        }
+        sync_get();
+        std::streamsize len = std::min<std::streamsize>(n, egptr() - gptr());
+        std::memcpy(s, gptr(), len);
+        get_bump(static_cast<std::size_t>(len));
+        drained();
+        return len;
+    }
+
+    std::streamsize PooledBuffer::showmanyc(){
+        if(!_block){
+            return 0;
+        }
+        sync_get();
+        std::streamsize len = egptr() - gptr();
+        drained();
+        return len;
+    }
+
+    void PooledBuffer::consume(std::size_t n){
+        if(!_block){
+            return;
+        }
+        sync_get();
+        get_bump(std::min<std::size_t>(n, egptr() - gptr()));
+        drained();
+    }
+
+    void PooledBuffer::put_bump(std::size_t n){
+        // pbump() takes an int, blocks larger than INT_MAX are advanced in steps.
+        for(; n > INT_MAX; n -= INT_MAX){
+            pbump(INT_MAX);
+        }
+        pbump(static_cast<int>(n));
+    }
+
+    void PooledBuffer::get_bump(std::size_t n){
+        for(; n > INT_MAX; n -= INT_MAX){
+            gbump(INT_MAX);
+        }
+        gbump(static_cast<int>(n));
+    }
+
+    void PooledBuffer::commit(std::size_t n){
+        put_bump(n);
+        sync_get();
+    }
+}
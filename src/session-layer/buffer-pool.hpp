@@ -0,0 +1,140 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace session
+{
+    /*
+    *  A pool of memory blocks in size classes (powers of two from MIN_BLOCK to MAX_BLOCK), shared by every session.
+    *  Each thread keeps a small cache of free blocks per class so that borrowing and returning a block usually
+    *  takes no lock; caches spill into, and refill from, free lists that are shared under a lock.
+    *  Sessions borrow from the global() pool.
+    *  Blocks larger than MAX_BLOCK are not pooled.
+    *  With huge_pages(true), pooled blocks are carved out of 2 MiB slabs that are advised to be backed by transparent huge pages;
+    *  those blocks are never given back to the system. It can only be changed before the first pooled block is borrowed.
+    */
+    class BufferPool
+    {
+    public:
+        static constexpr std::size_t MIN_BLOCK = 512;
+        static constexpr std::size_t MAX_BLOCK = std::size_t(1) << 20;
+        static constexpr std::size_t CLASSES = 12;
+        // Free blocks kept per class, by each thread and in the shared lists.
+        static constexpr std::size_t THREAD_CACHE = 32;
+        static constexpr std::size_t SHARED_CACHE = 1024;
+        static constexpr std::size_t SLAB = std::size_t(2) << 20;
+
+    private:
+        std::mutex _mtx;
+        std::array<std::vector<char*>, CLASSES> _free;
+        bool _huge_pages = false;
+        // A pooled block has been borrowed, from here on _huge_pages is fixed.
+        bool _used = false;
+
+        char* carve(std::size_t c);
+
+    public:
+        static BufferPool& global();
+
+        static std::size_t size_class(std::size_t size){
+            std::size_t c = 0;
+            while(c < CLASSES - 1 && (MIN_BLOCK << c) < size){
+                ++c;
+            }
+            return c;
+        }
+
+        // size is rounded up to the size of the block that is returned.
+        char* borrow(std::size_t& size);
+        void give_back(char* block, std::size_t size);
+
+        // Returns false, and changes nothing, if a pooled block has already been borrowed with the other setting.
+        bool huge_pages(bool on);
+        // Move the free blocks of the calling thread to the shared lists.
+        void flush();
+    };
+
+    /*
+    *  A stream buffer that keeps its unread bytes contiguous, in a block that is borrowed from the global BufferPool.
+    *  The block is given back as soon as everything that was written has been read, so an idle session holds none.
+    */
+    class PooledBuffer: public std::streambuf
+    {
+        char* _block = nullptr;
+        std::size_t _size = 0;
+
+        // Make room for n more bytes after the unread ones.
+        bool reserve(std::size_t n);
+        // Give the block back if everything has been read.
+        void drained();
+        // Bytes written by sputc are only seen by the get area once it is synced.
+        void sync_get() { setg(eback(), gptr(), pptr()); }
+        // pbump() and gbump() by any size.
+        void put_bump(std::size_t n);
+        void get_bump(std::size_t n);
+
+    protected:
+        int_type underflow() override;
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char* s, std::streamsize n) override;
+        std::streamsize xsgetn(char* s, std::streamsize n) override;
+        std::streamsize showmanyc() override;
+
+    public:
+        PooledBuffer() {}
+        PooledBuffer(const PooledBuffer&) = delete;
+        PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+        // The unread bytes.
+        std::string_view data() { sync_get(); return std::string_view(gptr(), pptr() - gptr()); }
+        void consume(std::size_t n);
+        // Room for n bytes after the unread ones, which commit(n) makes readable.
+        char* prepare(std::size_t n) { return reserve(n) ? pptr() : nullptr; }
+        void commit(std::size_t n);
+        // The size of the borrowed block, zero if there is none.
+        std::size_t capacity() const { return _size; }
+        // Drop everything and give the block back.
+        void reset();
+
+        ~PooledBuffer() { reset(); }
+    };
+
+    // The read and write buffers of a session: an iostream over a PooledBuffer.
+    class Buffer: public std::iostream
+    {
+        PooledBuffer _buf;
+
+    public:
+        Buffer(): std::iostream(nullptr) { rdbuf(&_buf); }
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        PooledBuffer* rdbuf() { return &_buf; }
+        using std::iostream::rdbuf;
+
+        std::string_view data() { return _buf.data(); }
+        void consume(std::size_t n) { _buf.consume(n); }
+        char* prepare(std::size_t n) { return _buf.prepare(n); }
+        void commit(std::size_t n) { _buf.commit(n); }
+        std::size_t capacity() const { return _buf.capacity(); }
+
+        // Like std::stringstream: a copy of the unread bytes, and replacing the contents.
+        std::string str() { return std::string(_buf.data()); }
+        void str(std::string_view s) {
+            _buf.reset();
+            _buf.sputn(s.data(), s.size());
+        }
+    };
+}
+#endif
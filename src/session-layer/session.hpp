@@ -11,35 +11,218 @@
 #include <functional>
 #include <system_error>
 #include <cstddef>
+#include <cstdint>
+#include <chrono>
 #include <mutex>
+#include <vector>
+#include "../metrics/counters.hpp"
+#include "buffer-pool.hpp"
+#include "timer-wheel.hpp"
 namespace session
 {
     // Forward Declarations
     class Server;
+
+    // Counts kept by each session, the same quantities are counted for the whole process by metrics::add.
+    struct Statistics
+    {
+        std::uint64_t bytes_read = 0;
+        std::uint64_t bytes_written = 0;
+        std::uint64_t reads = 0;
+        std::uint64_t writes = 0;
+        std::uint64_t rbuf_high_water = 0;
+        std::uint64_t wbuf_high_water = 0;
+
+        Statistics& operator+=(const Statistics& other){
+            bytes_read += other.bytes_read;
+            bytes_written += other.bytes_written;
+            reads += other.reads;
+            writes += other.writes;
+            rbuf_high_water = std::max(rbuf_high_water, other.rbuf_high_water);
+            wbuf_high_water = std::max(wbuf_high_water, other.wbuf_high_water);
+            return *this;
+        }
+    };
+
+    // Bytes held by the buffers of a session, and the most that they have held.
+    // A buffer only holds a block of memory while it has bytes that have not been read (see BufferPool).
+    struct Memory
+    {
+        std::uint64_t rbuf = 0;
+        std::uint64_t wbuf = 0;
+        std::uint64_t rbuf_peak = 0;
+        std::uint64_t wbuf_peak = 0;
+
+        std::uint64_t total() const { return rbuf + wbuf; }
+        // Adds up what is held, the peaks of a sum are the largest peaks of its parts.
+        Memory& operator+=(const Memory& other){
+            rbuf += other.rbuf;
+            wbuf += other.wbuf;
+            rbuf_peak = std::max(rbuf_peak, other.rbuf_peak);
+            wbuf_peak = std::max(wbuf_peak, other.wbuf_peak);
+            return *this;
+        }
+    };
+
+    // Flow control limits on the bytes waiting in a session buffer.
+    // A buffer that reaches high stays blocked until it has drained to low.
+    struct Watermarks
+    {
+        std::size_t high;
+        std::size_t low;
+    };
+
     /* 
     *  Sessions own a low level interface to the underlying transport byte stream. 
     *  Sessions present an iostream of bytes for higher level presentation layers to interpret.
     *  Sessions provide i/o operations such as read, write, and their async counterparts.
     *  Sessions are equal to each other iff they are each other. 
+    *
+    *  Sessions apply flow control to both buffers.
+    *  Once wbuf holds its high watermark, writes would block: producers should stop appending to it and ask to be resumed
+    *  with when_writable, which is called once the transport has written it down to its low watermark.
+    *  Once rbuf holds its high watermark, or while writes would block, the transport stops reading from the peer.
+    *  An async read that is started while reads are blocked is parked; one that is started after the application has
+    *  consumed rbuf down to its low watermark (and writes are not blocked) reads as usual.
+    *  Consuming rbuf does not resume a read that is already parked, only a write does: parked reads are resumed once
+    *  the transport has written wbuf down to its low watermark.
     */
     class Session: public std::enable_shared_from_this<Session>
     {
         Server& _server;
         std::mutex _mtx;
+        Memory _memory;
+        bool _write_blocked = false;
+        bool _read_blocked = false;
+        std::vector<std::function<void()> > _writable;
+        std::vector<std::function<void()> > _readable;
+        Timer _read_timer;
+        Timer _write_timer;
+
+        static void cancel(Timer& t){
+            if(t.wheel){
+                t.wheel->cancel(t);
+            }
+        }
+
+        protected:
+            // Called by the transport with the lock held after it has written.
+            // Returns the producers and the parked reads that can be resumed, to be called once the lock has been released.
+            std::vector<std::function<void()> > resumable(){
+                std::vector<std::function<void()> > resume;
+                if(wbuf.data().size() <= write_watermarks.low){
+                    _write_blocked = false;
+                    resume.swap(_writable);
+                }
+                // Once the application can write again, it can take more of what has been read.
+                if(!_write_blocked){
+                    _read_blocked = rbuf.data().size() >= read_watermarks.high;
+                    resume.insert(resume.end(), _readable.begin(), _readable.end());
+                    _readable.clear();
+                }
+                return resume;
+            }
+            // Drop the producers and the reads that are waiting to be resumed, and the deadlines, once the session has been closed.
+            void forget(){
+                auto lk = lock();
+                _writable.clear();
+                _readable.clear();
+                cancel(_read_timer);
+                cancel(_write_timer);
+            }
 
         public:
-            Session(Server& server): _server(server), rbuf(), wbuf(){}
+            Session(Server& server): _server(server), rbuf(), wbuf(){
+                _read_timer.session = this;
+                _write_timer.session = this;
+                metrics::add(metrics::Counter::SESSIONS_OPENED);
+            }
 
             virtual void read()=0;
             virtual void async_read(std::function<void(std::error_code ec)> cb)=0;
             virtual void write()=0;
             virtual void async_write(std::function<void(std::error_code ec)> cb)=0;
+            // Close the transport, e.g. once a deadline has been missed.
+            virtual void close()=0;
+            Server& server() { return _server; }
             
-            std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(_mtx); }
-            std::stringstream rbuf;
-            std::stringstream wbuf;
+            // Uncontended locks are taken without reading the clock, only the time spent waiting is measured.
+            std::unique_lock<std::mutex> lock() {
+                std::unique_lock<std::mutex> lk(_mtx, std::try_to_lock);
+                if(!lk.owns_lock()){
+                    auto start = std::chrono::steady_clock::now();
+                    lk.lock();
+                    metrics::add(metrics::Counter::LOCK_CONTENDED);
+                    metrics::add(metrics::Counter::LOCK_WAIT_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                }
+                return lk;
+            }
+            Buffer rbuf;
+            Buffer wbuf;
+            // Updated by the session with its lock held.
+            Statistics stats;
+
+            static constexpr Watermarks DEFAULT_WATERMARKS{std::size_t(1) << 20, std::size_t(256) << 10};
+            // Set before the session is used. The read high watermark must be larger than the largest message
+            // that the application needs to see in full before it can answer.
+            Watermarks write_watermarks = DEFAULT_WATERMARKS;
+            Watermarks read_watermarks = DEFAULT_WATERMARKS;
+
+            // Appending to wbuf would take it past its high watermark, the lock must be held.
+            bool write_blocked(){
+                if(!_write_blocked && wbuf.data().size() >= write_watermarks.high){
+                    _write_blocked = true;
+                    metrics::add(metrics::Counter::WRITES_BLOCKED);
+                }
+                return _write_blocked;
+            }
+            // rbuf holds more than the application has caught up with, or the application can not write its answers,
+            // the lock must be held.
+            bool read_blocked(){
+                std::size_t buffered = rbuf.data().size();
+                if(!_read_blocked && (buffered >= read_watermarks.high || write_blocked())){
+                    _read_blocked = true;
+                    metrics::add(metrics::Counter::READS_BLOCKED);
+                } else if(_read_blocked && buffered <= read_watermarks.low && !write_blocked()){
+                    _read_blocked = false;
+                }
+                return _read_blocked;
+            }
+            // Resume a producer, or a parked read, once the transport has written wbuf down to its low watermark, the lock must be held.
+            void when_writable(std::function<void()> fn) { _writable.push_back(std::move(fn)); }
+            void when_readable(std::function<void()> fn) { _readable.push_back(std::move(fn)); }
 
-            virtual ~Session() = default;            
+            // Update the peaks of the buffers, the lock must be held.
+            void account(){
+                _memory.rbuf_peak = std::max<std::uint64_t>(_memory.rbuf_peak, rbuf.capacity());
+                _memory.wbuf_peak = std::max<std::uint64_t>(_memory.wbuf_peak, wbuf.capacity());
+            }
+            Memory memory(){
+                auto lk = lock();
+                account();
+                Memory m = _memory;
+                m.rbuf = rbuf.capacity();
+                m.wbuf = wbuf.capacity();
+                return m;
+            }
+
+            // Deadlines, if the server has a TimerWheel (see Server::deadlines).
+            // Start the read deadline of a phase of the protocol (IDLE, HEADER or BODY), or stop it with NONE.
+            // IDLE is restarted every time, and BODY whenever progressed is set, i.e. some of the body has been read, as WRITE is.
+            // HEADER is only started when the phase changes, so that a peer can not put off the deadline by trickling in
+            // its headers a byte at a time.
+            void read_deadline(Deadline deadline, bool progressed = false);
+            // Called by the transport after it has written: the write deadline runs while bytes are pending
+            // and is restarted whenever some of them are written.
+            void write_deadline(bool pending, bool progressed);
+            // Called by the transport whenever something is read or written, restarts the IDLE deadline if it is running.
+            void active();
+
+            virtual ~Session() {
+                cancel(_read_timer);
+                cancel(_write_timer);
+                metrics::add(metrics::Counter::SESSIONS_CLOSED);
+            }
     };
 
     /*
@@ -50,6 +233,11 @@ namespace session
     class Server: public std::vector<std::shared_ptr<Session> >
     {
         std::mutex _mtx;
+        // The statistics of the sessions that have been closed.
+        Statistics _closed;
+        std::uint64_t _num_closed = 0;
+        TimerWheel* _timers = nullptr;
+        Timeouts _timeouts;
 
         public:
             Server(){}
@@ -59,12 +247,101 @@ namespace session
                 auto lk = lock();
                 auto it = std::find(this->cbegin(), this->cend(), sp);
                 if(it != this->cend()){
+                    {
+                        auto slk = sp->lock();
+                        _closed += sp->stats;
+                    }
+                    ++_num_closed;
                     this->erase(it);
                 }
             }
+            // Remove many sessions in a single pass.
+            void close(std::vector<std::shared_ptr<Session> > sessions){
+                std::sort(sessions.begin(), sessions.end());
+                auto lk = lock();
+                auto it = std::remove_if(this->begin(), this->end(), [&](const std::shared_ptr<Session>& sp){
+                    if(!std::binary_search(sessions.cbegin(), sessions.cend(), sp)){
+                        return false;
+                    }
+                    auto slk = sp->lock();
+                    _closed += sp->stats;
+                    ++_num_closed;
+                    return true;
+                });
+                this->erase(it, this->end());
+            }
             std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(_mtx); }
 
+            // The statistics of every session that this server has held, open or closed.
+            Statistics statistics(){
+                auto lk = lock();
+                Statistics s = _closed;
+                for(auto& sp: *this){
+                    auto slk = sp->lock();
+                    s += sp->stats;
+                }
+                return s;
+            }
+            // The buffers of the sessions that are open.
+            Memory memory(){
+                auto lk = lock();
+                Memory m;
+                for(auto& sp: *this){
+                    m += sp->memory();
+                }
+                return m;
+            }
+            // Sessions that this server has held, open or closed.
+            std::uint64_t total(){
+                auto lk = lock();
+                return size() + _num_closed;
+            }
+
+            // Close the sessions of this server that miss their deadlines, set before any sessions are opened.
+            void deadlines(TimerWheel& timers, const Timeouts& timeouts){
+                _timers = &timers;
+                _timeouts = timeouts;
+            }
+            TimerWheel* timers() { return _timers; }
+            const Timeouts& timeouts() { return _timeouts; }
+
             virtual ~Server() = default;           
     };
+
+    inline void Session::read_deadline(Deadline deadline, bool progressed){
+        TimerWheel* timers = _server.timers();
+        if(!timers){
+            return;
+        }
+        const Timeouts& t = _server.timeouts();
+        std::chrono::milliseconds after = deadline == Deadline::IDLE ? t.idle
+            : deadline == Deadline::HEADER ? t.header
+            : deadline == Deadline::BODY ? t.body
+            : std::chrono::milliseconds(0);
+        if(after.count() > 0){
+            timers->arm(_read_timer, after, deadline, deadline == Deadline::IDLE || (deadline == Deadline::BODY && progressed));
+        } else {
+            timers->cancel(_read_timer);
+        }
+    }
+
+    inline void Session::active(){
+        TimerWheel* timers = _server.timers();
+        if(timers && _server.timeouts().idle.count() > 0){
+            timers->restart(_read_timer, _server.timeouts().idle, Deadline::IDLE);
+        }
+    }
+
+    inline void Session::write_deadline(bool pending, bool progressed){
+        TimerWheel* timers = _server.timers();
+        if(!timers || _server.timeouts().write.count() == 0){
+            return;
+        }
+        if(pending){
+            timers->arm(_write_timer, _server.timeouts().write, Deadline::WRITE, progressed);
+        } else {
+            timers->cancel(_write_timer);
+        }
+    }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,450 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <new>
+#include <vector>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include "shm-session.hpp"
+namespace shm_session
+{
+    // The ring header occupies the first page of the mapping.
+    static const std::size_t HEADER = 4096;
+    static_assert(sizeof(RingHeader) <= HEADER, "the ring header must fit in a single page.");
+
+    static void signal(boost::asio::posix::stream_descriptor& efd){
+        ::eventfd_write(efd.native_handle(), 1);
+    }
+
+    static void clear(boost::asio::posix::stream_descriptor& efd){
+        eventfd_t value;
+        ::eventfd_read(efd.native_handle(), &value);
+    }
+
+    std::error_code Ring::create(std::size_t capacity){
+        if(capacity == 0 || (capacity & (capacity-1)) != 0){
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        _fd = ::memfd_create("open-osi-ring", MFD_CLOEXEC);
+        if(_fd < 0){
+            return std::error_code(errno, std::system_category());
+        }
+        _size = HEADER + capacity;
+        if(::ftruncate(_fd, _size) < 0){
+            return std::error_code(errno, std::system_category());
+        }
+        void* addr = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if(addr == MAP_FAILED){
+            return std::error_code(errno, std::system_category());
+        }
+        // ftruncate zero fills the mapping so all of the indices and flags start at zero.
+        _header = new (addr) RingHeader();
+        _header->capacity = capacity;
+        _data = static_cast<char*>(addr) + HEADER;
+        return std::error_code();
+    }
+
+    std::error_code Ring::map(int fd){
+        _fd = fd;
+        struct stat st;
+        if(::fstat(_fd, &st) < 0){
+            return std::error_code(errno, std::system_category());
+        }
+        if(static_cast<std::size_t>(st.st_size) <= HEADER){
+            return std::make_error_code(std::errc::protocol_error);
+        }
+        _size = st.st_size;
+        void* addr = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if(addr == MAP_FAILED){
+            return std::error_code(errno, std::system_category());
+        }
+        _header = static_cast<RingHeader*>(addr);
+        _data = static_cast<char*>(addr) + HEADER;
+        std::size_t capacity = _header->capacity;
+        if(capacity + HEADER != _size || (capacity & (capacity-1)) != 0){
+            return std::make_error_code(std::errc::protocol_error);
+        }
+        return std::error_code();
+    }
+
+    std::size_t Ring::write(std::streambuf& in){
+        const std::uint64_t capacity = _header->capacity;
+        std::uint64_t head = _header->head.load(std::memory_order_relaxed);
+        std::uint64_t space = capacity - (head - _header->tail.load(std::memory_order_acquire));
+        std::size_t total = 0;
+        while(space > 0){
+            // Copy up to the end of the ring, then wrap around.
+            std::size_t offset = head & (capacity-1);
+            std::size_t span = std::min(space, capacity - offset);
+            std::streamsize len = in.sgetn(_data + offset, span);
+            if(len <= 0){
+                break;
+            }
+            head += len;
+            space -= len;
+            total += len;
+            if(static_cast<std::size_t>(len) < span){
+                break;
+            }
+        }
+        _header->head.store(head, std::memory_order_release);
+        return total;
+    }
+
+    std::size_t Ring::read(std::streambuf& out){
+        const std::uint64_t capacity = _header->capacity;
+        std::uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+        std::uint64_t available = _header->head.load(std::memory_order_acquire) - tail;
+        std::size_t total = available;
+        while(available > 0){
+            std::size_t offset = tail & (capacity-1);
+            std::size_t span = std::min(available, capacity - offset);
+            out.sputn(_data + offset, span);
+            tail += span;
+            available -= span;
+        }
+        _header->tail.store(tail, std::memory_order_release);
+        return total;
+    }
+
+    void Ring::close(){
+        if(_fd >= 0){
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+
+    Ring::~Ring(){
+        if(_header != nullptr){
+            ::munmap(_header, _size);
+        }
+        if(_fd >= 0){
+            ::close(_fd);
+        }
+    }
+
+    // The fences in the wake functions pair with the fences taken before a side goes to sleep.
+    // Either the sleeper sees the new ring indices, or the waker sees the waiting flag.
+    void shmSession::wake_consumer(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto& header = _tx.header();
+        if(header.consumer_waiting.load(std::memory_order_relaxed) && header.consumer_waiting.exchange(0)){
+            signal(_tx_data);
+        }
+    }
+
+    void shmSession::wake_producer(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto& header = _rx.header();
+        if(header.producer_waiting.load(std::memory_order_relaxed) && header.producer_waiting.exchange(0)){
+            signal(_rx_space);
+        }
+    }
+
+    bool shmSession::hung_up(){
+        if(!control || control->native_handle() < 0){
+            return true;
+        }
+        struct pollfd pfd{control->native_handle(), POLLRDHUP, 0};
+        return ::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL));
+    }
+
+    void shmSession::watch(descriptor& efd, boost::asio::steady_timer& check, std::atomic<std::uint32_t>& waiting){
+        check.expires_after(HANGUP_CHECK);
+        check.async_wait([&](const boost::system::error_code& ec){
+            // The waiting flag is cleared by the peer when it wakes us, then there is nothing left to check.
+            if(ec || !waiting.load(std::memory_order_relaxed)){
+                return;
+            }
+            if(hung_up()){
+                boost::system::error_code ignored;
+                efd.cancel(ignored);
+            } else {
+                watch(efd, check, waiting);
+            }
+        });
+    }
+
+    void shmSession::read(){
+        auto lk = lock();
+        std::size_t len = _rx.read(*rbuf.rdbuf());
+        ++stats.reads;
+        metrics::add(metrics::Counter::READS);
+        if(len > 0){
+            wake_producer();
+            account();
+            std::uint64_t buffered = rbuf.rdbuf()->in_avail();
+            stats.bytes_read += len;
+            stats.rbuf_high_water = std::max<std::uint64_t>(stats.rbuf_high_water, buffered);
+            metrics::add(metrics::Counter::BYTES_READ, len);
+            metrics::peak(metrics::Peak::RBUF_BYTES, buffered);
+            active();
+        }
+    }
+
+    void shmSession::async_read(std::function<void(std::error_code ec)> cb){
+        auto& header = _rx.header();
+        if(_rx.empty()){
+            if(hung_up()){
+                boost::asio::post(_rx_data.get_executor(), [cb](){
+                    cb(std::make_error_code(std::errc::connection_aborted));
+                });
+                return;
+            }
+            header.consumer_waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(_rx.empty()){
+                _rx_data.async_wait(
+                    descriptor::wait_type::wait_read,
+                    [&, cb, self = weak_from_this()](const boost::system::error_code& ec){
+                        // Cancelled by watch() when the peer hangs up, or by the destruction of the session.
+                        if(ec && (ec != boost::asio::error::operation_aborted || self.expired())){
+                            return;
+                        }
+                        _rx_check.cancel();
+                        if(!ec){
+                            clear(_rx_data);
+                        }
+                        if(!_rx.empty()){
+                            read();
+                            cb(std::error_code());
+                        } else if(ec){
+                            _rx.header().consumer_waiting.store(0, std::memory_order_relaxed);
+                            cb(std::make_error_code(std::errc::connection_aborted));
+                        } else {
+                            // Stale wakeup, go back to sleep.
+                            async_read(cb);
+                        }
+                    }
+                );
+                watch(_rx_data, _rx_check, header.consumer_waiting);
+                return;
+            }
+            header.consumer_waiting.store(0, std::memory_order_relaxed);
+        }
+        boost::asio::post(_rx_data.get_executor(), [&, cb](){
+            read();
+            cb(std::error_code());
+        });
+    }
+
+    void shmSession::write(){
+        std::vector<std::function<void()> > resumed;
+        {
+            auto lk = lock();
+            auto& in = *wbuf.rdbuf();
+            auto& header = _tx.header();
+            account();
+            std::uint64_t buffered = in.in_avail();
+            stats.wbuf_high_water = std::max(stats.wbuf_high_water, buffered);
+            metrics::peak(metrics::Peak::WBUF_BYTES, buffered);
+            std::uint64_t total = 0;
+            while(true){
+                std::size_t len = _tx.write(in);
+                if(len > 0){
+                    wake_consumer();
+                    total += len;
+                }
+                if(in.sgetc() == std::streambuf::traits_type::eof()){
+                    break;
+                }
+                // The ring is full, write the rest once the consumer has made some space, rather than blocking the thread.
+                // What has not been written is left in wbuf, a peer that never makes space is caught by the write deadline.
+                header.producer_waiting.store(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if(!_tx.full()){
+                    header.producer_waiting.store(0, std::memory_order_relaxed);
+                    continue;
+                }
+                if(_flushing){
+                    break;
+                }
+                if(hung_up()){
+                    // The peer has gone, what is left can not be delivered.
+                    header.producer_waiting.store(0, std::memory_order_relaxed);
+                    break;
+                }
+                _flushing = true;
+                _tx_space.async_wait(
+                    descriptor::wait_type::wait_read,
+                    [&, self = weak_from_this()](const boost::system::error_code& ec){
+                        if(ec && (ec != boost::asio::error::operation_aborted || self.expired())){
+                            return;
+                        }
+                        _tx_check.cancel();
+                        {
+                            auto lk = lock();
+                            _flushing = false;
+                        }
+                        if(ec){
+                            // Cancelled by watch() when the peer hangs up, or by close().
+                            _tx.header().producer_waiting.store(0, std::memory_order_relaxed);
+                            return;
+                        }
+                        clear(_tx_space);
+                        write();
+                    }
+                );
+                watch(_tx_space, _tx_check, header.producer_waiting);
+                break;
+            }
+            ++stats.writes;
+            stats.bytes_written += total;
+            metrics::add(metrics::Counter::WRITES);
+            metrics::add(metrics::Counter::BYTES_WRITTEN, total);
+            if(total > 0){
+                active();
+            }
+            write_deadline(in.sgetc() != std::streambuf::traits_type::eof(), total > 0);
+            resumed = resumable();
+        }
+        for(auto& fn: resumed){
+            boost::asio::post(_tx_data.get_executor(), std::move(fn));
+        }
+    }
+
+    void shmSession::async_write(std::function<void(std::error_code ec)> cb){
+        auto lk = lock();
+        auto& in = *wbuf.rdbuf();
+        auto& header = _tx.header();
+        while(true){
+            if(_tx.write(in) > 0){
+                wake_consumer();
+            }
+            if(in.sgetc() == std::streambuf::traits_type::eof()){
+                break;
+            }
+            if(hung_up()){
+                boost::asio::post(_tx_data.get_executor(), [cb](){
+                    cb(std::make_error_code(std::errc::connection_aborted));
+                });
+                return;
+            }
+            header.producer_waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(_tx.full()){
+                _tx_space.async_wait(
+                    descriptor::wait_type::wait_read,
+                    [&, cb, self = weak_from_this()](const boost::system::error_code& ec){
+                        if(ec && (ec != boost::asio::error::operation_aborted || self.expired())){
+                            return;
+                        }
+                        _tx_check.cancel();
+                        if(ec){
+                            _tx.header().producer_waiting.store(0, std::memory_order_relaxed);
+                            cb(std::make_error_code(std::errc::connection_aborted));
+                            return;
+                        }
+                        clear(_tx_space);
+                        async_write(cb);
+                    }
+                );
+                watch(_tx_space, _tx_check, header.producer_waiting);
+                return;
+            }
+            header.producer_waiting.store(0, std::memory_order_relaxed);
+        }
+        boost::asio::post(_tx_data.get_executor(), [cb](){
+            cb(std::error_code());
+        });
+    }
+
+    void shmSession::close(){
+        boost::system::error_code ec;
+        for(auto efd: {&_rx_data, &_rx_space, &_tx_data, &_tx_space}){
+            efd->close(ec);
+        }
+        _rx_check.cancel();
+        _tx_check.cancel();
+        _rx.close();
+        _tx.close();
+        // The peer learns that the session has gone from the control session.
+        if(control){
+            control->close();
+        }
+        forget();
+    }
+
+    std::shared_ptr<shmSession> shmServer::open(const std::shared_ptr<unix_session::uSession>& control, std::error_code& ec, std::size_t capacity){
+        auto session = std::make_shared<shmSession>(_ioc, *this);
+        ec = session->_tx.create(capacity);
+        if(!ec){
+            ec = session->_rx.create(capacity);
+        }
+        for(auto efd: {&session->_tx_data, &session->_tx_space, &session->_rx_data, &session->_rx_space}){
+            if(ec){
+                return nullptr;
+            }
+            int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if(fd < 0){
+                ec = std::error_code(errno, std::system_category());
+            } else {
+                efd->assign(fd);
+            }
+        }
+        if(ec){
+            return nullptr;
+        }
+        // The descriptors are passed in the order:
+        // opener to acceptor ring, acceptor to opener ring, then the data and space eventfds of each ring.
+        int fds[] = {
+            session->_tx.fd(), session->_rx.fd(),
+            session->_tx_data.native_handle(), session->_tx_space.native_handle(),
+            session->_rx_data.native_handle(), session->_rx_space.native_handle()
+        };
+        ec = unix_session::send_fds(control->native_handle(), fds, sizeof(fds)/sizeof(int), true);
+        if(ec){
+            return nullptr;
+        }
+        session->control = control;
+        {
+            auto lk = lock();
+            push_back(session);
+        }
+        return session;
+    }
+    void shmServer::open(){}
+
+    std::shared_ptr<shmSession> shmServer::accept(const std::shared_ptr<unix_session::uSession>& control, std::error_code& ec){
+        std::vector<int> fds;
+        bool last = false;
+        do{
+            ec = unix_session::recv_fds(control->native_handle(), fds, last);
+        } while(!ec && !last);
+        if(!ec && fds.size() != 6){
+            ec = std::make_error_code(std::errc::protocol_error);
+        }
+        if(ec){
+            for(int fd: fds){
+                ::close(fd);
+            }
+            return nullptr;
+        }
+        auto session = std::make_shared<shmSession>(_ioc, *this);
+        // The session owns every descriptor from here on, even if mapping fails.
+        session->_rx_data.assign(fds[2]);
+        session->_rx_space.assign(fds[3]);
+        session->_tx_data.assign(fds[4]);
+        session->_tx_space.assign(fds[5]);
+        ec = session->_rx.map(fds[0]);
+        std::error_code tx_ec = session->_tx.map(fds[1]);
+        if(!ec){
+            ec = tx_ec;
+        }
+        if(ec){
+            return nullptr;
+        }
+        session->control = control;
+        {
+            auto lk = lock();
+            push_back(session);
+        }
+        return session;
+    }
+}
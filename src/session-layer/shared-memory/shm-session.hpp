@@ -0,0 +1,150 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef SHM_SESSIONS_HPP
+#define SHM_SESSIONS_HPP
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <boost/asio.hpp>
+#include "../session.hpp"
+#include "../unix-domain-sockets/unix-session.hpp"
+namespace shm_session
+{
+    // Forward Declarations
+    class shmServer;
+
+    // The control block at the start of every ring.
+    // The producer and consumer indices live on separate cache lines.
+    // The waiting flags are set by a side that is about to sleep on its eventfd,
+    // so the other side only pays for a wakeup when it is actually needed.
+    struct RingHeader
+    {
+        alignas(64) std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint64_t> tail;
+        alignas(64) std::atomic<std::uint32_t> consumer_waiting;
+        alignas(64) std::atomic<std::uint32_t> producer_waiting;
+        std::uint64_t capacity;
+    };
+
+    // A single producer, single consumer byte ring in a memfd backed shared mapping.
+    class Ring
+    {
+        int _fd;
+        RingHeader* _header;
+        char* _data;
+        std::size_t _size;
+
+        public:
+            Ring(): _fd(-1), _header(nullptr), _data(nullptr), _size(0) {}
+            Ring(const Ring&) = delete;
+            Ring& operator=(const Ring&) = delete;
+
+            // Create a new ring, capacity must be a power of two.
+            std::error_code create(std::size_t capacity);
+            // Map a ring created by the peer. The ring takes ownership of fd.
+            std::error_code map(int fd);
+            // Close the memfd, the mapping stays until the ring is destroyed.
+            void close();
+
+            // Move as many bytes as will fit from the stream buffer into the ring.
+            std::size_t write(std::streambuf& in);
+            // Move all of the bytes in the ring into the stream buffer.
+            std::size_t read(std::streambuf& out);
+
+            bool empty() { return _header->head.load(std::memory_order_acquire) == _header->tail.load(std::memory_order_relaxed); }
+            bool full() { return _header->head.load(std::memory_order_relaxed) - _header->tail.load(std::memory_order_acquire) == _header->capacity; }
+            RingHeader& header() { return *_header; }
+            int fd() { return _fd; }
+
+            ~Ring();
+    };
+
+    /*
+    *  Shared memory sessions move bytes through a pair of shared memory rings, one per direction,
+    *  so that same host peers never copy their data through the kernel.
+    *  The rings and the eventfds used for wakeups are exchanged over an existing Unix domain session (see shmServer).
+    *  A side only sleeps on (and is only woken through) an eventfd when its ring is empty (or full),
+    *  a busy session never makes a system call.
+    *  A side that is waiting on its peer checks every HANGUP_CHECK that the control session has not been shut down,
+    *  and fails with connection_aborted once it has, rather than waiting forever.
+    *  write() never blocks: whatever does not fit in a full ring is left in wbuf and written once the peer makes space.
+    */
+    class shmSession: public session::Session
+    {
+        typedef boost::asio::posix::stream_descriptor descriptor;
+        friend class shmServer;
+
+        Ring _rx;
+        Ring _tx;
+        // Signalled by the peer when there is data in _rx.
+        descriptor _rx_data;
+        // Signalled by us when there is space in _rx.
+        descriptor _rx_space;
+        // Signalled by us when there is data in _tx.
+        descriptor _tx_data;
+        // Signalled by the peer when there is space in _tx.
+        descriptor _tx_space;
+        // Check on the peer while waiting on _rx_data and _tx_space.
+        boost::asio::steady_timer _rx_check;
+        boost::asio::steady_timer _tx_check;
+        // A wait for the peer to make space in _tx is pending, the session lock must be held.
+        bool _flushing = false;
+
+        void wake_consumer();
+        void wake_producer();
+        // True once the control session has been shut down by the peer, or closed.
+        bool hung_up();
+        // Cancel the wait on efd if the peer hangs up while waiting is set.
+        void watch(descriptor& efd, boost::asio::steady_timer& check, std::atomic<std::uint32_t>& waiting);
+
+        public:
+            // How often a waiting session checks that the peer is still there.
+            static constexpr std::chrono::milliseconds HANGUP_CHECK{250};
+
+            shmSession(boost::asio::io_context& ioc, session::Server& server):
+                session::Session(server), _rx_data(ioc), _rx_space(ioc), _tx_data(ioc), _tx_space(ioc), _rx_check(ioc), _tx_check(ioc) {}
+
+            void read() override;
+            void async_read(std::function<void(std::error_code ec)> cb) override;
+
+            void write() override;
+            void async_write(std::function<void(std::error_code ec)> cb) override;
+            // Close the eventfds and the control session, so that the peer sees the session go.
+            void close() override;
+
+            // The Unix domain session that the rings were exchanged over.
+            // Its closure can be used to detect that the peer has gone away.
+            std::shared_ptr<unix_session::uSession> control;
+
+            ~shmSession() = default;
+    };
+
+    /*
+    *  Servers aggregate and hold all sessions of the same type together.
+    *  Servers manage the lifetime of network sessions.
+    *  This means that servers must implement methods to open, maintain, and close network sessions.
+    *
+    *  One side of a connected Unix domain session calls open() which creates the rings and eventfds and
+    *  passes them to the peer, the other side calls accept() to receive them.
+    */
+    class shmServer: public session::Server
+    {
+        boost::asio::io_context& _ioc;
+
+        public:
+            static constexpr std::size_t DEFAULT_CAPACITY = 65536;
+
+            shmServer(boost::asio::io_context& ioc): _ioc(ioc) {}
+
+            std::shared_ptr<shmSession> open(const std::shared_ptr<unix_session::uSession>& control, std::error_code& ec, std::size_t capacity = DEFAULT_CAPACITY);
+            void open() override;
+
+            std::shared_ptr<shmSession> accept(const std::shared_ptr<unix_session::uSession>& control, std::error_code& ec);
+
+            ~shmServer() = default;
+    };
+}
+#endif
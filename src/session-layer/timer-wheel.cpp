@@ -0,0 +1,140 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "timer-wheel.hpp"
+#include "session.hpp"
+
+namespace session
+{
+    TimerWheel::TimerWheel(boost::asio::io_context& ioc, std::chrono::milliseconds tick):
+        _timer(ioc),
+        _tick(std::max(tick, std::chrono::milliseconds(1))),
+        _start(std::chrono::steady_clock::now())
+    {
+        for(auto& head: _slots){
+            head.prev = &head;
+            head.next = &head;
+        }
+        schedule();
+    }
+
+    void TimerWheel::unlink(Timer& t){
+        t.prev->next = t.next;
+        t.next->prev = t.prev;
+        t.prev = nullptr;
+        t.next = nullptr;
+        t.deadline = Deadline::NONE;
+        --_size;
+    }
+
+    std::uint64_t TimerWheel::expiry(std::chrono::milliseconds after){
+        // The first tick that is at least after from now.
+        auto due = std::chrono::steady_clock::now() - _start + after;
+        return (due + _tick - std::chrono::nanoseconds(1)) / _tick;
+    }
+
+    void TimerWheel::link(Timer& t, std::uint64_t expiry, Deadline deadline){
+        t.wheel = this;
+        t.deadline = deadline;
+        t.expiry = std::max(expiry, _now + 1);
+        Timer& head = _slots[t.expiry % SLOTS];
+        t.prev = head.prev;
+        t.next = &head;
+        head.prev->next = &t;
+        head.prev = &t;
+        ++_size;
+    }
+
+    void TimerWheel::arm(Timer& t, std::chrono::milliseconds after, Deadline deadline, bool restart){
+        std::uint64_t e = expiry(after);
+        std::lock_guard<std::mutex> lk(_mtx);
+        if(t.armed()){
+            if(!restart && t.deadline == deadline){
+                return;
+            }
+            unlink(t);
+        }
+        link(t, e, deadline);
+    }
+
+    void TimerWheel::restart(Timer& t, std::chrono::milliseconds after, Deadline deadline){
+        std::uint64_t e = expiry(after);
+        std::lock_guard<std::mutex> lk(_mtx);
+        if(t.armed() && t.deadline == deadline){
+            unlink(t);
+            link(t, e, deadline);
+        }
+    }
+
+    void TimerWheel::cancel(Timer& t){
+        std::lock_guard<std::mutex> lk(_mtx);
+        if(t.armed()){
+            unlink(t);
+        }
+    }
+
+    void TimerWheel::schedule(){
+        _timer.expires_at(_start + _tick * (_now + 1));
+        _timer.async_wait([&](const boost::system::error_code& ec){
+            if(!ec){
+                tick();
+            }
+        });
+    }
+
+    void TimerWheel::tick(){
+        std::vector<std::shared_ptr<Session> > expired;
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            std::uint64_t target = (std::chrono::steady_clock::now() - _start) / _tick;
+            // Catch up on the ticks that have been missed, a full turn visits every slot.
+            std::uint64_t steps = std::min<std::uint64_t>(target > _now ? target - _now : 0, SLOTS);
+            for(std::uint64_t i = 1; i <= steps; ++i){
+                Timer& head = _slots[(_now + i) % SLOTS];
+                for(Timer* t = head.next; t != &head;){
+                    Timer* next = t->next;
+                    if(t->expiry <= target){
+                        unlink(*t);
+                        // A session that is being destroyed cancels its own timers.
+                        if(auto sp = t->session->weak_from_this().lock()){
+                            expired.push_back(std::move(sp));
+                        }
+                    }
+                    t = next;
+                }
+            }
+            _now = std::max(_now, target);
+        }
+        if(!expired.empty()){
+            // Both deadlines of a session can expire on the same tick.
+            std::sort(expired.begin(), expired.end());
+            expired.erase(std::unique(expired.begin(), expired.end()), expired.end());
+            std::map<Server*, std::vector<std::shared_ptr<Session> > > servers;
+            for(auto& sp: expired){
+                metrics::add(metrics::Counter::SESSIONS_TIMED_OUT);
+                sp->close();
+                servers[&sp->server()].push_back(sp);
+            }
+            for(auto& [server, sessions]: servers){
+                server->close(std::move(sessions));
+            }
+        }
+        schedule();
+    }
+
+    TimerWheel::~TimerWheel(){
+        std::lock_guard<std::mutex> lk(_mtx);
+        for(auto& head: _slots){
+            while(head.next != &head){
+                Timer* t = head.next;
+                unlink(*t);
+                t->wheel = nullptr;
+            }
+        }
+    }
+}
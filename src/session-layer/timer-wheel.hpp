@@ -0,0 +1,109 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+namespace session
+{
+    // Forward Declarations
+    class Session;
+    class TimerWheel;
+
+    // The deadlines of a session. The read deadline follows the phases of the protocol, the write deadline
+    // runs while the peer is not taking what is waiting to be written.
+    enum class Deadline
+    {
+        NONE,
+        // Nothing has been read or written, e.g. a keep-alive connection between requests.
+        IDLE,
+        // A request has started but its headers are not complete.
+        HEADER,
+        // The headers of a request are complete but its body is not.
+        BODY,
+        // The write buffer has not drained.
+        WRITE
+    };
+
+    // How long each deadline runs for, zero disables it.
+    struct Timeouts
+    {
+        std::chrono::milliseconds idle{0};
+        std::chrono::milliseconds header{0};
+        std::chrono::milliseconds body{0};
+        std::chrono::milliseconds write{0};
+    };
+
+    // A deadline in a TimerWheel, embedded in the session that it belongs to.
+    struct Timer
+    {
+        Timer* prev = nullptr;
+        Timer* next = nullptr;
+        TimerWheel* wheel = nullptr;
+        Session* session = nullptr;
+        std::uint64_t expiry = 0;
+        Deadline deadline = Deadline::NONE;
+
+        bool armed() const { return next != nullptr; }
+    };
+
+    /*
+    *  A hashed timer wheel that closes the sessions that miss their deadlines.
+    *  Timers hash into one of SLOTS slots by the tick that they expire on, each slot is an intrusive list,
+    *  so arming, re-arming and cancelling a timer is O(1) and never allocates.
+    *  Once per tick a single steady_timer on the io_context visits the next slot and expires what is due;
+    *  timers that are due on a later turn of the wheel stay where they are.
+    *  Expired sessions are closed, then removed from their servers in one pass per server (see Server::close).
+    *
+    *  There should be one wheel per io_context thread, made before the sessions that use it and destroyed after them.
+    *  Timers can be armed and cancelled from any thread.
+    */
+    class TimerWheel
+    {
+    public:
+        static constexpr std::size_t SLOTS = 512;
+        static constexpr std::chrono::milliseconds DEFAULT_TICK{100};
+
+    private:
+        boost::asio::steady_timer _timer;
+        std::chrono::milliseconds _tick;
+        std::chrono::steady_clock::time_point _start;
+        std::mutex _mtx;
+        // The head of the list of each slot.
+        std::array<Timer, SLOTS> _slots;
+        // The last tick that has been visited.
+        std::uint64_t _now = 0;
+        std::size_t _size = 0;
+
+        std::uint64_t expiry(std::chrono::milliseconds after);
+        void link(Timer& t, std::uint64_t expiry, Deadline deadline);
+        void unlink(Timer& t);
+        void schedule();
+        void tick();
+
+    public:
+        TimerWheel(boost::asio::io_context& ioc, std::chrono::milliseconds tick = DEFAULT_TICK);
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        // Arm, or re-arm, a timer to expire after at least after (rounded up to a tick).
+        // Unless restart is set, a timer that is already armed for the same deadline is left as it is.
+        void arm(Timer& t, std::chrono::milliseconds after, Deadline deadline, bool restart = true);
+        // Restart a timer that is armed for deadline, and leave any other timer as it is.
+        void restart(Timer& t, std::chrono::milliseconds after, Deadline deadline);
+        void cancel(Timer& t);
+        // The number of armed timers.
+        std::size_t size() { std::lock_guard<std::mutex> lk(_mtx); return _size; }
+
+        ~TimerWheel();
+    };
+}
+#endif
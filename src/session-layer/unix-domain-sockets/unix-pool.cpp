@@ -0,0 +1,120 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "unix-pool.hpp"
+namespace unix_session
+{
+    void uPool::discard(const std::shared_ptr<uSession>& session){
+        session->close();
+        _server.close(session);
+    }
+
+    void uPool::connect(const std::string& key, uPool::handler fn){
+        _server.async_open(uPool::endpoint(key), [&, key, fn](const std::error_code& ec, std::shared_ptr<uSession> session){
+            if(ec){
+                // The endpoint can not be reached, so fail everything that is waiting on it as well.
+                std::deque<uPool::handler> waiters;
+                {
+                    auto lk = lock();
+                    auto& entry = _entries[key];
+                    --entry.total;
+                    waiters.swap(entry.waiters);
+                }
+                fn(ec, nullptr);
+                for(auto& waiter: waiters){
+                    waiter(ec, nullptr);
+                }
+                return;
+            }
+            {
+                auto lk = lock();
+                _keys[key_type(session)] = key;
+            }
+            fn(ec, session);
+        });
+    }
+
+    void uPool::checkout(const uPool::endpoint& endpoint, uPool::handler fn){
+        std::string key = endpoint.path();
+        std::shared_ptr<uSession> session;
+        std::vector<std::shared_ptr<uSession> > unhealthy;
+        bool open = false;
+        {
+            auto lk = lock();
+            auto& entry = _entries[key];
+            // The most recently used session is the most likely to still be alive.
+            while(!session && !entry.idle.empty()){
+                auto candidate = std::move(entry.idle.back());
+                entry.idle.pop_back();
+                if(candidate->healthy()){
+                    session = std::move(candidate);
+                } else {
+                    --entry.total;
+                    _keys.erase(key_type(candidate));
+                    unhealthy.push_back(std::move(candidate));
+                }
+            }
+            if(!session){
+                if(entry.total < _options.max_total){
+                    ++entry.total;
+                    open = true;
+                } else {
+                    entry.waiters.push_back(fn);
+                }
+            }
+        }
+        for(auto& sp: unhealthy){
+            discard(sp);
+        }
+        if(session){
+            boost::asio::post(_ioc, [fn, session](){ fn(std::error_code(), session); });
+        } else if(open){
+            connect(key, fn);
+        }
+    }
+
+    void uPool::checkin(const std::shared_ptr<session::Session>& sp, bool reusable){
+        auto session = std::static_pointer_cast<uSession>(sp);
+        uPool::handler waiter;
+        std::string key;
+        bool open = false;
+        {
+            auto lk = lock();
+            auto it = _keys.find(key_type(session));
+            if(it == _keys.end()){
+                // This session was not opened by the pool.
+                return;
+            }
+            key = it->second;
+            auto& entry = _entries[key];
+            if(reusable && !entry.waiters.empty()){
+                // Hand the session straight to the next request.
+                waiter = std::move(entry.waiters.front());
+                entry.waiters.pop_front();
+            } else if(reusable && entry.idle.size() < _options.max_idle){
+                entry.idle.push_back(session);
+                return;
+            } else {
+                --entry.total;
+                _keys.erase(it);
+                if(!entry.waiters.empty()){
+                    // Replace the closed session for the next request.
+                    waiter = std::move(entry.waiters.front());
+                    entry.waiters.pop_front();
+                    ++entry.total;
+                    open = true;
+                }
+            }
+        }
+        if(open){
+            discard(session);
+            connect(key, waiter);
+        } else if(waiter){
+            boost::asio::post(_ioc, [waiter, session](){ waiter(std::error_code(), session); });
+        } else {
+            discard(session);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef UNIX_SESSION_POOL_HPP
+#define UNIX_SESSION_POOL_HPP
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "unix-session.hpp"
+namespace unix_session
+{
+    /*
+    *  Pools keep connected client sessions so that they can be reused.
+    *  Sessions are keyed by the endpoint that they are connected to, and are opened through a uServer
+    *  with an asynchronous connect.
+    *
+    *  checkout() hands out the most recently used idle session that passes a health check,
+    *  opens a new session if there is none and max_total has not been reached,
+    *  or queues the request until a session is checked back in.
+    *  checkin() returns a session to the pool. Sessions that are not reusable, or that would exceed max_idle, are closed.
+    *
+    *  Handlers are never called from inside checkout() or checkin().
+    */
+    class uPool
+    {
+        public:
+            typedef boost::asio::local::stream_protocol::endpoint endpoint;
+            typedef std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> handler;
+
+            struct Options
+            {
+                // The maximum number of idle sessions kept per endpoint.
+                std::size_t max_idle = 8;
+                // The maximum number of sessions per endpoint, idle or checked out.
+                std::size_t max_total = 64;
+            };
+
+        private:
+            struct Entry
+            {
+                std::vector<std::shared_ptr<uSession> > idle;
+                std::deque<handler> waiters;
+                std::size_t total = 0;
+            };
+
+            boost::asio::io_context& _ioc;
+            uServer& _server;
+            Options _options;
+            std::map<std::string, Entry> _entries;
+            // The endpoint of every session that the pool has opened.
+            // Keyed by owner rather than by address, so that a new session allocated where a destroyed one was
+            // does not inherit its endpoint.
+            typedef std::weak_ptr<session::Session> key_type;
+            std::map<key_type, std::string, std::owner_less<key_type> > _keys;
+            std::mutex _mtx;
+
+            void connect(const std::string& key, handler fn);
+            void discard(const std::shared_ptr<uSession>& session);
+
+        public:
+            uPool(boost::asio::io_context& ioc, uServer& server): _ioc(ioc), _server(server) {}
+            uPool(boost::asio::io_context& ioc, uServer& server, const Options& options): _ioc(ioc), _server(server), _options(options) {}
+
+            void checkout(const endpoint& endpoint, handler fn);
+            void checkin(const std::shared_ptr<session::Session>& session, bool reusable);
+
+            // An adapter that checks sessions back in to this pool.
+            // It can be assigned to HttpClientPresentation::release so that sessions
+            // are returned as soon as a response has been read.
+            std::function<void(const std::shared_ptr<session::Session>& session, bool reusable)> releaser(){
+                return [this](const std::shared_ptr<session::Session>& session, bool reusable){ checkin(session, reusable); };
+            }
+
+            std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(_mtx); }
+
+            ~uPool() = default;
+    };
+}
+#endif
@@ -0,0 +1,278 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <string_view>
+#include <filesystem>
+#include <array>
+#include <vector>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include "unix-seqpacket.hpp"
+#include "../../metrics/trace.hpp"
+namespace unix_session
+{
+    uSeqServer::endpoint uSeqServer::make_endpoint(const std::string& path){
+        boost::asio::local::stream_protocol::endpoint local(path);
+        return uSeqServer::endpoint(local.data(), local.size());
+    }
+
+    std::error_code uSeqSession::receive(){
+        // Receive buffers are shared by all of the sessions on a thread.
+        thread_local std::vector<char> buf(BATCH*MAX_MESSAGE);
+        std::array<struct mmsghdr, BATCH> msgs;
+        std::array<struct iovec, BATCH> iovs;
+        metrics::Span span(metrics::Event::READ, this);
+        std::uint64_t total = 0;
+        bool truncated = false;
+        bool blocked = false;
+        int len;
+        do{
+            for(std::size_t i = 0; i < BATCH; ++i){
+                iovs[i] = {buf.data() + i*MAX_MESSAGE, MAX_MESSAGE};
+                msgs[i] = {};
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            len = ::recvmmsg(native_handle(), msgs.data(), BATCH, MSG_DONTWAIT, nullptr);
+            metrics::add(metrics::Counter::READS);
+            if(len > 0){
+                bool empty = false;
+                {
+                    auto lk = lock();
+                    ++stats.reads;
+                    std::uint64_t batch = 0;
+                    for(int i = 0; i < len; ++i){
+                        std::size_t mlen = msgs[i].msg_len;
+                        if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC){
+                            // The rest of the message is lost, but the whole messages around it are still delivered.
+                            truncated = true;
+                            continue;
+                        }
+                        if(mlen == 0){
+                            // Either an empty message, which carries nothing, or the end of the stream.
+                            empty = true;
+                            continue;
+                        }
+                        const char* data = buf.data() + i*MAX_MESSAGE;
+                        if(message_mode){
+                            rmsgs.emplace_back(data, mlen);
+                        } else {
+                            rbuf << std::string_view(data, mlen);
+                        }
+                        batch += mlen;
+                    }
+                    account();
+                    std::uint64_t buffered = rbuf.rdbuf()->in_avail();
+                    stats.bytes_read += batch;
+                    total += batch;
+                    stats.rbuf_high_water = std::max<std::uint64_t>(stats.rbuf_high_water, buffered);
+                    metrics::add(metrics::Counter::BYTES_READ, batch);
+                    metrics::peak(metrics::Peak::RBUF_BYTES, buffered);
+                    if(batch > 0){
+                        active();
+                    }
+                    // Leave the rest in the socket, so that the peer is held back until the application catches up.
+                    blocked = read_blocked();
+                }
+                // Once the peer has shut down and its messages have been drained, recvmmsg fills the rest of
+                // the batch with zero length entries, so a batch that ends in one is the end of the stream.
+                if(empty && msgs[len-1].msg_len == 0){
+                    struct pollfd pfd{native_handle(), POLLRDHUP, 0};
+                    if(::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP))){
+                        span.end(total);
+                        OSI_PROBE(read, this, native_handle(), total);
+                        return std::make_error_code(std::errc::connection_aborted);
+                    }
+                }
+            }
+            // A short batch means that the receive queue has been drained.
+        } while(!truncated && !blocked && (len == static_cast<int>(BATCH) || (len < 0 && errno == EINTR)));
+        span.end(total);
+        OSI_PROBE(read, this, native_handle(), total);
+        if(truncated){
+            return std::make_error_code(std::errc::message_size);
+        }
+        if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+            return std::error_code(errno, std::system_category());
+        }
+        return std::error_code();
+    }
+
+    void uSeqSession::read(){
+        receive();
+    }
+
+    void uSeqSession::async_read(std::function<void(std::error_code ec)> cb){
+        {
+            auto lk = lock();
+            if(read_blocked()){
+                when_readable([cb](){ cb(std::error_code()); });
+                return;
+            }
+        }
+        _socket.async_wait(
+            uSeqSession::socket::wait_type::wait_read,
+            [&, cb, self = weak_from_this()](const boost::system::error_code& ec){
+                if(!ec){
+                    metrics::trace(metrics::Event::WAKEUP, this);
+                    // The socket stays readable once the peer has gone, so that has to be reported
+                    // or the caller would wait for the next read forever.
+                    cb(receive());
+                } else if(!self.expired()){
+                    // Cancelled by close(), the caller still has to learn that the session has ended.
+                    cb(std::error_code(ec.value(), std::system_category()));
+                }
+            }
+        );
+    }
+
+    std::vector<std::function<void()> > uSeqSession::flush(){
+        std::array<struct mmsghdr, BATCH> msgs;
+        std::array<struct iovec, BATCH> iovs;
+        metrics::Span span(metrics::Event::WRITE, this);
+        std::uint64_t total = 0;
+        while(!wmsgs.empty()){
+            std::size_t n = std::min(BATCH, wmsgs.size());
+            for(std::size_t i = 0; i < n; ++i){
+                iovs[i] = {wmsgs[i].data(), wmsgs[i].size()};
+                msgs[i] = {};
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int len = ::sendmmsg(native_handle(), msgs.data(), n, MSG_DONTWAIT | MSG_NOSIGNAL);
+            metrics::add(metrics::Counter::WRITES);
+            ++stats.writes;
+            if(len < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                if((errno == EAGAIN || errno == EWOULDBLOCK) && !_flushing){
+                    // The peer is not keeping up, send the rest once the socket is writable.
+                    _flushing = true;
+                    _socket.async_wait(
+                        uSeqSession::socket::wait_type::wait_write,
+                        [&](const boost::system::error_code& ec){
+                            if(ec){
+                                return;
+                            }
+                            std::vector<std::function<void()> > resumed;
+                            {
+                                auto lk = lock();
+                                _flushing = false;
+                                resumed = flush();
+                            }
+                            post(std::move(resumed));
+                        }
+                    );
+                }
+                // Otherwise the peer has gone and what is left can not be delivered.
+                break;
+            }
+            std::uint64_t sent = 0;
+            for(int i = 0; i < len; ++i){
+                sent += msgs[i].msg_len;
+            }
+            wmsgs.erase(wmsgs.begin(), wmsgs.begin() + len);
+            stats.bytes_written += sent;
+            total += sent;
+            metrics::add(metrics::Counter::BYTES_WRITTEN, sent);
+        }
+        if(total > 0){
+            active();
+        }
+        write_deadline(!wmsgs.empty(), total > 0);
+        span.end(total);
+        OSI_PROBE(write, this, native_handle(), total);
+        return resumable();
+    }
+
+    void uSeqSession::post(std::vector<std::function<void()> > fns){
+        for(auto& fn: fns){
+            boost::asio::post(_socket.get_executor(), std::move(fn));
+        }
+    }
+
+    void uSeqSession::write(){
+        std::vector<std::function<void()> > resumed;
+        {
+            auto lk = lock();
+            account();
+            std::uint64_t buffered = wbuf.rdbuf()->in_avail();
+            stats.wbuf_high_water = std::max(stats.wbuf_high_water, buffered);
+            metrics::peak(metrics::Peak::WBUF_BYTES, buffered);
+            // The contents of wbuf are sent as a single message, split only if it exceeds MAX_MESSAGE.
+            std::string msg;
+            msg.resize(MAX_MESSAGE);
+            // sgetn, unlike readsome, does not stop at the end of the current get area.
+            auto rlen = wbuf.rdbuf()->sgetn(msg.data(), MAX_MESSAGE);
+            while(rlen > 0){
+                msg.resize(rlen);
+                wmsgs.push_back(std::move(msg));
+                msg.resize(MAX_MESSAGE);
+                rlen = wbuf.rdbuf()->sgetn(msg.data(), MAX_MESSAGE);
+            }
+            resumed = flush();
+        }
+        post(std::move(resumed));
+    }
+
+    void uSeqSession::async_write(std::function<void(std::error_code ec)> cb){
+        _socket.async_wait(
+            uSeqSession::socket::wait_type::wait_write,
+            [&, cb, self = weak_from_this()](const boost::system::error_code& ec){
+                if(!ec){
+                    write();
+                    cb(std::error_code(ec.value(), std::system_category()));
+                } else if(!self.expired()){
+                    cb(std::error_code(ec.value(), std::system_category()));
+                }
+            }
+        );
+    }
+
+    void uSeqSession::close(){
+        metrics::trace(metrics::Event::CLOSE, this);
+        OSI_PROBE(session__close, this, native_handle());
+        boost::system::error_code ec;
+        _socket.close(ec);
+        forget();
+    }
+
+    void uSeqServer::open(const uSeqServer::endpoint& endpoint){
+        uSeqServer::socket socket(_ioc);
+        socket.connect(endpoint);
+        socket.non_blocking(true);
+        std::shared_ptr<uSeqSession> session = std::make_shared<uSeqSession>(std::move(socket), *this);
+        {
+            auto lk = lock();
+            push_back(session);
+        }
+    }
+    void uSeqServer::open(){}
+
+    void uSeqServer::accept(std::function<void(const std::error_code& ec, std::shared_ptr<uSeqSession> session)> fn){
+        _acceptor.async_accept([&, fn](const boost::system::error_code& ec, uSeqServer::socket socket){
+            if(!ec){
+                socket.non_blocking(true);
+                std::shared_ptr<uSeqSession> session = std::make_shared<uSeqSession>(std::move(socket), *this);
+                {
+                    auto lk = lock();
+                    push_back(session);
+                }
+                std::error_code errc(ec.value(), std::system_category());
+                fn(errc, session);
+                accept(fn);
+            }
+        });
+    }
+
+    uSeqServer::~uSeqServer(){
+        if(!_path.empty()){
+            std::filesystem::path p(_path);
+            std::filesystem::remove(p);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef UNIX_SEQPACKET_SESSIONS_HPP
+#define UNIX_SEQPACKET_SESSIONS_HPP
+#include <deque>
+#include <string>
+#include <boost/asio.hpp>
+#include "../session.hpp"
+#include "../../metrics/probes.hpp"
+namespace unix_session
+{
+    /*
+    *  Sequenced packet sessions are Unix domain sessions (SOCK_SEQPACKET) that preserve message boundaries in the kernel.
+    *  Messages are moved in batches of up to BATCH messages per sendmmsg/recvmmsg system call.
+    *
+    *  Two interfaces are available:
+    *  1) The stream interface inherited from session::Session. wbuf is sent as one message (split into MAX_MESSAGE sized pieces),
+    *     and received messages are appended to rbuf. This makes the session a drop in replacement for uSession.
+    *  2) The message interface. Messages pushed onto wmsgs are sent one message per element.
+    *     If message_mode is set, received messages are pushed onto rmsgs instead of rbuf, one element per message.
+    */
+    class uSeqSession: public session::Session
+    {
+        public:
+            typedef boost::asio::generic::seq_packet_protocol protocol;
+            typedef protocol::socket socket;
+
+            // The largest message that can be received without truncation.
+            static constexpr std::size_t MAX_MESSAGE = 65536;
+            // The maximum number of messages moved by a single system call.
+            static constexpr std::size_t BATCH = 16;
+
+        private:
+            socket _socket;
+            // Set while waiting for the socket to take the rest of wmsgs.
+            bool _flushing = false;
+
+            // Receive everything that is queued on the socket, up to the read high watermark.
+            // Fails with connection_aborted once the peer has shut down, and with message_size if a message was truncated,
+            // once the whole messages received with it have been delivered.
+            std::error_code receive();
+            // Send as many queued messages as the socket will take, and the rest once it is writable again.
+            // The session lock must be held, returns what the flow control has resumed (see Session::resumable).
+            std::vector<std::function<void()> > flush();
+            // Call what the flow control has resumed, without the session lock.
+            void post(std::vector<std::function<void()> > fns);
+
+        public:
+            uSeqSession(socket&& socket, session::Server& server): session::Session(server), _socket(std::move(socket)) {
+                OSI_PROBE(session__open, this, _socket.native_handle());
+            }
+
+            void read() override;
+            void async_read(std::function<void(std::error_code ec)> cb) override;
+
+            void write() override;
+            void async_write(std::function<void(std::error_code ec)> cb) override;
+
+            int native_handle() { return _socket.native_handle(); }
+            void close() override;
+
+            bool message_mode = false;
+            std::deque<std::string> rmsgs;
+            std::deque<std::string> wmsgs;
+
+            ~uSeqSession() = default;
+    };
+
+    /*
+    *  Servers aggregate and hold all sessions of the same type together.
+    *  Servers manage the lifetime of network sessions.
+    *  This means that servers must implement methods to open, maintain, and close network sessions.
+    */
+    class uSeqServer: public session::Server
+    {
+        public:
+            typedef uSeqSession::protocol protocol;
+            typedef protocol::endpoint endpoint;
+            typedef boost::asio::basic_socket_acceptor<protocol> acceptor;
+            typedef protocol::socket socket;
+
+            // Build a seqpacket endpoint from a filesystem path.
+            static endpoint make_endpoint(const std::string& path);
+
+        private:
+            boost::asio::io_context& _ioc;
+            std::string _path;
+            acceptor _acceptor;
+
+        public:
+            uSeqServer(boost::asio::io_context& ioc): _ioc(ioc), _acceptor(ioc) {}
+            uSeqServer(boost::asio::io_context& ioc, const std::string& path): _ioc(ioc), _path(path), _acceptor(ioc, make_endpoint(path)) {}
+
+            void open(const endpoint& endpoint);
+            void open() override;
+
+            void accept(std::function<void(const std::error_code& ec, std::shared_ptr<uSeqSession> session)> fn);
+
+            ~uSeqServer();
+    };
+}
+#endif
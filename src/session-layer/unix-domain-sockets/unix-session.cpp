@@ -5,69 +5,313 @@
  */
 #include <string_view>
 #include <filesystem>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
 #include "unix-session.hpp"
+#include "../../metrics/trace.hpp"
 namespace unix_session
 {
     static const std::size_t PAGE = 4096;
 
-    void uSession::read(){
+    // File descriptor messages carry a fixed header in the payload and
+    // up to MAX_FDS file descriptors as SCM_RIGHTS ancillary data.
+    struct FdHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t nfds;
+        std::uint32_t last;
+    };
+    static const std::uint32_t FD_MAGIC = 0x4f534931;
+
+    // Sockets are non-blocking, wait until the socket is ready instead of failing with EAGAIN.
+    static bool wait_ready(int sock, short events){
+        if(errno != EAGAIN && errno != EWOULDBLOCK){
+            return false;
+        }
+        struct pollfd pfd{sock, events, 0};
+        return ::poll(&pfd, 1, -1) >= 0 || errno == EINTR;
+    }
+
+    std::error_code send_fds(int sock, const int* fds, std::size_t nfds, bool last){
+        FdHeader hdr{FD_MAGIC, static_cast<std::uint32_t>(nfds), last};
+        struct iovec iov{&hdr, sizeof(hdr)};
+        std::vector<char> control(CMSG_SPACE(sizeof(int)*nfds));
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if(nfds > 0){
+            msg.msg_control = control.data();
+            msg.msg_controllen = control.size();
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int)*nfds);
+            std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int)*nfds);
+        }
+        ssize_t len;
+        do{
+            len = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+        } while(len < 0 && (errno == EINTR || wait_ready(sock, POLLOUT)));
+        if(len < 0){
+            return std::error_code(errno, std::system_category());
+        }
+        return std::error_code();
+    }
+
+    std::error_code recv_fds(int sock, std::vector<int>& fds, bool& last){
+        FdHeader hdr{};
+        struct iovec iov{&hdr, sizeof(hdr)};
+        std::vector<char> control(CMSG_SPACE(sizeof(int)*MAX_FDS));
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        ssize_t len;
+        do{
+            len = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        } while(len < 0 && (errno == EINTR || wait_ready(sock, POLLIN)));
+        if(len < 0){
+            return std::error_code(errno, std::system_category());
+        }
+        // Collect the descriptors first so that they can be closed by the caller on error.
+        for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+            if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+                std::size_t n = (cmsg->cmsg_len - CMSG_LEN(0))/sizeof(int);
+                const int* data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+                fds.insert(fds.end(), data, data+n);
+            }
+        }
+        if(static_cast<std::size_t>(len) != sizeof(hdr) || hdr.magic != FD_MAGIC || (msg.msg_flags & MSG_CTRUNC)){
+            return std::make_error_code(std::errc::protocol_error);
+        }
+        last = hdr.last;
+        return std::error_code();
+    }
+
+    std::error_code uSession::receive(){
         std::array<char, PAGE> buf;
         boost::system::error_code ec;
+        metrics::Span span(metrics::Event::READ, this);
+        std::uint64_t total = 0;
         do{
             std::size_t len = _socket.read_some(boost::asio::mutable_buffer(buf.data(), PAGE), ec);
+            metrics::add(metrics::Counter::READS);
+            auto lk = lock();
+            ++stats.reads;
             if(!ec){
-                auto lk = lock();
                 std::string_view s(buf.data(), len);
                 rbuf << s;
+                account();
+                std::uint64_t buffered = rbuf.rdbuf()->in_avail();
+                stats.bytes_read += len;
+                total += len;
+                stats.rbuf_high_water = std::max<std::uint64_t>(stats.rbuf_high_water, buffered);
+                metrics::add(metrics::Counter::BYTES_READ, len);
+                metrics::peak(metrics::Peak::RBUF_BYTES, buffered);
+                active();
+                // Leave the rest in the socket, so that the peer is held back until the application catches up.
+                if(read_blocked()){
+                    break;
+                }
             }
         } while(!ec);
+        span.end(total);
+        OSI_PROBE(read, this, _socket.native_handle(), total);
+        if(ec == boost::asio::error::would_block || ec == boost::asio::error::try_again){
+            return std::error_code();
+        } else if(ec == boost::asio::error::eof){
+            return std::make_error_code(std::errc::connection_aborted);
+        }
+        return std::error_code(ec.value(), std::system_category());
+    }
+
+    void uSession::read(){
+        receive();
+    }
+
+    bool uSession::hold(std::function<void()> fn){
+        auto lk = lock();
+        if(!_paused){
+            return false;
+        }
+        _held.push_back(std::move(fn));
+        return true;
+    }
+
+    void uSession::pause(){
+        {
+            auto lk = lock();
+            _paused = true;
+        }
+        boost::system::error_code ec;
+        _socket.cancel(ec);
+    }
+
+    void uSession::resume(){
+        std::vector<std::function<void()> > held;
+        {
+            auto lk = lock();
+            _paused = false;
+            held.swap(_held);
+        }
+        for(auto& fn: held){
+            fn();
+        }
     }
 
     void uSession::async_read(std::function<void(std::error_code ec)> cb){
+        if(hold([&, cb](){ async_read(cb); })){
+            return;
+        }
+        {
+            auto lk = lock();
+            if(read_blocked()){
+                when_readable([cb](){ cb(std::error_code()); });
+                return;
+            }
+        }
         _socket.async_wait(
             uSession::socket::wait_type::wait_read,
-            [&](const boost::system::error_code& ec){
+            [&, cb, self = weak_from_this()](const boost::system::error_code& ec){
                 if(!ec){
-                    read();
-                    cb(std::error_code(ec.value(), std::system_category()));
+                    metrics::trace(metrics::Event::WAKEUP, this);
+                    // The socket stays readable once the peer has gone, so that has to be reported
+                    // or the caller would wait for the next read forever.
+                    cb(receive());
+                } else if(ec == boost::asio::error::operation_aborted && !self.expired()){
+                    // Cancelled by pause(), wait again once resumed. Cancelled by close(), the caller has to know
+                    // or it would never hear from the session again.
+                    if(!hold([&, cb](){ async_read(cb); })){
+                        cb(std::error_code(ec.value(), std::system_category()));
+                    }
                 }
             }
         );
     }
 
+    void uSession::post(std::vector<std::function<void()> > fns){
+        for(auto& fn: fns){
+            boost::asio::post(_socket.get_executor(), std::move(fn));
+        }
+    }
+
     void uSession::write(){
-        std::array<char, PAGE> buf;
         boost::system::error_code ec;
-        auto lk = lock();
-        auto rlen = wbuf.readsome(buf.data(), PAGE);
-        while(rlen > 0){
-            boost::asio::const_buffer out(buf.data(), rlen);
-            do{
-                std::size_t len = _socket.write_some(out, ec);
-                out += len;
-            }while(out.size() > 0 && !ec);
-            if(!ec){
-                rlen = wbuf.readsome(buf.data(), PAGE);
+        metrics::Span span(metrics::Event::WRITE, this);
+        std::uint64_t total = 0;
+        std::vector<std::function<void()> > resumed;
+        {
+            auto lk = lock();
+            account();
+            std::uint64_t buffered = wbuf.rdbuf()->in_avail();
+            stats.wbuf_high_water = std::max(stats.wbuf_high_water, buffered);
+            metrics::peak(metrics::Peak::WBUF_BYTES, buffered);
+            // Write straight out of the buffer, it gives its block back once it has all been written.
+            auto data = wbuf.data();
+            while(!data.empty()){
+                std::size_t len = _socket.write_some(boost::asio::const_buffer(data.data(), data.size()), ec);
+                wbuf.consume(len);
+                ++stats.writes;
+                stats.bytes_written += len;
+                total += len;
+                metrics::add(metrics::Counter::WRITES);
+                metrics::add(metrics::Counter::BYTES_WRITTEN, len);
+                if(ec == boost::asio::error::would_block || ec == boost::asio::error::try_again){
+                    // The peer is not keeping up, write the rest once the socket is writable instead of spinning.
+                    if(!_flushing){
+                        _flushing = true;
+                        _socket.async_wait(
+                            uSession::socket::wait_type::wait_write,
+                            [&, self = weak_from_this()](const boost::system::error_code& ec){
+                                if(ec && (ec != boost::asio::error::operation_aborted || self.expired())){
+                                    return;
+                                }
+                                {
+                                    auto lk = lock();
+                                    _flushing = false;
+                                }
+                                if(ec){
+                                    // Cancelled by pause() (or by close(), then nothing is held).
+                                    hold([&](){ write(); });
+                                    return;
+                                }
+                                write();
+                            }
+                        );
+                    }
+                    break;
+                } else if(ec){
+                    // The peer has gone, what is left can not be delivered.
+                    break;
+                }
+                data = wbuf.data();
+            }
+            if(total > 0){
+                active();
             }
+            write_deadline(!data.empty(), total > 0);
+            resumed = resumable();
         }
+        span.end(total);
+        OSI_PROBE(write, this, _socket.native_handle(), total);
+        post(std::move(resumed));
     }
 
     void uSession::async_write(std::function<void(std::error_code ec)> cb){
+        if(hold([&, cb](){ async_write(cb); })){
+            return;
+        }
         _socket.async_wait(
             uSession::socket::wait_type::wait_write,
-            [&](const boost::system::error_code& ec){
+            [&, cb, self = weak_from_this()](const boost::system::error_code& ec){
                 if(!ec){
                     write();
                     cb(std::error_code(ec.value(), std::system_category()));
+                } else if(ec == boost::asio::error::operation_aborted && !self.expired()){
+                    if(!hold([&, cb](){ async_write(cb); })){
+                        cb(std::error_code(ec.value(), std::system_category()));
+                    }
                 }
             }
         );
     }
 
+    void uSession::close(){
+        metrics::trace(metrics::Event::CLOSE, this);
+        OSI_PROBE(session__close, this, _socket.native_handle());
+        boost::system::error_code ec;
+        _socket.close(ec);
+        forget();
+        auto lk = lock();
+        _paused = false;
+        _held.clear();
+    }
+
+    bool uSession::healthy(){
+        if(!_socket.is_open()){
+            return false;
+        }
+        {
+            auto lk = lock();
+            if(rbuf.rdbuf()->in_avail() > 0 || wbuf.rdbuf()->in_avail() > 0){
+                return false;
+            }
+        }
+        struct pollfd pfd{_socket.native_handle(), POLLIN | POLLRDHUP, 0};
+        int n = ::poll(&pfd, 1, 0);
+        return n == 0;
+    }
+
     void uServer::open(const uServer::endpoint& endpoint){
         uServer::socket socket(_ioc);
-        socket.non_blocking(true);
         socket.connect(endpoint);
+        socket.non_blocking(true);
         std::shared_ptr<uSession> session = std::make_shared<uSession>(std::move(socket), *this);
         {
             auto lk = lock();
@@ -76,11 +320,32 @@ namespace unix_session
     }
     void uServer::open(){}
 
+    void uServer::async_open(const uServer::endpoint& endpoint, std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> fn){
+        auto socket = std::make_shared<uServer::socket>(_ioc);
+        socket->async_connect(endpoint, [&, socket, fn](const boost::system::error_code& ec){
+            std::error_code errc(ec.value(), std::system_category());
+            if(ec){
+                fn(errc, nullptr);
+                return;
+            }
+            socket->non_blocking(true);
+            std::shared_ptr<uSession> session = std::make_shared<uSession>(std::move(*socket), *this);
+            {
+                auto lk = lock();
+                push_back(session);
+            }
+            fn(errc, session);
+        });
+    }
+
     void uServer::accept(std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> fn){
         _acceptor.async_accept([&, fn](const boost::system::error_code& ec, uServer::socket socket){
             if(!ec){
                 socket.non_blocking(true);
                 std::shared_ptr<uSession> session = std::make_shared<uSession>(std::move(socket), *this);
+                metrics::trace(metrics::Event::ACCEPT, session.get());
+                OSI_PROBE(accept, session.get(), session->native_handle());
+                session->read_deadline(session::Deadline::IDLE);
                 {
                     auto lk = lock();
                     push_back(session);
@@ -92,8 +357,146 @@ namespace unix_session
         });
     }
 
+    void uServer::handover(const uServer::endpoint& control, std::function<bool(const std::shared_ptr<uSession>& session)> idle){
+        if(!_control.is_open()){
+            _control_endpoint = control;
+            _control = uServer::acceptor(_ioc, control);
+        }
+        _control.async_accept([&, control, idle](const boost::system::error_code& ec, uServer::socket socket){
+            if(ec){
+                return;
+            }
+            if(!_acceptor.is_open()){
+                // There is no listening socket to hand over, the successor is refused by closing the connection.
+                return;
+            }
+            // The first descriptor is always the listening socket.
+            std::vector<std::shared_ptr<uSession> > sessions;
+            std::vector<int> fds{_acceptor.native_handle()};
+            if(idle){
+                auto lk = lock();
+                for(auto& sp: *this){
+                    auto session = std::static_pointer_cast<uSession>(sp);
+                    if(idle(session)){
+                        sessions.push_back(session);
+                        fds.push_back(session->native_handle());
+                    }
+                }
+            }
+            // Nothing may be read from, or written to, a session that the successor is about to own.
+            for(auto& session: sessions){
+                session->pause();
+            }
+            std::error_code errc;
+            std::size_t offset = 0;
+            do{
+                std::size_t nfds = std::min(MAX_FDS, fds.size()-offset);
+                errc = send_fds(socket.native_handle(), fds.data()+offset, nfds, offset+nfds == fds.size());
+                offset += nfds;
+            } while(!errc && offset < fds.size());
+            auto failed = [&, control, idle, sessions](){
+                // The successor went away. Keep serving and wait for the next one.
+                for(auto& session: sessions){
+                    session->resume();
+                }
+                handover(control, idle);
+            };
+            if(errc){
+                failed();
+                return;
+            }
+            // Wait for the successor to acknowledge that it has taken ownership of the listening socket
+            // before we stop accepting, without blocking the io_context, and for no longer than HANDOVER_TIMEOUT.
+            auto ctl = std::make_shared<uServer::socket>(std::move(socket));
+            auto timer = std::make_shared<boost::asio::steady_timer>(_ioc, HANDOVER_TIMEOUT);
+            auto ack = std::make_shared<char>(0);
+            timer->async_wait([ctl](const boost::system::error_code& ec){
+                if(!ec){
+                    boost::system::error_code cec;
+                    ctl->close(cec);
+                }
+            });
+            boost::asio::async_read(*ctl, boost::asio::buffer(ack.get(), 1), [&, ctl, timer, ack, sessions, failed](const boost::system::error_code& ec, std::size_t){
+                timer->cancel();
+                if(ec){
+                    failed();
+                    return;
+                }
+                _handed_over = true;
+                boost::system::error_code cec;
+                _acceptor.close(cec);
+                for(auto& session: sessions){
+                    session->close();
+                    close(session);
+                }
+                _control.close(cec);
+                std::filesystem::remove(std::filesystem::path(_control_endpoint.path()));
+            });
+        });
+    }
+
+    std::error_code uServer::inherit(const uServer::endpoint& control, std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> fn){
+        boost::system::error_code ec;
+        uServer::socket ctl(_ioc);
+        ctl.connect(control, ec);
+        if(ec){
+            return std::error_code(ec.value(), std::system_category());
+        }
+        std::vector<int> fds;
+        bool last = false;
+        std::error_code errc;
+        do{
+            errc = recv_fds(ctl.native_handle(), fds, last);
+        } while(!errc && !last);
+        if(!errc && fds.empty()){
+            errc = std::make_error_code(std::errc::protocol_error);
+        }
+        if(!errc){
+            _acceptor.assign(boost::asio::local::stream_protocol(), fds[0], ec);
+            errc = std::error_code(ec.value(), std::system_category());
+        }
+        if(errc){
+            for(int fd: fds){
+                ::close(fd);
+            }
+            return errc;
+        }
+        _endpoint = _acceptor.local_endpoint(ec);
+
+        std::vector<std::shared_ptr<uSession> > sessions;
+        for(auto it = fds.begin()+1; it != fds.end(); ++it){
+            uServer::socket socket(_ioc);
+            socket.assign(boost::asio::local::stream_protocol(), *it, ec);
+            if(ec){
+                ::close(*it);
+                continue;
+            }
+            socket.non_blocking(true);
+            sessions.push_back(std::make_shared<uSession>(std::move(socket), *this));
+            sessions.back()->read_deadline(session::Deadline::IDLE);
+        }
+        {
+            auto lk = lock();
+            insert(end(), sessions.begin(), sessions.end());
+        }
+        // Acknowledge the handover. The predecessor stops accepting
+        // as soon as it reads this byte.
+        char ack = 1;
+        boost::asio::write(ctl, boost::asio::buffer(&ack, 1), ec);
+        if(fn){
+            for(auto& session: sessions){
+                fn(std::error_code(), session);
+            }
+        }
+        return std::error_code(ec.value(), std::system_category());
+    }
+
     uServer::~uServer(){
-        if(_endpoint != uServer::endpoint()){
+        if(_control.is_open()){
+            std::filesystem::path p(_control_endpoint.path());
+            std::filesystem::remove(p);
+        }
+        if(_endpoint != uServer::endpoint() && !_handed_over){
             std::filesystem::path p(_endpoint.path());
             std::filesystem::remove(p);
         }
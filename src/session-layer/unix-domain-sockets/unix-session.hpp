@@ -7,10 +7,18 @@
 #define UNIX_DOMAIN_SESSIONS_HPP
 #include <boost/asio.hpp>
 #include "../session.hpp"
+#include "../../metrics/probes.hpp"
 namespace unix_session
 {
     // Forward Declarations
     class uServer;
+
+    // Pass file descriptors over a connected Unix domain socket as SCM_RIGHTS ancillary data.
+    // At most MAX_FDS descriptors are sent per message, last marks the final message of a sequence.
+    // Received descriptors are appended to fds, and are owned by the caller even if an error is returned.
+    static constexpr std::size_t MAX_FDS = 128;
+    std::error_code send_fds(int sock, const int* fds, std::size_t nfds, bool last);
+    std::error_code recv_fds(int sock, std::vector<int>& fds, bool& last);
     /* 
     *  Sessions own a low level interface to the underlying transport byte stream. 
     *  Sessions present an iostream of bytes for higher level presentation layers to interpret.
@@ -21,9 +29,24 @@ namespace unix_session
     {
         typedef boost::asio::local::stream_protocol::socket socket;
         socket _socket;
+        // A wait for the socket to become writable again is pending, the session lock must be held.
+        bool _flushing = false;
+        // While paused, the operations that were waiting on the socket are held here instead (see pause()).
+        bool _paused = false;
+        std::vector<std::function<void()> > _held;
+
+        // Read everything that is available, up to the read high watermark,
+        // returns the error that ends the session if there is one.
+        std::error_code receive();
+        // Call what the flow control has resumed, without the session lock.
+        void post(std::vector<std::function<void()> > fns);
+        // Hold an operation until the session is resumed, if it is paused.
+        bool hold(std::function<void()> fn);
         
         public:
-            uSession(socket&& socket, session::Server& server): session::Session(server), _socket(std::move(socket)) {}
+            uSession(socket&& socket, session::Server& server): session::Session(server), _socket(std::move(socket)) {
+                OSI_PROBE(session__open, this, _socket.native_handle());
+            }
 
             void read() override;
             void async_read(std::function<void(std::error_code ec)> cb) override;
@@ -31,6 +54,18 @@ namespace unix_session
             void write() override;
             void async_write(std::function<void(std::error_code ec)> cb) override;
 
+            // The native socket is exposed so that sessions can be handed over
+            // to another process (see uServer::handover).
+            int native_handle() { return _socket.native_handle(); }
+            void close() override;
+            // Stop all i/o on the socket, e.g. while it is being handed over to another process.
+            // Pending and new async operations are held, and restarted by resume().
+            void pause();
+            void resume();
+            // An idle session is healthy if it is still open, has nothing buffered,
+            // and the peer has not closed the connection or sent anything unsolicited.
+            bool healthy();
+
             ~uSession() = default;
     };
 
@@ -49,15 +84,40 @@ namespace unix_session
         endpoint _endpoint;
         acceptor _acceptor;
 
+        // Control acceptor used to hand the listening socket over to a successor process.
+        acceptor _control;
+        endpoint _control_endpoint;
+        bool _handed_over = false;
+
         public:
-            uServer(boost::asio::io_context& ioc): _ioc(ioc), _acceptor(ioc) {}
-            uServer(boost::asio::io_context& ioc, const endpoint& endpoint): _ioc(ioc), _endpoint(endpoint), _acceptor(ioc, endpoint) {}
+            uServer(boost::asio::io_context& ioc): _ioc(ioc), _acceptor(ioc), _control(ioc) {}
+            uServer(boost::asio::io_context& ioc, const endpoint& endpoint): _ioc(ioc), _endpoint(endpoint), _acceptor(ioc, endpoint), _control(ioc) {}
 
             void open(const endpoint& endpoint);
             void open() override;
+            // Connect without blocking. fn is called with the new session once it is connected.
+            void async_open(const endpoint& endpoint, std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> fn);
 
             void accept(std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> fn);
 
+            // Zero-downtime restarts.
+            // The running process listens on a control socket with handover(). When a successor connects
+            // the listening socket (and any sessions that the idle predicate selects) are passed to it with SCM_RIGHTS.
+            // Once the successor acknowledges the handover this server stops accepting, forgets the handed over sessions, 
+            // and keeps serving its remaining active sessions until they are closed (i.e. until the server is empty()).
+            // The socket path is not removed on destruction after a successful handover.
+            // Handed over sessions are paused while their descriptors are in flight, and resumed if the handover fails.
+            // A successor that does not acknowledge within HANDOVER_TIMEOUT is treated as gone.
+            // Once the listening socket has been closed, successors are refused.
+            static constexpr std::chrono::seconds HANDOVER_TIMEOUT{5};
+            void handover(const endpoint& control, std::function<bool(const std::shared_ptr<uSession>& session)> idle = nullptr);
+            // The successor process calls inherit() instead of binding the endpoint itself.
+            // fn is called for every inherited session, then accept() can be called as usual.
+            // Connections queued in the accept backlog during the restart are preserved since the listening socket
+            // is never closed.
+            std::error_code inherit(const endpoint& control, std::function<void(const std::error_code& ec, std::shared_ptr<uSession> session)> fn = nullptr);
+            bool handed_over() { return _handed_over; }
+
             ~uServer();           
     };
 }
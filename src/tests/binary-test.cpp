@@ -0,0 +1,113 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// Round trips of BinaryPresentation messages between a pair of Unix domain sessions:
+// owning types, views into the receive buffer, and a fixed layout that rejects messages of any other length.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../presentation-layer/binary-presentation/binary-presentation.hpp"
+
+using namespace binary;
+using namespace binary::b_presentation;
+
+struct Point
+{
+    double x;
+    double y;
+    int id;
+};
+
+typedef BinaryPresentation<std::uint64_t, Point, std::string, std::vector<int>, std::vector<std::string>, std::tuple<int, std::string> > Owning;
+typedef BinaryPresentation<std::string_view, ArrayView<double>, std::uint32_t> Views;
+typedef BinaryPresentation<std::uint64_t, Point> Fixed;
+static_assert(Fixed::TupleCodec::fixed && Fixed::TupleCodec::size == sizeof(std::uint64_t) + sizeof(Point), "a tuple of trivial types has a fixed layout.");
+static_assert(!Owning::TupleCodec::fixed, "strings and vectors do not have a fixed size.");
+
+static const int MESSAGES = 100;
+
+static int failures = 0;
+
+static void expect(bool ok, const std::string& name){
+    if(!ok){
+        std::cerr << "binary-test:" << name << " failed" << std::endl;
+        ++failures;
+    }
+}
+
+static std::tuple<std::uint64_t, Point, std::string, std::vector<int>, std::vector<std::string>, std::tuple<int, std::string> > make(int i){
+    return std::make_tuple(std::uint64_t(i), Point{1.5*i, -2.0, i}, std::string(i, 'q'), std::vector<int>(i, i),
+                           std::vector<std::string>{"a", std::string(i, 'z')}, std::make_tuple(i, std::string("t")));
+}
+
+int main(){
+    typedef boost::asio::local::stream_protocol::socket socket;
+    boost::asio::io_context ioc;
+    unix_session::uServer server(ioc);
+    socket s1(ioc), s2(ioc);
+    boost::asio::local::connect_pair(s1, s2);
+    s1.non_blocking(true);
+    s2.non_blocking(true);
+    auto a = std::make_shared<unix_session::uSession>(std::move(s1), server);
+    auto b = std::make_shared<unix_session::uSession>(std::move(s2), server);
+
+    // Many messages written together are decoded one at a time, with read() and then next().
+    {
+        Owning::BinaryPresentations presentations;
+        Owning tx(presentations, a), rx(presentations, b);
+        for(int i = 0; i < MESSAGES; ++i){
+            tx.send(make(i));
+        }
+        tx.write();
+        int received = 0;
+        while(received < MESSAGES && !rx.error()){
+            rx.session->read();
+            rx.read();
+            for(bool decoded = true; decoded && received < MESSAGES; decoded = rx.next()){
+                auto expected = make(received);
+                auto lk = rx.lock();
+                bool same = std::get<0>(rx) == std::get<0>(expected) && std::get<1>(rx).x == std::get<1>(expected).x
+                    && std::get<1>(rx).id == std::get<1>(expected).id && std::get<2>(rx) == std::get<2>(expected)
+                    && std::get<3>(rx) == std::get<3>(expected) && std::get<4>(rx) == std::get<4>(expected) && std::get<5>(rx) == std::get<5>(expected);
+                expect(same, "message " + std::to_string(received));
+                ++received;
+            }
+        }
+        expect(received == MESSAGES && !rx.error(), "every message received");
+    }
+
+    // Views point into the receive buffer.
+    {
+        Views::BinaryPresentations presentations;
+        Views tx(presentations, a), rx(presentations, b);
+        std::vector<double> values{1.0, 2.5, 3.25};
+        tx.send(std::make_tuple(std::string_view("hello"), ArrayView<double>(values), 7u));
+        tx.write();
+        rx.session->read();
+        rx.read();
+        auto lk = rx.lock();
+        expect(std::get<0>(rx) == "hello" && std::get<1>(rx).to_vector() == values && std::get<2>(rx) == 7u, "views");
+    }
+
+    // A message of the wrong length for a fixed layout fails the presentation.
+    {
+        Views::BinaryPresentations views;
+        Fixed::BinaryPresentations fixed;
+        Views tx(views, a);
+        Fixed rx(fixed, b);
+        tx.send(std::make_tuple(std::string_view("x"), ArrayView<double>(), 1u));
+        tx.write();
+        rx.session->read();
+        rx.read();
+        expect(rx.error() == std::make_error_code(std::errc::message_size), "fixed layout mismatch");
+    }
+
+    if(failures > 0){
+        return 1;
+    }
+    std::cout << "binary-test: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// The header block examples of RFC 7541 Appendix C, decoded in sequence with one decoder per connection,
+// and a round trip of each list of fields through the encoder.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../presentation-layer/http2-presentation/hpack.hpp"
+
+using namespace http::hpack;
+
+static int failures = 0;
+
+static std::string unhex(const std::string& hex){
+    std::string out;
+    std::string digits;
+    for(char c: hex){
+        if(c != ' '){
+            digits.push_back(c);
+        }
+    }
+    for(std::size_t i = 0; i + 1 < digits.size(); i += 2){
+        out.push_back(static_cast<char>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+static void expect(bool ok, const std::string& name){
+    if(!ok){
+        std::cerr << "hpack-test:" << name << " failed" << std::endl;
+        ++failures;
+    }
+}
+
+struct Example
+{
+    std::string name;
+    std::string block;
+    std::vector<HeaderField> fields;
+    // The size of the dynamic table once the block has been decoded.
+    std::size_t table_size;
+};
+
+static void run(const std::vector<Example>& examples){
+    Decoder decoder;
+    Encoder encoder;
+    Decoder peer;
+    for(auto& example: examples){
+        std::vector<HeaderField> fields;
+        expect(decoder.decode(unhex(example.block), fields), example.name + " decode");
+        expect(fields == example.fields, example.name + " fields");
+        expect(decoder.table().size() == example.table_size, example.name + " table size");
+
+        std::string block;
+        encoder.encode(example.fields, block);
+        std::vector<HeaderField> decoded;
+        expect(peer.decode(block, decoded) && decoded == example.fields, example.name + " round trip");
+    }
+}
+
+int main(){
+    // C.2 Header field representations, each with a fresh decoder.
+    run({{"C.2.1", "400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572", {{"custom-key", "custom-header"}}, 55}});
+    run({{"C.2.2", "040c 2f73 616d 706c 652f 7061 7468", {{":path", "/sample/path"}}, 0}});
+    run({{"C.2.3", "1008 7061 7373 776f 7264 0673 6563 7265 74", {{"password", "secret"}}, 0}});
+    run({{"C.2.4", "82", {{":method", "GET"}}, 0}});
+
+    std::vector<HeaderField> first = {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+    std::vector<HeaderField> second = first;
+    second.emplace_back("cache-control", "no-cache");
+    std::vector<HeaderField> third = {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"}, {":authority", "www.example.com"}, {"custom-key", "custom-value"}};
+
+    // C.3 Requests without Huffman coding.
+    run({
+        {"C.3.1", "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d", first, 57},
+        {"C.3.2", "8286 84be 5808 6e6f 2d63 6163 6865", second, 110},
+        {"C.3.3", "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65", third, 164}
+    });
+    // C.4 Requests with Huffman coding.
+    run({
+        {"C.4.1", "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff", first, 57},
+        {"C.4.2", "8286 84be 5886 a8eb 1064 9cbf", second, 110},
+        {"C.4.3", "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf", third, 164}
+    });
+
+    std::vector<HeaderField> r1 = {{":status", "302"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:21 GMT"}, {"location", "https://www.example.com"}};
+    std::vector<HeaderField> r2 = r1;
+    r2[0].second = "307";
+    std::vector<HeaderField> r3 = {{":status", "200"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:22 GMT"}, {"location", "https://www.example.com"},
+                                   {"content-encoding", "gzip"}, {"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}};
+
+    // C.5 and C.6 assume a table of 256 bytes on both sides, which the first block of each connection
+    // announces here with a dynamic table size update (3fe101) so that entries are evicted as in the RFC.
+    // C.5 Responses without Huffman coding.
+    run({
+        {"C.5.1", "3fe101 4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70 6c65 2e63 6f6d", r1, 222},
+        {"C.5.2", "4803 3330 37c1 c0bf", r2, 222},
+        {"C.5.3", "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220 474d 54c0 5a04 677a 6970 7738 666f 6f3d 4153 444a 4b48 514b 425a 584f 5157 454f 5049 5541 5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b 2076 6572 7369 6f6e 3d31", r3, 215}
+    });
+    // C.6 Responses with Huffman coding.
+    run({
+        {"C.6.1", "3fe101 4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6 2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3", r1, 222},
+        {"C.6.2", "4883 640e ffc1 c0bf", r2, 222},
+        {"C.6.3", "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b d9ab 77ad 94e7 821d d7f2 e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27 0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07", r3, 215}
+    });
+
+    if(failures > 0){
+        return 1;
+    }
+    std::cout << "hpack-test: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// The opening handshake example of RFC 6455 section 1.3, the frames of RFC 6455 section 5.7,
+// and the permessage-deflate frames of RFC 7692 section 7.2.3.
+#include <iostream>
+#include <string>
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../presentation-layer/websocket-presentation/websocket-presentation.hpp"
+
+using namespace http;
+using namespace websocket::ws_presentation;
+
+static int failures = 0;
+
+static void expect(bool ok, const std::string& name){
+    if(!ok){
+        std::cerr << "websocket-test:" << name << " failed" << std::endl;
+        ++failures;
+    }
+}
+
+// Hand the frame to the presentation as if it had been read from the session, and take the message that it completes.
+static bool receive(WsPresentation& p, const std::string& frame, WsMessage& message){
+    {
+        auto lk = p.session->lock();
+        p.session->rbuf << frame;
+    }
+    p.read();
+    auto lk = p.lock();
+    auto& messages = std::get<WsMessages>(p);
+    if(messages.empty()){
+        return false;
+    }
+    message = messages.front();
+    messages.pop_front();
+    return true;
+}
+
+int main(){
+    typedef boost::asio::local::stream_protocol::socket socket;
+    boost::asio::io_context ioc;
+    unix_session::uServer server(ioc);
+    WsPresentations presentations;
+
+    expect(accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", "accept key");
+
+    // The server answers the handshake request of the RFC with its Sec-WebSocket-Accept value.
+    {
+        socket s1(ioc), s2(ioc);
+        boost::asio::local::connect_pair(s1, s2);
+        s1.non_blocking(true);
+        auto session = std::make_shared<unix_session::uSession>(std::move(s1), server);
+        WsPresentation p(presentations, session, WsPresentation::Role::SERVER);
+        HttpRequest req{};
+        req.verb = HttpVerb::GET;
+        req.route = "/chat";
+        req.version = HttpVersion::V1_1;
+        req.headers.push_back(make_header(HttpHeaderField::HOST, "server.example.com"));
+        req.headers.push_back(make_header(HttpHeaderField::UPGRADE, "websocket"));
+        req.headers.push_back(make_header(HttpHeaderField::CONNECTION, "Upgrade"));
+        req.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_KEY, "dGhlIHNhbXBsZSBub25jZQ=="));
+        req.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_VERSION, "13"));
+        req.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+        expect(p.handshake(req), "server handshake");
+        p.write();
+        char buf[1024];
+        std::size_t len = s2.read_some(boost::asio::buffer(buf));
+        std::string res(buf, len);
+        expect(res.rfind("HTTP/1.1 101", 0) == 0, "switching protocols");
+        expect(res.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos, "server accept key");
+
+        // A masked "Hello" from the client.
+        WsMessage message;
+        expect(receive(p, "\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58", message) && message.data == "Hello", "masked text frame");
+    }
+
+    // A client that has agreed permessage-deflate with the server.
+    {
+        socket s1(ioc), s2(ioc);
+        boost::asio::local::connect_pair(s1, s2);
+        s1.non_blocking(true);
+        auto session = std::make_shared<unix_session::uSession>(std::move(s1), server);
+        WsPresentation p(presentations, session, WsPresentation::Role::CLIENT);
+        HttpRequest req = p.handshake_request("server.example.com", "/chat");
+        std::string key;
+        for(auto& header: req.headers){
+            if(header.field_name == HttpHeaderField::SEC_WEBSOCKET_KEY){
+                key = header.field_value;
+            }
+        }
+        HttpResponse res{};
+        res.version = HttpVersion::V1_1;
+        res.status = HttpStatus::SWITCHING_PROTOCOLS;
+        res.headers.push_back(make_header(HttpHeaderField::UPGRADE, "websocket"));
+        res.headers.push_back(make_header(HttpHeaderField::CONNECTION, "Upgrade"));
+        res.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_ACCEPT, accept_key(key)));
+        res.headers.push_back(make_header(HttpHeaderField::SEC_WEBSOCKET_EXTENSIONS, "permessage-deflate"));
+        res.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+        expect(p.handshake(res) && p.compressed(), "client handshake");
+
+        WsMessage message;
+        // An unmasked "Hello".
+        expect(receive(p, std::string("\x81\x05Hello", 7), message) && message.data == "Hello", "text frame");
+        // A compressed "Hello", and the same message ended by a final DEFLATE block.
+        expect(receive(p, std::string("\xc1\x07\xf2\x48\xcd\xc9\xc9\x07\x00", 9), message) && message.data == "Hello", "compressed text frame");
+        expect(receive(p, std::string("\xc1\x08\xf3\x48\xcd\xc9\xc9\x07\x00\x00", 10), message) && message.data == "Hello", "final deflate block");
+        // The context is kept between messages, the second "Hello" refers back to the first.
+        expect(receive(p, std::string("\xc1\x07\xf2\x48\xcd\xc9\xc9\x07\x00", 9), message) && message.data == "Hello", "first of two messages");
+        expect(receive(p, std::string("\xc1\x05\xf2\x00\x11\x00\x00", 7), message) && message.data == "Hello", "message sharing the window");
+    }
+
+    if(failures > 0){
+        return 1;
+    }
+    std::cout << "websocket-test: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// A load generator for HTTP/1.1 servers that listen on a Unix domain socket.
+//
+//     http-load [-c connections] [-p depth] [-t threads] [-d seconds] [-w seconds] [-r rate] [-u route] [-g seconds] socket
+//
+// Every thread runs its own io_context, and opens its share of the connections with uServer::open.
+// Requests are sent with HttpPipelinedClientPresentation, up to depth of them back to back on each connection.
+// Without a rate the load is closed-loop: every connection keeps depth requests outstanding,
+// and sends the next one as soon as a response arrives.
+// With a rate (requests per second, over all threads) the load is open-loop: requests are sent on a fixed schedule
+// whether or not the server keeps up, and their latency is measured from when they were due to be sent,
+// not from when they were sent, so that a stalled server is charged for the requests it kept waiting (coordinated omission).
+// Responses that arrive during the warmup are not recorded.
+// The result is one JSON object with the throughput, the latency percentiles in nanoseconds, and the latency histogram.
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../session-layer/unix-domain-sockets/unix-session.hpp"
+#include "../presentation-layer/http-presentation/http-presentation.hpp"
+#include "../metrics/histogram.hpp"
+
+using namespace http;
+using namespace http::h_presentation;
+typedef std::chrono::steady_clock clock_type;
+
+struct Options
+{
+    std::size_t connections = 16;
+    std::size_t depth = 1;
+    std::size_t threads = 1;
+    double duration = 10;
+    double warmup = 1;
+    double grace = 1;
+    double rate = 0;
+    std::string route = "/";
+    std::string path;
+};
+
+struct Worker
+{
+    boost::asio::io_context ioc;
+    unix_session::uServer server{ioc};
+    HttpPresentations presentations;
+    std::vector<std::shared_ptr<HttpPipelinedClientPresentation> > clients;
+    metrics::Histogram latency;
+    std::size_t sent = 0;
+    std::size_t completed = 0;
+    std::size_t recorded = 0;
+    std::size_t non_2xx = 0;
+    std::size_t errors = 0;
+};
+
+class Generator
+{
+    const Options& _options;
+    Worker& _worker;
+    HttpRequest _request{};
+    clock_type::time_point _measure, _stop;
+    boost::asio::steady_timer _timer;
+    // The open-loop schedule: the time that the next request is due, and the interval between requests.
+    clock_type::time_point _due;
+    clock_type::duration _interval{};
+    std::size_t _next = 0;
+
+    void read(const std::shared_ptr<HttpPipelinedClientPresentation>& client){
+        client->async_read([this, client](std::error_code ec){
+            if(ec){
+                ++_worker.errors;
+                client->cancel(ec);
+                return;
+            }
+            read(client);
+        });
+    }
+
+    void send(const std::shared_ptr<HttpPipelinedClientPresentation>& client, clock_type::time_point due){
+        ++_worker.sent;
+        client->request(_request, [this, client, due](const std::error_code& ec, HttpResponse& res){
+            if(ec){
+                return;
+            }
+            auto now = clock_type::now();
+            ++_worker.completed;
+            if(due >= _measure && now <= _stop){
+                _worker.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count());
+                ++_worker.recorded;
+                if(static_cast<int>(res.status) < 200 || static_cast<int>(res.status) >= 300){
+                    ++_worker.non_2xx;
+                }
+            }
+            // Closed-loop: the response frees a slot for the next request on the same connection,
+            // which is written as soon as this read has finished.
+            if(_interval == clock_type::duration::zero() && now < _stop){
+                send(client, now);
+            }
+        });
+    }
+
+    void schedule(){
+        auto now = clock_type::now();
+        std::vector<bool> touched(_worker.clients.size());
+        while(_due <= now && _due < _stop){
+            std::size_t i = _next++ % _worker.clients.size();
+            send(_worker.clients[i], _due);
+            touched[i] = true;
+            _due += _interval;
+        }
+        for(std::size_t i = 0; i < touched.size(); ++i){
+            if(touched[i]){
+                _worker.clients[i]->write();
+            }
+        }
+        if(_due < _stop){
+            _timer.expires_at(_due);
+            _timer.async_wait([this](const boost::system::error_code& ec){
+                if(!ec){
+                    schedule();
+                }
+            });
+        }
+    }
+
+public:
+    Generator(const Options& options, Worker& worker, std::size_t connections, double rate):
+        _options(options), _worker(worker), _timer(worker.ioc)
+    {
+        _request.verb = HttpVerb::GET;
+        _request.route = options.route;
+        _request.version = HttpVersion::V1_1;
+        _request.headers.push_back(make_header(HttpHeaderField::HOST, "localhost"));
+        _request.headers.push_back(make_header(HttpHeaderField::END_OF_HEADERS));
+        boost::asio::local::stream_protocol::endpoint endpoint(options.path);
+        for(std::size_t i = 0; i < connections; ++i){
+            worker.server.open(endpoint);
+            auto session = worker.server.back();
+            worker.clients.push_back(std::make_shared<HttpPipelinedClientPresentation>(worker.presentations, session, options.depth));
+        }
+        if(rate > 0){
+            _interval = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0 / rate));
+        }
+    }
+
+    void run(clock_type::time_point start){
+        _measure = start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(_options.warmup));
+        _stop = _measure + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(_options.duration));
+        for(auto& client: _worker.clients){
+            read(client);
+        }
+        if(_interval == clock_type::duration::zero()){
+            for(auto& client: _worker.clients){
+                for(std::size_t i = 0; i < _options.depth; ++i){
+                    send(client, start);
+                }
+                client->write();
+            }
+        } else {
+            _due = start;
+            schedule();
+        }
+        // Run until the end of the test, then give the outstanding requests a grace period to finish.
+        boost::asio::steady_timer end(_worker.ioc);
+        end.expires_at(_stop + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(_options.grace)));
+        end.async_wait([this](const boost::system::error_code& ec){
+            if(!ec){
+                _worker.ioc.stop();
+            }
+        });
+        _worker.ioc.run();
+    }
+};
+
+static void usage(){
+    std::cerr << "usage: http-load [-c connections] [-p depth] [-t threads] [-d seconds] [-w seconds] [-r rate] [-u route] [-g seconds] socket" << std::endl;
+}
+
+int main(int argc, char* argv[]){
+    Options options;
+    int opt;
+    try {
+        while((opt = getopt(argc, argv, "c:p:t:d:w:r:u:g:")) != -1){
+            switch(opt)
+            {
+                case 'c':
+                    options.connections = std::stoul(optarg);
+                    break;
+                case 'p':
+                    options.depth = std::stoul(optarg);
+                    break;
+                case 't':
+                    options.threads = std::stoul(optarg);
+                    break;
+                case 'd':
+                    options.duration = std::stod(optarg);
+                    break;
+                case 'w':
+                    options.warmup = std::stod(optarg);
+                    break;
+                case 'r':
+                    options.rate = std::stod(optarg);
+                    break;
+                case 'u':
+                    options.route = optarg;
+                    break;
+                case 'g':
+                    options.grace = std::stod(optarg);
+                    break;
+                default:
+                    usage();
+                    return 1;
+            }
+        }
+    } catch(const std::exception& e) {
+        usage();
+        return 1;
+    }
+    if(optind != argc - 1 || options.connections == 0 || options.depth == 0 || options.threads == 0 || options.threads > options.connections){
+        usage();
+        return 1;
+    }
+    options.path = argv[optind];
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::unique_ptr<Generator> > generators;
+    try {
+        for(std::size_t i = 0; i < options.threads; ++i){
+            std::size_t connections = options.connections / options.threads + (i < options.connections % options.threads);
+            workers.push_back(std::make_unique<Worker>());
+            generators.push_back(std::make_unique<Generator>(options, *workers.back(), connections, options.rate * connections / options.connections));
+        }
+    } catch(const std::exception& e) {
+        std::cerr << "http-load: " << options.path << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    auto start = clock_type::now();
+    std::vector<std::thread> threads;
+    for(auto& generator: generators){
+        threads.emplace_back([&generator, start](){ generator->run(start); });
+    }
+    for(auto& t: threads){
+        t.join();
+    }
+
+    metrics::Histogram latency;
+    std::size_t sent = 0, completed = 0, recorded = 0, non_2xx = 0, errors = 0;
+    for(auto& worker: workers){
+        latency.merge(worker->latency);
+        sent += worker->sent;
+        completed += worker->completed;
+        recorded += worker->recorded;
+        non_2xx += worker->non_2xx;
+        errors += worker->errors;
+    }
+    std::cout << "{\"mode\":\"" << (options.rate > 0 ? "open" : "closed") << "\""
+              << ",\"connections\":" << options.connections << ",\"depth\":" << options.depth << ",\"threads\":" << options.threads
+              << ",\"duration\":" << options.duration << ",\"target_rate\":" << options.rate
+              << ",\"requests\":" << recorded << ",\"requests_per_second\":" << recorded / options.duration
+              << ",\"sent\":" << sent << ",\"completed\":" << completed << ",\"outstanding\":" << sent - completed
+              << ",\"non_2xx\":" << non_2xx << ",\"errors\":" << errors
+              << ",\"latency_ns\":{\"min\":" << latency.min() << ",\"mean\":" << static_cast<std::uint64_t>(latency.mean());
+    for(double p: {50.0, 75.0, 90.0, 99.0, 99.9, 99.99}){
+        std::cout << ",\"p" << p << "\":" << latency.percentile(p);
+    }
+    std::cout << ",\"max\":" << latency.max() << "},\"histogram\":[";
+    bool first = true;
+    latency.for_each([&](std::uint64_t value, std::uint64_t count){
+        std::cout << (first ? "" : ",") << "[" << value << "," << count << "]";
+        first = false;
+    });
+    std::cout << "]}" << std::endl;
+    return errors ? 2 : 0;
+}